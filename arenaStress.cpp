@@ -0,0 +1,247 @@
+//
+//  arenaStress.cpp
+//  test
+//
+//  Checks BufferArena and the GL handles on a real context: a random run of
+//  allocations and frees against one arena, then vectors of moved
+//  CubeInstances and StaticBatches, counting every buffer and vertex array
+//  name the driver hands out and takes back.
+//
+//  usage: ArenaStress [-n operations] [-s seed]
+//
+//  Prints what it found and exits with 1 on any failure.
+//
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "bufferArena.h"
+#include "cube.h"
+#include "cubeInstances.h"
+#include "cubeMesh.h"
+#include "meshArena.h"
+#include "staticBatch.h"
+
+using namespace std;
+
+static int failures = 0;
+
+static void check(bool condition, const string& what)
+{
+    if (!condition)
+    {
+        if (failures < 20)
+            cout << "FAILED: " << what << endl;
+        failures++;
+    }
+}
+
+// Every name glad hands out goes into live; deleting one that is not live
+// (twice, or never created) is a failure, and anything left at the end leaked.
+static set<GLuint> liveBuffers, liveArrays;
+static PFNGLGENBUFFERSPROC realGenBuffers;
+static PFNGLDELETEBUFFERSPROC realDeleteBuffers;
+static PFNGLGENVERTEXARRAYSPROC realGenVertexArrays;
+static PFNGLDELETEVERTEXARRAYSPROC realDeleteVertexArrays;
+
+static void track(set<GLuint>& live, GLsizei n, const GLuint* names)
+{
+    for (GLsizei i = 0; i < n; i++)
+        live.insert(names[i]);
+}
+
+static void untrack(set<GLuint>& live, GLsizei n, const GLuint* names, const char* kind)
+{
+    for (GLsizei i = 0; i < n; i++)
+        if (names[i] != 0)
+            check(live.erase(names[i]) == 1, string(kind) + " " + to_string(names[i]) + " deleted twice or never created");
+}
+
+static void APIENTRY genBuffers(GLsizei n, GLuint* names)
+{
+    realGenBuffers(n, names);
+    track(liveBuffers, n, names);
+}
+
+static void APIENTRY deleteBuffers(GLsizei n, const GLuint* names)
+{
+    untrack(liveBuffers, n, names, "buffer");
+    realDeleteBuffers(n, names);
+}
+
+static void APIENTRY genVertexArrays(GLsizei n, GLuint* names)
+{
+    realGenVertexArrays(n, names);
+    track(liveArrays, n, names);
+}
+
+static void APIENTRY deleteVertexArrays(GLsizei n, const GLuint* names)
+{
+    untrack(liveArrays, n, names, "vertex array");
+    realDeleteVertexArrays(n, names);
+}
+
+static void hookNames()
+{
+    realGenBuffers = glad_glGenBuffers;
+    realDeleteBuffers = glad_glDeleteBuffers;
+    realGenVertexArrays = glad_glGenVertexArrays;
+    realDeleteVertexArrays = glad_glDeleteVertexArrays;
+    glad_glGenBuffers = genBuffers;
+    glad_glDeleteBuffers = deleteBuffers;
+    glad_glGenVertexArrays = genVertexArrays;
+    glad_glDeleteVertexArrays = deleteVertexArrays;
+}
+
+// random allocations (sizes 1-5000, alignments 1-40, not just powers of two) and frees, at most 300 live
+static void stressArena(int operations, unsigned int seed)
+{
+    const size_t capacity = 1 << 20;
+    BufferArena arena(capacity);
+    mt19937 random(seed);
+    vector<BufferArena::Range> live;
+    size_t allocated = 0, failed = 0;
+
+    for (int operation = 0; operation < operations; operation++)
+    {
+        if (live.empty() || random() % 2)
+        {
+            size_t size = 1 + random() % 5000, alignment = 1 + random() % 40;
+            BufferArena::Range range = arena.allocate(size, alignment);
+            if (range.size == 0)
+            {
+                failed++;
+                continue;
+            }
+            allocated++;
+            check(range.size == size, "range of the wrong size");
+            check(range.offset % alignment == 0, "range at " + to_string(range.offset) + " not aligned to " + to_string(alignment));
+            check(range.offset + range.size <= arena.capacity(), "range past the end of the arena");
+            for (const BufferArena::Range& other : live)
+                check(range.offset + range.size <= other.offset || other.offset + other.size <= range.offset,
+                      "ranges at " + to_string(range.offset) + " and " + to_string(other.offset) + " overlap");
+            if (live.size() < 300)
+                live.push_back(range);
+            else
+                arena.free(range);
+        }
+        else
+        {
+            size_t index = random() % live.size();
+            arena.free(live[index]);
+            live.erase(live.begin() + index);
+        }
+    }
+
+    for (BufferArena::Range& range : live)
+        arena.free(range);
+    check(arena.used() == 0 && arena.allocationCount() == 0, "arena not empty after freeing everything");
+    // only one block covering the whole arena can satisfy this
+    BufferArena::Range whole = arena.allocate(capacity, 1);
+    check(whole.size == capacity, "free list did not coalesce back into one block");
+    arena.free(whole);
+    arena.release();
+
+    cout << "BufferArena: " << operations << " operations, " << allocated << " allocations (" << failed << " did not fit)" << endl;
+}
+
+// moved-from handles must delete nothing, the last holder everything, once
+static void checkHandles()
+{
+    static_assert(!is_copy_constructible<StaticBatch>::value && is_move_constructible<StaticBatch>::value, "StaticBatch must be move-only");
+    static_assert(!is_copy_constructible<CubeInstances>::value && is_move_constructible<CubeInstances>::value, "CubeInstances must be move-only");
+
+    Cube cube;
+    cube.diffuseLayer = 0;
+    cube.shininess = 32.0f;
+    for (int format = 0; format < 2; format++)
+    {
+        CubeMesh::shared().setVertexFormat((VertexFormat)format);
+        CubeMesh::shared().setPositionStream(true);
+
+        vector<CubeInstances> instances;
+        for (int i = 0; i < 5; i++)
+        {
+            CubeInstances group;
+            group.add(glm::mat4(1.0f), &cube);
+            group.upload();
+            instances.push_back(move(group));
+        }
+        vector<StaticBatch> batches;
+        for (int i = 0; i < 3; i++)
+        {
+            StaticBatch batch;
+            batch.vertexFormat = (VertexFormat)format;
+            batch.positionStream = true;
+            for (int box = 0; box < 30; box++)
+                batch.add(glm::translate(glm::mat4(1.0f), glm::vec3((float)box, 0.0f, 0.0f)), cube);
+            batch.build(true);
+            batches.push_back(move(batch));
+        }
+        for (StaticBatch& batch : batches)
+            batch.release();
+    }
+    CubeMesh::shared().release();
+    MeshArena::shared().release();
+
+    int failuresBefore = failures;
+    check(liveBuffers.empty(), to_string(liveBuffers.size()) + " buffers never deleted");
+    check(liveArrays.empty(), to_string(liveArrays.size()) + " vertex arrays never deleted");
+    if (failures == failuresBefore)
+        cout << "GL handles: every buffer and vertex array deleted exactly once" << endl;
+}
+
+int main(int argc, char** argv)
+{
+    int operations = 200000;
+    unsigned int seed = 1;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+            operations = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+            seed = (unsigned int)strtoul(argv[++i], nullptr, 10);
+        else
+        {
+            cout << "usage: ArenaStress [-n operations] [-s seed]" << endl;
+            return 1;
+        }
+    }
+
+    // the arena and handles need a context; an invisible window is enough
+    glfwInit();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    GLFWwindow* window = glfwCreateWindow(64, 64, "ArenaStress", NULL, NULL);
+    if (window == NULL)
+    {
+        cout << "Failed to create GLFW window" << endl;
+        glfwTerminate();
+        return 1;
+    }
+    glfwMakeContextCurrent(window);
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+    {
+        cout << "Failed to initialize GLAD" << endl;
+        glfwTerminate();
+        return 1;
+    }
+    hookNames();
+
+    stressArena(operations, seed);
+    checkHandles();
+
+    glfwTerminate();
+    cout << (failures ? to_string(failures) + " failures" : string("all checks passed")) << endl;
+    return failures ? 1 : 0;
+}
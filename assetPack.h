@@ -0,0 +1,307 @@
+//
+//  assetPack.h
+//  test
+//
+//  Read-only, memory-mapped pack of the game's files (shaders, images,
+//  baked textures) with an index by name, written by the asset packer.
+//
+
+#ifndef assetPack_h
+#define assetPack_h
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Layout, all integers little endian:
+//   "HHPACK1\0", uint32 entry count, uint32 index size in bytes
+//   index: per entry uint64 offset, uint64 size, uint32 name length, name
+//   file data, each entry starting on a 16 byte boundary
+//
+// The whole file is mapped once; find() hands out pointers straight into the
+// mapping, so nothing is copied or read until a page is first touched. The
+// pointers stay valid until the pack is closed. Loaders look in the pack
+// set with mount() before falling back to the file system.
+class AssetPack {
+public:
+    AssetPack() = default;
+
+    ~AssetPack()
+    {
+        close();
+    }
+
+    AssetPack(const AssetPack&) = delete;
+    AssetPack& operator=(const AssetPack&) = delete;
+
+    bool open(const char* path)
+    {
+        close();
+        if (!map(path))
+            return false;
+        if (!parseIndex())
+        {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close()
+    {
+        if (mounted() == this)
+            mount(nullptr);
+        entries.clear();
+        unmap();
+    }
+
+    bool isOpen() const
+    {
+        return base != nullptr;
+    }
+
+    size_t fileCount() const
+    {
+        return entries.size();
+    }
+
+    size_t byteSize() const
+    {
+        return mappedSize;
+    }
+
+    // name is the path the file was packed under, e.g. "wall.jpg"
+    bool find(const std::string& name, const unsigned char** data, size_t* size) const
+    {
+        auto it = entries.find(name);
+        if (it == entries.end())
+            return false;
+        *data = it->second.first;
+        *size = it->second.second;
+        return true;
+    }
+
+    // the pack loaders read from; nullptr (the default) means plain files only
+    static void mount(const AssetPack* pack)
+    {
+        mountedPack() = pack;
+    }
+
+    static const AssetPack* mounted()
+    {
+        return mountedPack();
+    }
+
+    // looks name up in the mounted pack, if there is one
+    static bool findMounted(const std::string& name, const unsigned char** data, size_t* size)
+    {
+        const AssetPack* pack = mounted();
+        return pack && pack->find(name, data, size);
+    }
+
+    // files is (name, contents); used by the packer
+    static bool write(const char* path, const std::vector<std::pair<std::string, std::vector<unsigned char>>>& files)
+    {
+        std::vector<unsigned char> index;
+        uint64_t offset = headerSize;
+        for (const auto& file : files)
+            offset += 8 + 8 + 4 + file.first.size();
+        offset = align(offset);
+
+        for (const auto& file : files)
+        {
+            appendInteger(index, offset, 8);
+            appendInteger(index, file.second.size(), 8);
+            appendInteger(index, file.first.size(), 4);
+            index.insert(index.end(), file.first.begin(), file.first.end());
+            offset = align(offset + file.second.size());
+        }
+
+        std::ofstream out(path, std::ios::binary);
+        if (!out)
+            return false;
+
+        std::vector<unsigned char> header;
+        header.insert(header.end(), magic(), magic() + magicSize);
+        appendInteger(header, files.size(), 4);
+        appendInteger(header, index.size(), 4);
+        out.write((const char*)header.data(), header.size());
+        out.write((const char*)index.data(), index.size());
+
+        static const char padding[alignment] = {};
+        uint64_t position = headerSize + index.size();
+        out.write(padding, align(position) - position);
+        for (const auto& file : files)
+        {
+            out.write((const char*)file.second.data(), file.second.size());
+            out.write(padding, align(file.second.size()) - file.second.size());
+        }
+        return (bool)out;
+    }
+
+private:
+    static const size_t magicSize = 8;
+    static const size_t headerSize = magicSize + 4 + 4;
+    static const size_t alignment = 16;
+
+    std::unordered_map<std::string, std::pair<const unsigned char*, size_t>> entries;
+    const unsigned char* base = nullptr;
+    size_t mappedSize = 0;
+#ifdef _WIN32
+    HANDLE fileHandle = INVALID_HANDLE_VALUE;
+    HANDLE mappingHandle = NULL;
+#endif
+
+    static const AssetPack*& mountedPack()
+    {
+        static const AssetPack* pack = nullptr;
+        return pack;
+    }
+
+    static const unsigned char* magic()
+    {
+        static const unsigned char bytes[magicSize] = { 'H', 'H', 'P', 'A', 'C', 'K', '1', 0 };
+        return bytes;
+    }
+
+    static uint64_t align(uint64_t offset)
+    {
+        return (offset + alignment - 1) & ~(uint64_t)(alignment - 1);
+    }
+
+    static void appendInteger(std::vector<unsigned char>& bytes, uint64_t value, int byteCount)
+    {
+        for (int i = 0; i < byteCount; i++)
+            bytes.push_back((unsigned char)(value >> (8 * i)));
+    }
+
+    static uint64_t readInteger(const unsigned char* bytes, int byteCount)
+    {
+        uint64_t value = 0;
+        for (int i = 0; i < byteCount; i++)
+            value |= (uint64_t)bytes[i] << (8 * i);
+        return value;
+    }
+
+    bool parseIndex()
+    {
+        if (mappedSize < headerSize || memcmp(base, magic(), magicSize) != 0)
+            return false;
+
+        uint64_t count = readInteger(base + magicSize, 4);
+        uint64_t indexSize = readInteger(base + magicSize + 4, 4);
+        if (indexSize > mappedSize - headerSize)
+            return false;
+
+        const unsigned char* cursor = base + headerSize;
+        const unsigned char* indexEnd = cursor + indexSize;
+        for (uint64_t i = 0; i < count; i++)
+        {
+            if (indexEnd - cursor < 20)
+                return false;
+            uint64_t offset = readInteger(cursor, 8);
+            uint64_t size = readInteger(cursor + 8, 8);
+            uint64_t nameLength = readInteger(cursor + 16, 4);
+            cursor += 20;
+            if ((uint64_t)(indexEnd - cursor) < nameLength || offset > mappedSize || size > mappedSize - offset)
+                return false;
+
+            entries[std::string((const char*)cursor, (size_t)nameLength)] = std::make_pair(base + offset, (size_t)size);
+            cursor += nameLength;
+        }
+        return true;
+    }
+
+#ifdef _WIN32
+    bool map(const char* path)
+    {
+        fileHandle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, NULL);
+        if (fileHandle == INVALID_HANDLE_VALUE)
+            return false;
+
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(fileHandle, &size) || size.QuadPart == 0 || (unsigned long long)size.QuadPart > (size_t)-1)
+        {
+            unmap();
+            return false;
+        }
+
+        mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+        base = mappingHandle ? (const unsigned char*)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0) : nullptr;
+        if (!base)
+        {
+            unmap();
+            return false;
+        }
+        mappedSize = (size_t)size.QuadPart;
+        return true;
+    }
+
+    void unmap()
+    {
+        if (base)
+            UnmapViewOfFile(base);
+        if (mappingHandle)
+            CloseHandle(mappingHandle);
+        if (fileHandle != INVALID_HANDLE_VALUE)
+            CloseHandle(fileHandle);
+        base = nullptr;
+        mappedSize = 0;
+        mappingHandle = NULL;
+        fileHandle = INVALID_HANDLE_VALUE;
+    }
+#else
+    bool map(const char* path)
+    {
+        int descriptor = ::open(path, O_RDONLY);
+        if (descriptor < 0)
+            return false;
+
+        struct stat status;
+        if (fstat(descriptor, &status) != 0 || status.st_size <= 0)
+        {
+            ::close(descriptor);
+            return false;
+        }
+
+        // the mapping keeps the file alive, so the descriptor can go right away
+        void* pointer = mmap(nullptr, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+        ::close(descriptor);
+        if (pointer == MAP_FAILED)
+            return false;
+
+        base = (const unsigned char*)pointer;
+        mappedSize = (size_t)status.st_size;
+        return true;
+    }
+
+    void unmap()
+    {
+        if (base)
+            munmap((void*)base, mappedSize);
+        base = nullptr;
+        mappedSize = 0;
+    }
+#endif
+};
+
+#endif /* assetPack_h */
@@ -0,0 +1,89 @@
+//
+//  assetPacker.cpp
+//  test
+//
+//  Build step: writes the scene's shaders, images and baked KTX textures
+//  into one pack file that the game maps at startup instead of opening
+//  every file on its own. Runs after the texture baker, so the baked
+//  "<name>.ktx" and "<name>+<mask>.ktx" files next to the images are
+//  packed as well.
+//
+//  usage: AssetPacker [-o pack] [file ...]
+//
+
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "assetPack.h"
+#include "ktxTexture.h"
+
+using namespace std;
+
+bool readFile(const string& path, vector<unsigned char>& bytes)
+{
+    ifstream file(path, ios::binary);
+    if (!file)
+        return false;
+    bytes.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    string packPath = "assets.pak";
+    vector<string> paths;
+
+    for (int i = 1; i < argc; i++)
+    {
+        string argument = argv[i];
+        if (argument == "-o" && i + 1 < argc)
+            packPath = argv[++i];
+        else
+            paths.push_back(argument);
+    }
+
+    if (paths.empty())
+    {
+        paths = { "vertexShader.vs", "fragmentShader.fs", "vertexShaderForPhongShadingWithTexture.vs", "fragmentShaderForPhongShadingWithTexture.fs" };
+        vector<string> images = { "wall.jpg", "floor.jpg", "celling.jpg", "ghost.jpg", "container2.png", "container2_specular.png", "emoji.png", "whiteBackground.png" };
+        for (const string& image : images)
+        {
+            paths.push_back(image);
+            // baked textures are optional; TextureRegistry falls back to the image without one
+            if (ifstream(KtxTexture::bakedPath(image), ios::binary))
+                paths.push_back(KtxTexture::bakedPath(image));
+            // the scene's materials pack each image with itself as the specular mask
+            if (ifstream(KtxTexture::packedBakedPath(image, image), ios::binary))
+                paths.push_back(KtxTexture::packedBakedPath(image, image));
+        }
+    }
+
+    vector<pair<string, vector<unsigned char>>> files;
+    size_t totalBytes = 0;
+    int failures = 0;
+    for (const string& path : paths)
+    {
+        vector<unsigned char> bytes;
+        if (!readFile(path, bytes))
+        {
+            cout << path << ": failed to read" << endl;
+            failures++;
+            continue;
+        }
+        totalBytes += bytes.size();
+        files.emplace_back(path, move(bytes));
+    }
+
+    if (!AssetPack::write(packPath.c_str(), files))
+    {
+        cout << packPath << ": failed to write" << endl;
+        return 1;
+    }
+
+    cout << "Packed " << files.size() << " files (" << totalBytes / 1024 << " KB) into " << packPath << endl;
+    return failures == 0 ? 0 : 1;
+}
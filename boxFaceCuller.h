@@ -0,0 +1,268 @@
+//
+//  boxFaceCuller.h
+//  test
+//
+//  Scene preprocessing for boxes that never move: drops the parts of their
+//  faces that are buried in or pressed against other boxes.
+//
+
+#ifndef boxFaceCuller_h
+#define boxFaceCuller_h
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "cubeMesh.h"
+
+// Every face of every box is an axis-aligned rectangle in world space. For
+// each one, cull() collects the rectangles of the other boxes that cover it
+// from the outside, i.e. boxes that reach through the face's plane in the
+// direction it faces:
+//   - a neighbour resting on the face (a wall on a floor, a door top on a
+//     door side) hides the contact area,
+//   - a box overlapping this one hides the part of the face inside it.
+// Those rectangles are subtracted from the face, which leaves it whole,
+// split into up to four pieces per cover, or gone. Faces a box shares
+// exactly with an identical box are kept, since neither reaches past the
+// other.
+//
+// Only boxes whose transform scales and translates (any sign) take part;
+// anything rotated keeps all its faces and hides nothing.
+class BoxFaceCuller {
+public:
+    // a visible rectangle of face "face" (0-5, CubeMesh's order) of box "box", in the cube's own 0..1 space
+    struct Piece {
+        int box;
+        int face;
+        glm::vec3 corners[4];   // counterclockwise in world space, seen from outside the box
+    };
+
+    struct Statistics {
+        size_t trianglesBefore = 0;
+        size_t trianglesAfter = 0;
+        size_t facesRemoved = 0;    // hidden entirely
+        size_t facesSplit = 0;      // partly hidden, kept as smaller pieces
+        double areaBefore = 0.0;    // world-space surface area, i.e. fragments shaded when all of it is on screen
+        double areaAfter = 0.0;
+    };
+
+    // distances below this are treated as touching
+    static constexpr float epsilon = 1e-4f;
+
+    static std::vector<Piece> cull(const std::vector<glm::mat4>& transforms, Statistics& statistics)
+    {
+        std::vector<Bounds> boxes;
+        boxes.reserve(transforms.size());
+        for (const glm::mat4& transform : transforms)
+            boxes.push_back(boundsOf(transform));
+
+        statistics = Statistics();
+        std::vector<Piece> pieces;
+        std::vector<Rectangle> visible, remaining;
+        for (size_t box = 0; box < boxes.size(); box++)
+        {
+            const Bounds& bounds = boxes[box];
+            glm::mat4 toLocal = glm::inverse(transforms[box]);
+            for (int face = 0; face < 6; face++)
+            {
+                Face world = worldFace(transforms[box], face);
+                double faceArea = world.rectangle.area();
+                statistics.trianglesBefore += 2;
+                statistics.areaBefore += faceArea;
+
+                visible.assign(1, world.rectangle);
+                if (bounds.axisAligned)
+                {
+                    for (size_t other = 0; other < boxes.size() && !visible.empty(); other++)
+                    {
+                        Rectangle cover;
+                        if (other == box || !covers(boxes[other], world, cover))
+                            continue;
+                        remaining.clear();
+                        for (const Rectangle& rectangle : visible)
+                            rectangle.subtract(cover, remaining);
+                        visible.swap(remaining);
+                    }
+                    mergeAdjacent(visible);
+                }
+
+                if (visible.empty())
+                    statistics.facesRemoved++;
+                else if (visible.size() > 1 || visible[0].area() < faceArea - epsilon)
+                    statistics.facesSplit++;
+
+                for (const Rectangle& rectangle : visible)
+                {
+                    pieces.push_back(localPiece((int)box, face, world, rectangle, toLocal));
+                    statistics.trianglesAfter += 2;
+                    statistics.areaAfter += rectangle.area();
+                }
+            }
+        }
+        return pieces;
+    }
+
+private:
+    struct Bounds {
+        glm::vec3 min;
+        glm::vec3 max;
+        bool axisAligned;
+    };
+
+    // on the plane of a face: u is axis + 1, v is axis + 2 (mod 3)
+    struct Rectangle {
+        float u0, u1, v0, v1;
+
+        double area() const
+        {
+            return (double)(u1 - u0) * (v1 - v0);
+        }
+
+        // appends what is left of this rectangle after taking cover away
+        void subtract(const Rectangle& cover, std::vector<Rectangle>& out) const
+        {
+            Rectangle cut = { std::max(u0, cover.u0), std::min(u1, cover.u1), std::max(v0, cover.v0), std::min(v1, cover.v1) };
+            if (cut.u1 - cut.u0 <= epsilon || cut.v1 - cut.v0 <= epsilon)
+            {
+                out.push_back(*this);
+                return;
+            }
+            // full-height strips left and right of the cut, then the parts above and below it
+            appendIfNotEmpty(Rectangle{ u0, cut.u0, v0, v1 }, out);
+            appendIfNotEmpty(Rectangle{ cut.u1, u1, v0, v1 }, out);
+            appendIfNotEmpty(Rectangle{ cut.u0, cut.u1, v0, cut.v0 }, out);
+            appendIfNotEmpty(Rectangle{ cut.u0, cut.u1, cut.v1, v1 }, out);
+        }
+
+        static void appendIfNotEmpty(const Rectangle& rectangle, std::vector<Rectangle>& out)
+        {
+            if (rectangle.u1 - rectangle.u0 > epsilon && rectangle.v1 - rectangle.v0 > epsilon)
+                out.push_back(rectangle);
+        }
+    };
+
+    // joins rectangles that share a whole edge, undoing splits that did not need to happen
+    static void mergeAdjacent(std::vector<Rectangle>& rectangles)
+    {
+        bool merged = true;
+        while (merged)
+        {
+            merged = false;
+            for (size_t i = 0; i < rectangles.size() && !merged; i++)
+            {
+                for (size_t j = i + 1; j < rectangles.size() && !merged; j++)
+                {
+                    Rectangle& a = rectangles[i];
+                    const Rectangle& b = rectangles[j];
+                    bool sameU = std::fabs(a.u0 - b.u0) <= epsilon && std::fabs(a.u1 - b.u1) <= epsilon;
+                    bool sameV = std::fabs(a.v0 - b.v0) <= epsilon && std::fabs(a.v1 - b.v1) <= epsilon;
+                    if (sameU && (std::fabs(a.v1 - b.v0) <= epsilon || std::fabs(b.v1 - a.v0) <= epsilon))
+                    {
+                        a.v0 = std::min(a.v0, b.v0);
+                        a.v1 = std::max(a.v1, b.v1);
+                        merged = true;
+                    }
+                    else if (sameV && (std::fabs(a.u1 - b.u0) <= epsilon || std::fabs(b.u1 - a.u0) <= epsilon))
+                    {
+                        a.u0 = std::min(a.u0, b.u0);
+                        a.u1 = std::max(a.u1, b.u1);
+                        merged = true;
+                    }
+                    if (merged)
+                        rectangles.erase(rectangles.begin() + j);
+                }
+            }
+        }
+    }
+
+    struct Face {
+        int axis;
+        float direction;    // +1 or -1 along axis
+        float plane;
+        Rectangle rectangle;
+    };
+
+    static Bounds boundsOf(const glm::mat4& transform)
+    {
+        glm::vec3 a = glm::vec3(transform * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+        glm::vec3 b = glm::vec3(transform * glm::vec4(1.0f, 1.0f, 1.0f, 1.0f));
+        bool axisAligned = true;
+        for (int column = 0; column < 3; column++)
+            for (int row = 0; row < 3; row++)
+                if (row != column && std::fabs(transform[column][row]) > epsilon)
+                    axisAligned = false;
+        return Bounds{ glm::min(a, b), glm::max(a, b), axisAligned };
+    }
+
+    static Face worldFace(const glm::mat4& transform, int face)
+    {
+        const float* vertex = CubeMesh::vertices() + face * 4 * CubeMesh::floatsPerVertex;
+        glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(transform)));
+        glm::vec3 normal = normalMatrix * glm::vec3(vertex[3], vertex[4], vertex[5]);
+
+        Face world;
+        world.axis = 0;
+        for (int axis = 1; axis < 3; axis++)
+            if (std::fabs(normal[axis]) > std::fabs(normal[world.axis]))
+                world.axis = axis;
+        world.direction = normal[world.axis] > 0.0f ? 1.0f : -1.0f;
+
+        int u = (world.axis + 1) % 3, v = (world.axis + 2) % 3;
+        world.rectangle = Rectangle{ INFINITY, -INFINITY, INFINITY, -INFINITY };
+        for (int corner = 0; corner < 4; corner++, vertex += CubeMesh::floatsPerVertex)
+        {
+            glm::vec3 position = glm::vec3(transform * glm::vec4(vertex[0], vertex[1], vertex[2], 1.0f));
+            world.plane = position[world.axis];
+            world.rectangle.u0 = std::min(world.rectangle.u0, position[u]);
+            world.rectangle.u1 = std::max(world.rectangle.u1, position[u]);
+            world.rectangle.v0 = std::min(world.rectangle.v0, position[v]);
+            world.rectangle.v1 = std::max(world.rectangle.v1, position[v]);
+        }
+        return world;
+    }
+
+    // whether other reaches through the face's plane on its outer side, and over which rectangle
+    static bool covers(const Bounds& other, const Face& face, Rectangle& cover)
+    {
+        if (!other.axisAligned)
+            return false;
+
+        float low = other.min[face.axis], high = other.max[face.axis];
+        bool reachesOut = face.direction > 0.0f ? (low <= face.plane + epsilon && high > face.plane + epsilon)
+                                                : (high >= face.plane - epsilon && low < face.plane - epsilon);
+        if (!reachesOut)
+            return false;
+
+        int u = (face.axis + 1) % 3, v = (face.axis + 2) % 3;
+        cover = Rectangle{ other.min[u], other.max[u], other.min[v], other.max[v] };
+        return cover.u0 < face.rectangle.u1 - epsilon && cover.u1 > face.rectangle.u0 + epsilon &&
+               cover.v0 < face.rectangle.v1 - epsilon && cover.v1 > face.rectangle.v0 + epsilon;
+    }
+
+    static Piece localPiece(int box, int face, const Face& world, const Rectangle& rectangle, const glm::mat4& toLocal)
+    {
+        int u = (world.axis + 1) % 3, v = (world.axis + 2) % 3;
+        const float cornerU[4] = { rectangle.u0, rectangle.u1, rectangle.u1, rectangle.u0 };
+        const float cornerV[4] = { rectangle.v0, rectangle.v0, rectangle.v1, rectangle.v1 };
+
+        // (u, v, axis) is right-handed, so this order is counterclockwise seen from +axis
+        Piece piece;
+        piece.box = box;
+        piece.face = face;
+        for (int corner = 0; corner < 4; corner++)
+        {
+            int index = world.direction > 0.0f ? corner : 3 - corner;
+            glm::vec3 position;
+            position[world.axis] = world.plane;
+            position[u] = cornerU[index];
+            position[v] = cornerV[index];
+            piece.corners[corner] = glm::vec3(toLocal * glm::vec4(position, 1.0f));
+        }
+        return piece;
+    }
+};
+
+#endif /* boxFaceCuller_h */
@@ -0,0 +1,161 @@
+//
+//  bufferArena.h
+//  test
+//
+//  One large GL buffer handed out in byte ranges, so many meshes live in a
+//  single buffer object instead of one allocation each.
+//
+
+#ifndef bufferArena_h
+#define bufferArena_h
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <iterator>
+#include <map>
+
+#include "glHandle.h"
+
+// The buffer has a fixed capacity, allocated (uninitialized) on the first
+// allocate() with the context current; growing it would move every range.
+// Free space is kept as a map from offset to size: allocate() takes the
+// first block that fits at the requested alignment, free() puts the range
+// back and merges it with the blocks on either side. Ranges are aligned to
+// any byte count, not just powers of two, so a vertex range can start on a
+// multiple of its stride and be drawn with a base vertex.
+//
+// Uploads go through GL_COPY_WRITE_BUFFER, which leaves the element array
+// binding of whatever VAO is bound alone.
+class BufferArena {
+public:
+    struct Range {
+        size_t offset = 0;
+        size_t size = 0;    // 0 for a failed or freed allocation
+    };
+
+    explicit BufferArena(size_t capacity = 4 * 1024 * 1024, GLenum usage = GL_STATIC_DRAW)
+    {
+        this->arenaCapacity = capacity;
+        this->usage = usage;
+    }
+
+    // returns an empty range when no free block is large enough
+    Range allocate(size_t size, size_t alignment = 4)
+    {
+        if (!buffer)
+            create();
+
+        Range range;
+        if (size == 0)
+            return range;
+        for (auto it = freeBlocks.begin(); it != freeBlocks.end(); ++it)
+        {
+            size_t blockStart = it->first, blockEnd = it->first + it->second;
+            size_t start = (blockStart + alignment - 1) / alignment * alignment;
+            if (start + size > blockEnd)
+                continue;
+
+            // what is left before and after the range stays free
+            freeBlocks.erase(it);
+            if (start > blockStart)
+                freeBlocks[blockStart] = start - blockStart;
+            if (start + size < blockEnd)
+                freeBlocks[start + size] = blockEnd - (start + size);
+
+            range.offset = start;
+            range.size = size;
+            usedBytes += size;
+            allocations++;
+            return range;
+        }
+        return range;
+    }
+
+    void free(Range& range)
+    {
+        if (range.size == 0)
+            return;
+
+        auto it = freeBlocks.insert(std::make_pair(range.offset, range.size)).first;
+        // merge with the following block, then with the preceding one
+        auto next = std::next(it);
+        if (next != freeBlocks.end() && it->first + it->second == next->first)
+        {
+            it->second += next->second;
+            freeBlocks.erase(next);
+        }
+        if (it != freeBlocks.begin())
+        {
+            auto previous = std::prev(it);
+            if (previous->first + previous->second == it->first)
+            {
+                previous->second += it->second;
+                freeBlocks.erase(it);
+            }
+        }
+
+        usedBytes -= range.size;
+        allocations--;
+        range = Range();
+    }
+
+    // writes size bytes (at most the range's size) at the start of range
+    void upload(const Range& range, const void* data, size_t size)
+    {
+        if (range.size == 0 || size == 0)
+            return;
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer.get());
+        glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)range.offset, (GLsizeiptr)(size < range.size ? size : range.size), data);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+
+    GLuint name() const
+    {
+        return buffer.get();
+    }
+
+    size_t capacity() const
+    {
+        return arenaCapacity;
+    }
+
+    size_t used() const
+    {
+        return usedBytes;
+    }
+
+    size_t allocationCount() const
+    {
+        return allocations;
+    }
+
+    // deletes the buffer; every range handed out so far is gone with it
+    void release()
+    {
+        buffer.reset();
+        freeBlocks.clear();
+        usedBytes = 0;
+        allocations = 0;
+    }
+
+private:
+    size_t arenaCapacity;
+    GLenum usage;
+    GLBuffer buffer;
+    std::map<size_t, size_t> freeBlocks;    // offset -> size
+    size_t usedBytes = 0;
+    size_t allocations = 0;
+
+    void create()
+    {
+        buffer = GLBuffer::create();
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer.get());
+        glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)arenaCapacity, NULL, usage);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        freeBlocks.clear();
+        freeBlocks[0] = arenaCapacity;
+    }
+};
+
+#endif /* bufferArena_h */
@@ -0,0 +1,82 @@
+//
+//  cameraBlock.h
+//  test
+//
+//  The camera's matrices and position, written once per frame into the
+//  CameraBlock uniform block every program reads.
+//
+
+#ifndef cameraBlock_h
+#define cameraBlock_h
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+
+#include "frameRing.h"
+#include "shaderUniforms.h"
+
+// update() copies the block into this frame's segment of a FrameRing and
+// binds that range to CameraBlockLayout::binding, the binding point the
+// generated uniform structs give the block in every program. Switching
+// programs afterwards needs no camera uploads at all, so a program added
+// later (shadow, depth, post) only has to declare the block.
+//
+// Call update() before the frame's first draw and endFrame() after its
+// last, so the ring knows when the GPU is done with the segment.
+class CameraBlock {
+public:
+    // laid out as the shaders' std140 block; checked against the generated offsets below
+    struct Data {
+        glm::mat4 projection;
+        glm::mat4 view;
+        glm::vec3 viewPos;
+        float padding;
+    };
+
+    void update(const glm::mat4& projection, const glm::mat4& view, const glm::vec3& viewPos)
+    {
+        if (offsetAlignment == 0)
+        {
+            GLint alignment = 0;
+            glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+            offsetAlignment = alignment > 0 ? (size_t)alignment : 256;
+        }
+
+        Data data;
+        data.projection = projection;
+        data.view = view;
+        data.viewPos = viewPos;
+        data.padding = 0.0f;
+
+        ring.beginFrame();
+        size_t offset = ring.push(&data, sizeof(data), offsetAlignment);
+        if (offset != (size_t)-1)
+            glBindBufferRange(GL_UNIFORM_BUFFER, CameraBlockLayout::binding, ring.name(), (GLintptr)offset, sizeof(Data));
+    }
+
+    void endFrame()
+    {
+        ring.endFrame();
+    }
+
+    // call before the GL context goes away
+    void release()
+    {
+        ring.release();
+    }
+
+private:
+    // one block per frame, with room for the largest offset alignment drivers ask for
+    FrameRing ring{ 1024 };
+    size_t offsetAlignment = 0;
+};
+
+static_assert(offsetof(CameraBlock::Data, projection) == CameraBlockLayout::projection &&
+              offsetof(CameraBlock::Data, view) == CameraBlockLayout::view &&
+              offsetof(CameraBlock::Data, viewPos) == CameraBlockLayout::viewPos &&
+              sizeof(CameraBlock::Data) == CameraBlockLayout::size,
+              "CameraBlock::Data must match the std140 CameraBlock in the shaders");
+
+#endif /* cameraBlock_h */
@@ -0,0 +1,416 @@
+//
+//  clusterGrid.h
+//  test
+//
+//  Clustered forward lighting: the view frustum is cut into a grid of
+//  clusters and every cluster gets the list of lights that reach it, so a
+//  fragment shades only its own cluster's lights instead of all of them.
+//
+
+#ifndef clusterGrid_h
+#define clusterGrid_h
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CLUSTER_SSE2 1
+#endif
+
+#include "glHandle.h"
+#include "lightBlock.h"
+#include "shaderUniforms.h"
+#include "threadPool.h"
+
+// The grid is columns x rows screen tiles by slices depth slices, spaced
+// exponentially between the near and far plane so near clusters are not
+// stretched deep. Every cluster's view-space bounding box is computed when
+// the projection changes. build() then, each frame:
+//   1. takes every live light from the LightBlock into view space with the
+//      radius at which its attenuation falls to its cutoff (a switched-off
+//      light is skipped),
+//   2. tests each light against the boxes of the slices its sphere spans,
+//      four clusters of a row at a time (SSE2 when available); slices are
+//      split among the thread pool once there are threadedLightCount lights,
+//      each thread writing only its own slices' lists,
+//   3. packs the lists, in cluster order, into two buffer textures: per
+//      cluster (first index, count) as RG32UI, and the light indices as R16UI.
+// Shaders compiled with CLUSTERED_LIGHTS find their cluster from
+// gl_FragCoord and view depth and loop over that range of indices.
+//
+// The shader fades every light to 0 at that radius whether it is clustered
+// or not, so both paths light the scene alike. A cluster keeps at most
+// maxLightsPerCluster lights; the rest are counted in overflowCount() and
+// dropped, and build() says so whenever a frame drops more than any before,
+// since the clustered path then no longer shades what the other one does.
+class ClusterGrid {
+public:
+    // sampler units of the two buffer textures; 0-2 hold the material maps and box records
+    static const int recordUnit = 3;
+    static const int indexUnit = 4;
+
+    int columns = 16;
+    int rows = 9;
+    int slices = 24;
+    int maxLightsPerCluster = 64;
+    unsigned int threadedLightCount = 64;   // fewer lights are binned on the calling thread
+
+    // projection must be a perspective projection with the given near and far planes; lights are in world space
+    void build(const glm::mat4& projection, const glm::mat4& view, float nearPlane, float farPlane, const LightBlock& lights,
+               int width, int height)
+    {
+        auto start = std::chrono::steady_clock::now();
+
+        if (projection != builtProjection || nearPlane != builtNear || farPlane != builtFar || columns != builtColumns ||
+            rows != builtRows || slices != builtSlices)
+            buildBounds(projection, nearPlane, farPlane);
+        viewportWidth = width;
+        viewportHeight = height;
+
+        gatherLights(view, lights);
+
+        size_t clusterCount = (size_t)slices * rows * paddedColumns;
+        clusterCounts.assign(clusterCount, 0);
+        clusterLights.resize(clusterCount * maxLightsPerCluster);
+        sliceOverflows.assign(slices, 0);
+
+        if (binned.size() >= threadedLightCount && slices > 1)
+        {
+            if (!pool)
+                pool.reset(new ThreadPool());
+            int taskCount = (int)std::min<unsigned int>(pool->size() * 2, (unsigned int)slices);
+            for (int task = 0; task < taskCount; task++)
+            {
+                int first = slices * task / taskCount;
+                int last = slices * (task + 1) / taskCount;
+                pool->enqueue([this, first, last] { binSlices(first, last); });
+            }
+            pool->wait();
+        }
+        else
+            binSlices(0, slices);
+
+        int overflows = overflowCount();
+        if (overflows > worstOverflowCount)
+        {
+            std::cout << "Cluster grid: " << overflows << " light references dropped, clusters are limited to " << maxLightsPerCluster
+                      << " lights" << std::endl;
+            worstOverflowCount = overflows;
+        }
+
+        pack();
+        upload();
+
+        buildMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // the shader must be in use and compiled with CLUSTERED_LIGHTS
+    void bind(const Shader& shader, const TexturedPhongUniforms& uniforms) const
+    {
+        float depthScale = slices / std::log(builtFar / builtNear);
+        uniforms.clusterRecords.set(shader, recordUnit);
+        uniforms.clusterLightIndices.set(shader, indexUnit);
+        uniforms.clusterTileSize.set(shader, glm::vec2((float)viewportWidth / columns, (float)viewportHeight / rows));
+        uniforms.clusterDepthScaleBias.set(shader, glm::vec2(depthScale, -std::log(builtNear) * depthScale));
+        uniforms.clusterColumns.set(shader, columns);
+        uniforms.clusterRows.set(shader, rows);
+        uniforms.clusterSlices.set(shader, slices);
+
+        glActiveTexture(GL_TEXTURE0 + recordUnit);
+        glBindTexture(GL_TEXTURE_BUFFER, recordTexture.get());
+        glActiveTexture(GL_TEXTURE0 + indexUnit);
+        glBindTexture(GL_TEXTURE_BUFFER, indexTexture.get());
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // light indices over all clusters in the last build
+    size_t indexCount() const
+    {
+        return indices.size();
+    }
+
+    // light references the last build dropped from full clusters
+    int overflowCount() const
+    {
+        int overflows = 0;
+        for (int count : sliceOverflows)
+            overflows += count;
+        return overflows;
+    }
+
+    // CPU time of the last build, upload included
+    double lastBuildMilliseconds() const
+    {
+        return buildMilliseconds;
+    }
+
+    // call before the GL context goes away
+    void release()
+    {
+        recordTexture.reset();
+        recordBuffer.reset();
+        indexTexture.reset();
+        indexBuffer.reset();
+    }
+
+private:
+    struct BinnedLight {
+        float x, y, z;      // view space
+        float radiusSquared;
+        int firstSlice;
+        int lastSlice;
+        uint16_t index;     // in the LightBlock
+    };
+
+    // cluster bounds, structure of arrays; rows are padded to a multiple of 4 columns with empty boxes
+    std::vector<float> minX, minY, minZ, maxX, maxY, maxZ;
+    int paddedColumns = 0;
+    glm::mat4 builtProjection = glm::mat4(0.0f);
+    float builtNear = 0.0f;
+    float builtFar = 0.0f;
+    int builtColumns = 0;
+    int builtRows = 0;
+    int builtSlices = 0;
+    int viewportWidth = 1;
+    int viewportHeight = 1;
+
+    std::vector<BinnedLight> binned;
+    std::vector<uint16_t> clusterCounts;    // per padded cluster
+    std::vector<uint16_t> clusterLights;    // maxLightsPerCluster per padded cluster
+    std::vector<int> sliceOverflows;
+    int worstOverflowCount = 0;
+    std::vector<uint32_t> records;          // (first, count) per cluster
+    std::vector<uint16_t> indices;
+    double buildMilliseconds = 0.0;
+
+    std::unique_ptr<ThreadPool> pool;
+    GLBuffer recordBuffer;
+    GLTexture recordTexture;
+    GLBuffer indexBuffer;
+    GLTexture indexTexture;
+
+    float sliceDepth(int slice) const
+    {
+        return builtNear * std::pow(builtFar / builtNear, (float)slice / slices);
+    }
+
+    int depthSlice(float depth) const
+    {
+        int slice = (int)std::floor(std::log(depth / builtNear) / std::log(builtFar / builtNear) * slices);
+        return std::min(std::max(slice, 0), slices - 1);
+    }
+
+    void buildBounds(const glm::mat4& projection, float nearPlane, float farPlane)
+    {
+        builtProjection = projection;
+        builtNear = nearPlane;
+        builtFar = farPlane;
+        builtColumns = columns;
+        builtRows = rows;
+        builtSlices = slices;
+        paddedColumns = (columns + 3) / 4 * 4;
+
+        size_t clusterCount = (size_t)slices * rows * paddedColumns;
+        // an empty box is infinitely far from every light
+        minX.assign(clusterCount, 1e30f);
+        minY.assign(clusterCount, 1e30f);
+        minZ.assign(clusterCount, 1e30f);
+        maxX.assign(clusterCount, -1e30f);
+        maxY.assign(clusterCount, -1e30f);
+        maxZ.assign(clusterCount, -1e30f);
+
+        for (int slice = 0; slice < slices; slice++)
+        {
+            float nearDepth = sliceDepth(slice), farDepth = sliceDepth(slice + 1);
+            for (int row = 0; row < rows; row++)
+            {
+                for (int column = 0; column < columns; column++)
+                {
+                    size_t cluster = ((size_t)slice * rows + row) * paddedColumns + column;
+                    glm::vec3 low(1e30f), high(-1e30f);
+                    for (int corner = 0; corner < 4; corner++)
+                    {
+                        float ndcX = -1.0f + 2.0f * (column + (corner & 1)) / columns;
+                        float ndcY = -1.0f + 2.0f * (row + (corner >> 1)) / rows;
+                        // the view-space point at depth 1 that projects to (ndcX, ndcY)
+                        glm::vec3 direction((ndcX + projection[2][0]) / projection[0][0], (ndcY + projection[2][1]) / projection[1][1], -1.0f);
+                        low = glm::min(low, glm::min(direction * nearDepth, direction * farDepth));
+                        high = glm::max(high, glm::max(direction * nearDepth, direction * farDepth));
+                    }
+                    minX[cluster] = low.x;
+                    minY[cluster] = low.y;
+                    minZ[cluster] = low.z;
+                    maxX[cluster] = high.x;
+                    maxY[cluster] = high.y;
+                    maxZ[cluster] = high.z;
+                }
+            }
+        }
+    }
+
+    void gatherLights(const glm::mat4& view, const LightBlock& lights)
+    {
+        binned.clear();
+        const std::vector<LightBlock::Light>& all = lights.all();
+        for (size_t index = 0; index < all.size(); index++)
+        {
+            const LightBlock::Light& light = all[index];
+            glm::vec3 total = light.ambient + light.diffuse + light.specular;
+            float brightest = std::max(total.x, std::max(total.y, total.z));
+            if (brightest <= 0.0f)
+                continue;
+
+            // 1 / (k_c + k_l d + k_q d^2) = cutoff; never reached when k_c alone gets there
+            float c = light.k_c - 1.0f / light.cutoff;
+            float radius;
+            if (c >= 0.0f)
+                continue;
+            if (light.k_q > 0.0f)
+                radius = (-light.k_l + std::sqrt(light.k_l * light.k_l - 4.0f * light.k_q * c)) / (2.0f * light.k_q);
+            else if (light.k_l > 0.0f)
+                radius = -c / light.k_l;
+            else
+                radius = builtFar * 2.0f;   // no falloff: reaches everything
+
+            glm::vec4 center = view * glm::vec4(light.position, 1.0f);
+            float nearest = -center.z - radius, farthest = -center.z + radius;
+            if (farthest < builtNear || nearest > builtFar)
+                continue;
+
+            BinnedLight entry;
+            entry.x = center.x;
+            entry.y = center.y;
+            entry.z = center.z;
+            entry.radiusSquared = radius * radius;
+            entry.firstSlice = depthSlice(std::max(nearest, builtNear));
+            entry.lastSlice = depthSlice(std::min(farthest, builtFar));
+            entry.index = (uint16_t)index;
+            binned.push_back(entry);
+        }
+    }
+
+    // fills the lists of slices [first, last); touches nothing outside them
+    void binSlices(int first, int last)
+    {
+        for (int slice = first; slice < last; slice++)
+        {
+            for (const BinnedLight& light : binned)
+            {
+                if (slice < light.firstSlice || slice > light.lastSlice)
+                    continue;
+                for (int row = 0; row < rows; row++)
+                {
+                    size_t rowStart = ((size_t)slice * rows + row) * paddedColumns;
+                    for (int column = 0; column < columns; column += 4)
+                    {
+                        int hits = overlaps(light, rowStart + column);
+                        for (; hits; hits &= hits - 1)
+                        {
+                            int lane = lowestBit(hits);
+                            if (column + lane >= columns)
+                                break;
+                            size_t cluster = rowStart + column + lane;
+                            if (clusterCounts[cluster] < maxLightsPerCluster)
+                                clusterLights[cluster * maxLightsPerCluster + clusterCounts[cluster]++] = light.index;
+                            else
+                                sliceOverflows[slice]++;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    static int lowestBit(int mask)
+    {
+        int bit = 0;
+        while (!(mask & (1 << bit)))
+            bit++;
+        return bit;
+    }
+
+    // bit i set when the light's sphere touches the box of cluster first + i
+    int overlaps(const BinnedLight& light, size_t first) const
+    {
+#ifdef CLUSTER_SSE2
+        const __m128 zero = _mm_setzero_ps();
+        __m128 x = _mm_set1_ps(light.x), y = _mm_set1_ps(light.y), z = _mm_set1_ps(light.z);
+        // distance from the center to each box along each axis, 0 inside it
+        __m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&minX[first]), x), _mm_sub_ps(x, _mm_loadu_ps(&maxX[first]))), zero);
+        __m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&minY[first]), y), _mm_sub_ps(y, _mm_loadu_ps(&maxY[first]))), zero);
+        __m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&minZ[first]), z), _mm_sub_ps(z, _mm_loadu_ps(&maxZ[first]))), zero);
+        __m128 distanceSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+        return _mm_movemask_ps(_mm_cmple_ps(distanceSquared, _mm_set1_ps(light.radiusSquared)));
+#else
+        int mask = 0;
+        for (int lane = 0; lane < 4; lane++)
+        {
+            size_t cluster = first + lane;
+            float dx = std::max(std::max(minX[cluster] - light.x, light.x - maxX[cluster]), 0.0f);
+            float dy = std::max(std::max(minY[cluster] - light.y, light.y - maxY[cluster]), 0.0f);
+            float dz = std::max(std::max(minZ[cluster] - light.z, light.z - maxZ[cluster]), 0.0f);
+            if (dx * dx + dy * dy + dz * dz <= light.radiusSquared)
+                mask |= 1 << lane;
+        }
+        return mask;
+#endif
+    }
+
+    // the lists, in the shader's cluster order, without the padding columns
+    void pack()
+    {
+        records.resize((size_t)slices * rows * columns * 2);
+        indices.clear();
+        size_t record = 0;
+        for (int slice = 0; slice < slices; slice++)
+        {
+            for (int row = 0; row < rows; row++)
+            {
+                for (int column = 0; column < columns; column++)
+                {
+                    size_t cluster = ((size_t)slice * rows + row) * paddedColumns + column;
+                    const uint16_t* list = &clusterLights[cluster * maxLightsPerCluster];
+                    records[record++] = (uint32_t)indices.size();
+                    records[record++] = clusterCounts[cluster];
+                    indices.insert(indices.end(), list, list + clusterCounts[cluster]);
+                }
+            }
+        }
+        if (indices.empty())
+            indices.push_back(0);   // a buffer texture needs some storage
+    }
+
+    void upload()
+    {
+        if (!recordBuffer)
+        {
+            recordBuffer = GLBuffer::create();
+            recordTexture = GLTexture::create();
+            indexBuffer = GLBuffer::create();
+            indexTexture = GLTexture::create();
+        }
+        // new storage every frame, so the GPU can still read last frame's
+        glBindBuffer(GL_TEXTURE_BUFFER, recordBuffer.get());
+        glBufferData(GL_TEXTURE_BUFFER, records.size() * sizeof(uint32_t), records.data(), GL_STREAM_DRAW);
+        glBindBuffer(GL_TEXTURE_BUFFER, indexBuffer.get());
+        glBufferData(GL_TEXTURE_BUFFER, indices.size() * sizeof(uint16_t), indices.data(), GL_STREAM_DRAW);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+        glBindTexture(GL_TEXTURE_BUFFER, recordTexture.get());
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32UI, recordBuffer.get());
+        glBindTexture(GL_TEXTURE_BUFFER, indexTexture.get());
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_R16UI, indexBuffer.get());
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+    }
+};
+
+#endif /* clusterGrid_h */
@@ -14,6 +14,8 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include "shader.h"
+#include "shaderUniforms.h"
+#include "cubeMesh.h"
 
 using namespace std;
 
@@ -25,13 +27,17 @@ public:
     glm::vec3 diffuse;
     glm::vec3 specular;
 
-    // texture property
+    // texture property; the UV rectangle goes to the vertex shader per draw, the mesh itself is shared.
+    // The texture names belong to the TextureRegistry, so Cubes own no GL objects and copy freely.
     float TXmin = 0.0f;
     float TXmax = 1.0f;
     float TYmin = 0.0f;
     float TYmax = 1.0f;
     unsigned int diffuseMap;
-    unsigned int specularMap;
+    unsigned int specularMap;   // 0 when the specular mask is packed into diffuseMap's alpha
+    // layers of the shared material texture array, -1 when the cube uses its own textures
+    int diffuseLayer = -1;
+    int specularLayer = -1;     // -1 when packed into the diffuse layer's alpha
 
     // common property
     float shininess;
@@ -39,7 +45,6 @@ public:
     // constructors
     Cube()
     {
-        setUpCubeVertexDataAndConfigureVertexAttribute();
     }
 
     Cube(glm::vec3 amb, glm::vec3 diff, glm::vec3 spec, float shiny)
@@ -48,8 +53,6 @@ public:
         this->diffuse = diff;
         this->specular = spec;
         this->shininess = shiny;
-
-        setUpCubeVertexDataAndConfigureVertexAttribute();
     }
 
     Cube(unsigned int dMap, unsigned int sMap, float shiny, float textureXmin, float textureYmin, float textureXmax, float textureYmax)
@@ -61,66 +64,52 @@ public:
         this->TYmin = textureYmin;
         this->TXmax = textureXmax;
         this->TYmax = textureYmax;
-
-        setUpCubeVertexDataAndConfigureVertexAttribute();
-    }
-
-    // destructor
-    ~Cube()
-    {
-        glDeleteVertexArrays(1, &cubeVAO);
-        glDeleteVertexArrays(1, &lightCubeVAO);
-        glDeleteVertexArrays(1, &lightTexCubeVAO);
-        glDeleteBuffers(1, &cubeVBO);
-        glDeleteBuffers(1, &cubeEBO);
     }
 
-    void drawCubeWithTexture(Shader& lightingShaderWithTexture, glm::mat4 model = glm::mat4(1.0f))
+    // uniforms must be bound to lightingShaderWithTexture
+    void drawCubeWithTexture(Shader& lightingShaderWithTexture, const TexturedPhongUniforms& uniforms, glm::mat4 model = glm::mat4(1.0f))
     {
         lightingShaderWithTexture.use();
 
-        lightingShaderWithTexture.setInt("material.diffuse", 0);
-        lightingShaderWithTexture.setInt("material.specular", 1);
-        lightingShaderWithTexture.setFloat("material.shininess", this->shininess);
-
-
-        // bind diffuse map
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, this->diffuseMap);
-        // bind specular map
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, this->specularMap);
-
-        lightingShaderWithTexture.setMat4("model", model);
-
-        glBindVertexArray(lightTexCubeVAO);
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+        if (this->diffuseLayer >= 0)
+        {
+            // the texture array is bound once for the whole frame; only the layers change
+            uniforms.material.diffuseLayer.set(lightingShaderWithTexture, this->diffuseLayer);
+            if (this->specularLayer >= 0)
+                uniforms.material.specularLayer.set(lightingShaderWithTexture, this->specularLayer);
+        }
+        else
+        {
+            uniforms.material.diffuse.set(lightingShaderWithTexture, 0);
+
+            // bind diffuse map
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, this->diffuseMap);
+            // bind specular map
+            if (this->specularMap)
+            {
+                uniforms.material.specular.set(lightingShaderWithTexture, 1);
+                glActiveTexture(GL_TEXTURE1);
+                glBindTexture(GL_TEXTURE_2D, this->specularMap);
+            }
+        }
+        uniforms.material.shininess.set(lightingShaderWithTexture, this->shininess);
+        uniforms.uvRect.set(lightingShaderWithTexture, glm::vec4(this->TXmin, this->TYmin, this->TXmax, this->TYmax));
+
+        uniforms.model.set(lightingShaderWithTexture, model);
+
+        CubeMesh::shared().draw();
     }
 
-    void drawCubeWithMaterialisticProperty(Shader& lightingShader, glm::mat4 model = glm::mat4(1.0f))
-    {
-        lightingShader.use();
-
-        lightingShader.setVec3("material.ambient", this->ambient);
-        lightingShader.setVec3("material.diffuse", this->diffuse);
-        lightingShader.setVec3("material.specular", this->specular);
-        lightingShader.setFloat("material.shininess", this->shininess);
-
-        lightingShader.setMat4("model", model);
-
-        glBindVertexArray(lightCubeVAO);
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-    }
-
-    void drawCube(Shader& shader, glm::mat4 model = glm::mat4(1.0f), float r = 1.0f, float g = 1.0f, float b = 1.0f)
+    // uniforms must be bound to shader
+    void drawCube(Shader& shader, const FlatColorUniforms& uniforms, glm::mat4 model = glm::mat4(1.0f), float r = 1.0f, float g = 1.0f, float b = 1.0f)
     {
         shader.use();
 
-        shader.setVec3("color", glm::vec3(r, g, b));
-        shader.setMat4("model", model);
+        uniforms.color.set(shader, glm::vec3(r, g, b));
+        uniforms.model.set(shader, model);
 
-        glBindVertexArray(cubeVAO);
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+        CubeMesh::shared().drawPositions();
     }
 
     void setMaterialisticProperty(glm::vec3 amb, glm::vec3 diff, glm::vec3 spec, float shiny)
@@ -138,119 +127,11 @@ public:
         this->shininess = shiny;
     }
 
-private:
-    unsigned int cubeVAO;
-    unsigned int lightCubeVAO;
-    unsigned int lightTexCubeVAO;
-    unsigned int cubeVBO;
-    unsigned int cubeEBO;
-
-    void setUpCubeVertexDataAndConfigureVertexAttribute()
+    void setTextureLayers(int diffuseLayer, int specularLayer)
     {
-        // set up vertex data (and buffer(s)) and configure vertex attributes
-        // ------------------------------------------------------------------
-
-        float cube_vertices[] = {
-            // positions      // normals         // texture
-            0.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f, TXmax, TYmin,
-            1.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f, TXmin, TYmin,
-            1.0f, 1.0f, 0.0f, 0.0f, 0.0f, -1.0f, TXmin, TYmax,
-            0.0f, 1.0f, 0.0f, 0.0f, 0.0f, -1.0f, TXmax, TYmax,
-
-            1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, TXmax, TYmin,
-            1.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, TXmax, TYmax,
-            1.0f, 0.0f, 1.0f, 1.0f, 0.0f, 0.0f, TXmin, TYmin,
-            1.0f, 1.0f, 1.0f, 1.0f, 0.0f, 0.0f, TXmin, TYmax,
-
-            0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, TXmin, TYmin,
-            1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, TXmax, TYmin,
-            1.0f, 1.0f, 1.0f, 0.0f, 0.0f, 1.0f, TXmax, TYmax,
-            0.0f, 1.0f, 1.0f, 0.0f, 0.0f, 1.0f, TXmin, TYmax,
-
-            0.0f, 0.0f, 1.0f, -1.0f, 0.0f, 0.0f, TXmax, TYmin,
-            0.0f, 1.0f, 1.0f, -1.0f, 0.0f, 0.0f, TXmax, TYmax,
-            0.0f, 1.0f, 0.0f, -1.0f, 0.0f, 0.0f, TXmin, TYmax,
-            0.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f, TXmin, TYmin,
-
-            1.0f, 1.0f, 1.0f, 0.0f, 1.0f, 0.0f, TXmax, TYmin,
-            1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, TXmax, TYmax,
-            0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, TXmin, TYmax,
-            0.0f, 1.0f, 1.0f, 0.0f, 1.0f, 0.0f, TXmin, TYmin,
-
-            0.0f, 0.0f, 0.0f, 0.0f, -1.0f, 0.0f, TXmin, TYmin,
-            1.0f, 0.0f, 0.0f, 0.0f, -1.0f, 0.0f, TXmax, TYmin,
-            1.0f, 0.0f, 1.0f, 0.0f, -1.0f, 0.0f, TXmax, TYmax,
-            0.0f, 0.0f, 1.0f, 0.0f, -1.0f, 0.0f, TXmin, TYmax
-        };
-        unsigned int cube_indices[] = {
-            0, 3, 2,
-            2, 1, 0,
-
-            4, 5, 7,
-            7, 6, 4,
-
-            8, 9, 10,
-            10, 11, 8,
-
-            12, 13, 14,
-            14, 15, 12,
-
-            16, 17, 18,
-            18, 19, 16,
-
-            20, 21, 22,
-            22, 23, 20
-        };
-
-        glGenVertexArrays(1, &cubeVAO);
-        glGenVertexArrays(1, &lightCubeVAO);
-        glGenVertexArrays(1, &lightTexCubeVAO);
-        glGenBuffers(1, &cubeVBO);
-        glGenBuffers(1, &cubeEBO);
-
-
-        glBindVertexArray(lightTexCubeVAO);
-
-        glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(cube_vertices), cube_vertices, GL_STATIC_DRAW);
-
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cubeEBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(cube_indices), cube_indices, GL_STATIC_DRAW);
-
-        // position attribute
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(0);
-
-        // vertex normal attribute
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)12);
-        glEnableVertexAttribArray(1);
-
-        // texture coordinate attribute
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)24);
-        glEnableVertexAttribArray(2);
-
-
-        glBindVertexArray(lightCubeVAO);
-
-        glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cubeEBO);
-
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(0);
-
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)12);
-        glEnableVertexAttribArray(1);
-
-
-        glBindVertexArray(cubeVAO);
-
-        glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cubeEBO);
-
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(0);
+        this->diffuseLayer = diffuseLayer;
+        this->specularLayer = specularLayer;
     }
-
 };
 
 
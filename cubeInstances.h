@@ -0,0 +1,218 @@
+//
+//  cubeInstances.h
+//  test
+//
+//  Draws many unit cubes with one glDrawElementsInstanced per texture group,
+//  taking each cube's transform, UV rectangle and material from a per-instance buffer.
+//
+
+#ifndef cubeInstances_h
+#define cubeInstances_h
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+#include "cube.h"
+#include "cubeMesh.h"
+#include "glHandle.h"
+#include "shader.h"
+#include "shaderUniforms.h"
+
+// Instances are added once with their transform relative to the "model"
+// uniform, then upload() sorts them into groups that share textures (with
+// the material texture array that is a single group) and copies them into
+// one static instance buffer. Drawing a group is then a VAO bind and one
+// instanced draw, however many boxes it holds; the per-frame CPU cost no
+// longer grows with the box count.
+//
+// Shaders compiled with INSTANCED read the per-instance attributes:
+//   3-6   mat4 model transform
+//   7-9   mat3 normal matrix of that transform
+//   10    vec4 UV rectangle (u min, v min, u max, v max)
+//   11    vec3 material (diffuse layer, specular layer, shininess)
+// The scene-wide "model" and "normalMatrix" uniforms are applied on top.
+//
+// With positionsOnly the mesh side of the VAOs is CubeMesh's position stream
+// (if it has one), for shaders like the lamps' that read only aPos.
+//
+// The GL objects are owned through glHandle.h: instances move, never copy.
+class CubeInstances {
+public:
+    bool positionsOnly = false;     // read by upload()
+
+    // cube supplies UV rectangle, textures or layers and shininess; without one the box is untextured (e.g. a lamp)
+    void add(const glm::mat4& transform, const Cube* cube = nullptr)
+    {
+        Instance instance;
+        instance.model = transform;
+        instance.normal = glm::transpose(glm::inverse(glm::mat3(transform)));
+        instance.uvRect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+        instance.material = glm::vec3(0.0f);
+
+        PendingInstance pending;
+        pending.diffuseMap = 0;
+        pending.specularMap = 0;
+        if (cube)
+        {
+            instance.uvRect = glm::vec4(cube->TXmin, cube->TYmin, cube->TXmax, cube->TYmax);
+            instance.material = glm::vec3((float)cube->diffuseLayer, (float)cube->specularLayer, cube->shininess);
+            // with layers the texture array is bound once for everything
+            if (cube->diffuseLayer < 0)
+            {
+                pending.diffuseMap = cube->diffuseMap;
+                pending.specularMap = cube->specularMap;
+            }
+        }
+        pending.instance = instance;
+        pendingInstances.push_back(pending);
+    }
+
+    size_t size() const
+    {
+        return pendingInstances.size();
+    }
+
+    size_t groupCount() const
+    {
+        return groups.size();
+    }
+
+    // builds the instance buffer and one VAO per texture group; call after the last add()
+    void upload()
+    {
+        releaseGroups();
+        if (pendingInstances.empty())
+            return;
+
+        std::vector<PendingInstance> sorted = pendingInstances;
+        std::stable_sort(sorted.begin(), sorted.end(), [](const PendingInstance& a, const PendingInstance& b) {
+            return a.diffuseMap != b.diffuseMap ? a.diffuseMap < b.diffuseMap : a.specularMap < b.specularMap;
+        });
+
+        std::vector<Instance> instances;
+        instances.reserve(sorted.size());
+        for (const PendingInstance& pending : sorted)
+        {
+            if (groups.empty() || groups.back().diffuseMap != pending.diffuseMap || groups.back().specularMap != pending.specularMap)
+                groups.push_back(Group{ GLVertexArray(), pending.diffuseMap, pending.specularMap, (GLsizei)instances.size(), 0 });
+            groups.back().count++;
+            instances.push_back(pending.instance);
+        }
+
+        if (!instanceVBO)
+            instanceVBO = GLBuffer::create();
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO.get());
+        glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(Instance), instances.data(), GL_STATIC_DRAW);
+
+        // GL 3.3 has no base instance, so each group gets a VAO whose instance attributes start at its first instance
+        for (Group& group : groups)
+        {
+            group.VAO = GLVertexArray::create();
+            glBindVertexArray(group.VAO.get());
+            if (positionsOnly)
+                CubeMesh::shared().configurePositionVertexArray();
+            else
+                CubeMesh::shared().configureVertexArray();
+
+            glBindBuffer(GL_ARRAY_BUFFER, instanceVBO.get());
+            size_t base = (size_t)group.first * sizeof(Instance);
+            for (int column = 0; column < 4; column++)
+                instanceAttribute(3 + column, 4, base + offsetof(Instance, model) + column * sizeof(glm::vec4));
+            for (int column = 0; column < 3; column++)
+                instanceAttribute(7 + column, 3, base + offsetof(Instance, normal) + column * sizeof(glm::vec3));
+            instanceAttribute(10, 4, base + offsetof(Instance, uvRect));
+            instanceAttribute(11, 3, base + offsetof(Instance, material));
+        }
+        glBindVertexArray(0);
+    }
+
+    // the shader must be in use, with its INSTANCED path, uniforms bound to it and the scene model/normalMatrix set
+    void draw(const Shader& shader, const TexturedPhongUniforms& uniforms) const
+    {
+        for (const Group& group : groups)
+        {
+            if (group.diffuseMap)
+            {
+                uniforms.material.diffuse.set(shader, 0);
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, group.diffuseMap);
+                if (group.specularMap)
+                {
+                    uniforms.material.specular.set(shader, 1);
+                    glActiveTexture(GL_TEXTURE1);
+                    glBindTexture(GL_TEXTURE_2D, group.specularMap);
+                }
+            }
+
+            glBindVertexArray(group.VAO.get());
+            CubeMesh::shared().drawInstanced(group.count, positionsOnly);
+        }
+    }
+
+    // untextured instances (lamps) set no uniforms of their own; the shader must be in use
+    void draw() const
+    {
+        for (const Group& group : groups)
+        {
+            glBindVertexArray(group.VAO.get());
+            CubeMesh::shared().drawInstanced(group.count, positionsOnly);
+        }
+    }
+
+    void clear()
+    {
+        pendingInstances.clear();
+        releaseGroups();
+    }
+
+    void release()
+    {
+        releaseGroups();
+        instanceVBO.reset();
+    }
+
+private:
+    // matches the attribute layout above; all floats, so there is no padding
+    struct Instance {
+        glm::mat4 model;
+        glm::mat3 normal;
+        glm::vec4 uvRect;
+        glm::vec3 material;
+    };
+
+    struct PendingInstance {
+        Instance instance;
+        unsigned int diffuseMap;
+        unsigned int specularMap;
+    };
+
+    struct Group {
+        GLVertexArray VAO;
+        unsigned int diffuseMap;
+        unsigned int specularMap;
+        GLsizei first;
+        GLsizei count;
+    };
+
+    std::vector<PendingInstance> pendingInstances;
+    std::vector<Group> groups;
+    GLBuffer instanceVBO;
+
+    static void instanceAttribute(GLuint location, GLint size, size_t offset)
+    {
+        glVertexAttribPointer(location, size, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)offset);
+        glEnableVertexAttribArray(location);
+        glVertexAttribDivisor(location, 1);
+    }
+
+    void releaseGroups()
+    {
+        groups.clear();
+    }
+};
+
+#endif /* cubeInstances_h */
@@ -0,0 +1,198 @@
+//
+//  cubeMesh.h
+//  test
+//
+//  The unit cube's vertices and indices, uploaded once and shared by every Cube.
+//
+
+#ifndef cubeMesh_h
+#define cubeMesh_h
+
+#include <glad/glad.h>
+
+#include "meshArena.h"
+#include "packedMesh.h"
+
+// The 24 vertices of the unit cube (position, normal, texture coordinate)
+// and its 36 indices, stored once in the shared MeshArena and drawn with the
+// arena's VAO for the format. Shaders that only read the position (or
+// position and normal) can draw from the same VAO, since attributes a
+// program does not declare are never fetched, though the cache lines they
+// share with the position still are. Texture coordinates run 0..1
+// across every face; each Cube's own UV rectangle is applied in the vertex
+// shader from its uvRect uniform.
+//
+// The GPU copy uses the float or the compact vertex format (see PackedMesh).
+// The unit cube spans exactly 0..1, so compact positions decode without
+// any change to the model matrix.
+//
+// With setPositionStream(true) the positions are also stored on their own
+// and drawPositions() reads only those, sharing the index buffer; passes
+// that need nothing but the position (lamps, depth only) then fetch 12 (or
+// 8) bytes per vertex instead of the whole interleaved vertex.
+class CubeMesh {
+public:
+    static const int vertexCount = 24;
+    static const int indexCount = 36;
+    static const int floatsPerVertex = 8;   // position, normal, texture coordinate
+
+    // the vertex table, vertexCount * floatsPerVertex floats; also baked by StaticBatch
+    static const float* vertices()
+    {
+        static const float cube_vertices[vertexCount * floatsPerVertex] = {
+            // positions      // normals         // texture
+            0.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f,
+            1.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f,
+            1.0f, 1.0f, 0.0f, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f,
+            0.0f, 1.0f, 0.0f, 0.0f, 0.0f, -1.0f, 1.0f, 1.0f,
+
+            1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f,
+            1.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f,
+            1.0f, 0.0f, 1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f,
+            1.0f, 1.0f, 1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f,
+
+            0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f,
+            1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f,
+            1.0f, 1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f,
+            0.0f, 1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f,
+
+            0.0f, 0.0f, 1.0f, -1.0f, 0.0f, 0.0f, 1.0f, 0.0f,
+            0.0f, 1.0f, 1.0f, -1.0f, 0.0f, 0.0f, 1.0f, 1.0f,
+            0.0f, 1.0f, 0.0f, -1.0f, 0.0f, 0.0f, 0.0f, 1.0f,
+            0.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f,
+
+            1.0f, 1.0f, 1.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f,
+            1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f,
+            0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f,
+            0.0f, 1.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f,
+
+            0.0f, 0.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f, 0.0f,
+            1.0f, 0.0f, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f,
+            1.0f, 0.0f, 1.0f, 0.0f, -1.0f, 0.0f, 1.0f, 1.0f,
+            0.0f, 0.0f, 1.0f, 0.0f, -1.0f, 0.0f, 0.0f, 1.0f
+        };
+        return cube_vertices;
+    }
+
+    static const unsigned int* indices()
+    {
+        static const unsigned int cube_indices[indexCount] = {
+            0, 3, 2,
+            2, 1, 0,
+
+            4, 5, 7,
+            7, 6, 4,
+
+            8, 9, 10,
+            10, 11, 8,
+
+            12, 13, 14,
+            14, 15, 12,
+
+            16, 17, 18,
+            18, 19, 16,
+
+            20, 21, 22,
+            22, 23, 20
+        };
+        return cube_indices;
+    }
+
+    static CubeMesh& shared()
+    {
+        static CubeMesh mesh;
+        return mesh;
+    }
+
+    CubeMesh(const CubeMesh&) = delete;
+    CubeMesh& operator=(const CubeMesh&) = delete;
+
+    // takes effect when the mesh is next uploaded; vertex arrays configured earlier must be rebuilt
+    void setVertexFormat(VertexFormat format)
+    {
+        if (format != this->format)
+            release();
+        this->format = format;
+    }
+
+    VertexFormat vertexFormat() const
+    {
+        return format;
+    }
+
+    // like setVertexFormat, takes effect when the mesh is next uploaded
+    void setPositionStream(bool enabled)
+    {
+        if (enabled != positionStream)
+            release();
+        positionStream = enabled;
+    }
+
+
+    // the mesh is uploaded on the first draw, with the context current
+    void draw()
+    {
+        if (!upload())
+            return;
+        MeshArena::shared().bind(mesh);
+        glDrawElementsBaseVertex(GL_TRIANGLES, indexCount, mesh.indexType, (void*)mesh.indexOffset(), mesh.baseVertex);
+    }
+
+    // for shaders that read only attribute 0; the same as draw() without a position stream
+    void drawPositions()
+    {
+        if (!upload())
+            return;
+        MeshArena::shared().bindPositions(mesh);
+        glDrawElementsBaseVertex(GL_TRIANGLES, indexCount, mesh.indexType, (void*)mesh.indexOffset(), mesh.positionBaseVertex);
+    }
+
+    // instanceCount cubes from a VAO set up with configureVertexArray() (or configurePositionVertexArray() and positions)
+    void drawInstanced(GLsizei instanceCount, bool positions = false)
+    {
+        glDrawElementsInstancedBaseVertex(GL_TRIANGLES, indexCount, mesh.indexType, (void*)mesh.indexOffset(), instanceCount,
+                                          positions ? mesh.positionBaseVertex : mesh.baseVertex);
+    }
+
+    // points attributes 0-2 of the currently bound VAO at the mesh and attaches its index
+    // buffer, for vertex arrays that add attributes of their own (e.g. per instance)
+    void configureVertexArray()
+    {
+        upload();
+        MeshArena::shared().configureVertexArray(format);
+    }
+
+    // the same for attribute 0 alone, from the position stream when there is one
+    void configurePositionVertexArray()
+    {
+        upload();
+        if (mesh.hasPositionStream())
+            MeshArena::shared().configurePositionVertexArray(format);
+        else
+            MeshArena::shared().configureVertexArray(format);
+    }
+
+    // call before the GL context goes away (and before MeshArena's release()); a later draw() uploads the mesh again
+    void release()
+    {
+        MeshArena::shared().remove(mesh);
+    }
+
+private:
+    VertexFormat format = VERTEX_FORMAT_FLOAT;
+    bool positionStream = false;
+    MeshArena::Mesh mesh;
+
+    CubeMesh()
+    {
+    }
+
+    bool upload()
+    {
+        if (mesh.empty())
+            MeshArena::shared().add(PackedMesh::pack(format, vertices(), vertexCount, indices(), indexCount, positionStream), mesh);
+        return !mesh.empty();
+    }
+};
+
+#endif /* cubeMesh_h */
@@ -0,0 +1,151 @@
+//
+//  decodeBenchmark.cpp
+//  test
+//
+//  Times stb_image decoding of the scene's images from memory, once per
+//  SIMD level the decoders can be limited to (generic C, SSE2, AVX2), and
+//  checks every level produces exactly the same pixels as generic C.
+//
+//  usage: DecodeBenchmark [-n iterations] [-c components] [-s scale shift] [image ...]
+//
+//  -c picks the requested component count: 0 (the default) keeps the file's
+//  own, as TextureRegistry does; 4 is what TextureArray asks for.
+//  -s decodes JPEGs at 1 / (1 << shift) of their size (0-3), as textureQuality does.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "stb_image.h"
+
+using namespace std;
+
+struct Timing {
+    double best;
+    double mean;
+};
+
+static const char* levelNames[] = { "generic", "sse2", "avx2" };
+
+bool readFile(const string& path, vector<unsigned char>& bytes)
+{
+    ifstream file(path, ios::binary);
+    if (!file)
+        return false;
+    bytes.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+    return !bytes.empty();
+}
+
+const char* formatName(const vector<unsigned char>& bytes)
+{
+    if (bytes.size() >= 2 && bytes[0] == 0xFF && bytes[1] == 0xD8)
+        return "jpeg";
+    if (bytes.size() >= 8 && memcmp(bytes.data(), "\x89PNG\r\n\x1a\n", 8) == 0)
+        return "png";
+    return "other";
+}
+
+// decodes the file iterations times; pixels receives the last decode
+bool timeDecode(const vector<unsigned char>& bytes, int components, int scaleShift, int iterations, vector<unsigned char>& pixels, Timing& timing)
+{
+    timing.best = 1e30;
+    double total = 0.0;
+    for (int i = 0; i < iterations; i++)
+    {
+        int width, height, nrComponents;
+        auto start = chrono::steady_clock::now();
+        unsigned char* data = stbi_load_from_memory_scaled(bytes.data(), (int)bytes.size(), &width, &height, &nrComponents, components, scaleShift);
+        double milliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        if (!data)
+            return false;
+
+        timing.best = min(timing.best, milliseconds);
+        total += milliseconds;
+        if (i == iterations - 1)
+            pixels.assign(data, data + (size_t)width * height * (components ? components : nrComponents));
+        stbi_image_free(data);
+    }
+    timing.mean = total / iterations;
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    int iterations = 10;
+    int components = 0;
+    int scaleShift = 0;
+    vector<string> paths;
+
+    for (int i = 1; i < argc; i++)
+    {
+        string argument = argv[i];
+        if (argument == "-n" && i + 1 < argc)
+            iterations = max(1, atoi(argv[++i]));
+        else if (argument == "-c" && i + 1 < argc)
+            components = atoi(argv[++i]);
+        else if (argument == "-s" && i + 1 < argc)
+            scaleShift = min(3, max(0, atoi(argv[++i])));
+        else
+            paths.push_back(argument);
+    }
+
+    if (paths.empty())
+        paths = { "wall.jpg", "floor.jpg", "celling.jpg", "ghost.jpg", "container2.png", "container2_specular.png", "emoji.png", "whiteBackground.png" };
+
+    cout << fixed << setprecision(2);
+    double totals[3] = { 0.0, 0.0, 0.0 };
+    int failures = 0;
+    for (const string& path : paths)
+    {
+        vector<unsigned char> bytes;
+        int width, height, nrComponents;
+        if (!readFile(path, bytes) || !stbi_info_from_memory_scaled(bytes.data(), (int)bytes.size(), &width, &height, &nrComponents, scaleShift))
+        {
+            cout << path << ": failed to read" << endl;
+            failures++;
+            continue;
+        }
+
+        cout << path << " (" << formatName(bytes) << ", " << width << "x" << height << ", " << nrComponents << " components)" << endl;
+
+        vector<unsigned char> reference;
+        for (int level = 0; level < 3; level++)
+        {
+            stbi_set_simd_level(level);
+            vector<unsigned char> pixels;
+            Timing timing;
+            if (!timeDecode(bytes, components, scaleShift, iterations, pixels, timing))
+            {
+                cout << "  " << levelNames[level] << ": decode failed: " << stbi_failure_reason() << endl;
+                failures++;
+                break;
+            }
+            totals[level] += timing.best;
+
+            cout << "  " << setw(8) << left << levelNames[level] << right
+                 << " best " << setw(8) << timing.best << " ms, mean " << setw(8) << timing.mean << " ms, "
+                 << setw(7) << width * (double)height / (timing.best * 1000.0) << " Mpixel/s";
+            if (level == 0)
+                reference = pixels;
+            else if (pixels != reference)
+            {
+                cout << "  MISMATCH against generic";
+                failures++;
+            }
+            cout << endl;
+        }
+    }
+    stbi_set_simd_level(2);
+
+    // levels the CPU lacks fall back to the next lower one, so their times just repeat it
+    cout << "Total (best of " << iterations << "): generic " << totals[0] << " ms, sse2 " << totals[1] << " ms, avx2 " << totals[2] << " ms" << endl;
+    return failures == 0 ? 0 : 1;
+}
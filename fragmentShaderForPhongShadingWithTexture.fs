@@ -1,53 +1,131 @@
 #version 330 core
 out vec4 FragColor;
 
+// with SPECULAR_IN_ALPHA the specular mask is the diffuse texture's alpha
 struct Material {
+#ifdef TEXTURE_ARRAY
+    int diffuseLayer;   // layers of materialMaps
+#ifndef SPECULAR_IN_ALPHA
+    int specularLayer;
+#endif
+#else
     sampler2D diffuse;
+#ifndef SPECULAR_IN_ALPHA
     sampler2D specular;
+#endif
+#endif
     float shininess;
 };
 
+// each scalar fills the vec3 before it up to 16 bytes, so a light is 64 bytes in std140
 struct PointLight {
     vec3 position;
-    
     float k_c;  // attenuation factors
-    float k_l;  // attenuation factors
-    float k_q;  // attenuation factors
-    
     vec3 ambient;
+    float k_l;  // attenuation factors
     vec3 diffuse;
+    float k_q;  // attenuation factors
     vec3 specular;
+    float cutoff;   // attenuation at the edge of the light's reach, see LightBlock
 };
 
-#define NR_POINT_LIGHTS 4
+#define MAX_POINT_LIGHTS 255     // 16 + 255 * 64 bytes fits the 16 KB every GL 3.3 driver allows a block
 
 in vec3 FragPos;
 in vec3 Normal;
 in vec2 TexCoords;
+#if defined(INSTANCED) || defined(PROCEDURAL_BOXES)
+flat in vec3 InstanceMaterial;  // (diffuse layer, specular layer, shininess), replacing material's
+#endif
 
-uniform vec3 viewPos;
-uniform PointLight pointLights[NR_POINT_LIGHTS];
+// the same block as the vertex shader
+layout (std140) uniform CameraBlock
+{
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+};
+// the scene's lights, the first pointLightCount of them live; see LightBlock
+layout (std140) uniform LightBlock
+{
+    int pointLightCount;
+    PointLight pointLights[MAX_POINT_LIGHTS];
+};
 uniform Material material;
+#ifdef TEXTURE_ARRAY
+uniform sampler2DArray materialMaps;
+#endif
+#ifdef CLUSTERED_LIGHTS
+// the lights reaching each cluster of a view-space grid, see ClusterGrid
+uniform usamplerBuffer clusterRecords;      // (first index, light count) per cluster
+uniform usamplerBuffer clusterLightIndices; // into pointLights
+uniform vec2 clusterTileSize;               // pixels per column and row
+uniform vec2 clusterDepthScaleBias;         // slice = log(view depth) * x + y
+uniform int clusterColumns;
+uniform int clusterRows;
+uniform int clusterSlices;
+#endif
 
 // function prototypes
-vec3 CalcPointLight(Material material, PointLight light, vec3 N, vec3 fragPos, vec3 V);
+vec3 CalcPointLight(PointLight light, vec3 N, vec3 fragPos, vec3 V, vec3 diffuseColor, vec3 specularColor, float shininess);
 
 void main()
 {
     // properties
     vec3 N = normalize(Normal);
     vec3 V = normalize(viewPos - FragPos);
+#if defined(INSTANCED) || defined(PROCEDURAL_BOXES)
+    int diffuseLayer = int(InstanceMaterial.x);
+    int specularLayer = int(InstanceMaterial.y);
+    float shininess = InstanceMaterial.z;
+#elif defined(TEXTURE_ARRAY)
+    int diffuseLayer = material.diffuseLayer;
+#ifndef SPECULAR_IN_ALPHA
+    int specularLayer = material.specularLayer;
+#endif
+    float shininess = material.shininess;
+#else
+    float shininess = material.shininess;
+#endif
+
+    // the maps are the same for every light, so they are sampled once here
+#ifdef TEXTURE_ARRAY
+    vec4 diffuseTexel = texture(materialMaps, vec3(TexCoords, diffuseLayer));
+#else
+    vec4 diffuseTexel = texture(material.diffuse, TexCoords);
+#endif
+#if defined(SPECULAR_IN_ALPHA)
+    vec3 specularColor = vec3(diffuseTexel.a);
+#elif defined(TEXTURE_ARRAY)
+    vec3 specularColor = vec3(texture(materialMaps, vec3(TexCoords, specularLayer)));
+#else
+    vec3 specularColor = vec3(texture(material.specular, TexCoords));
+#endif
+    vec3 diffuseColor = vec3(diffuseTexel);
     
-    vec3 result;
+    vec3 result = vec3(0.0);
     // point lights
-    for(int i = 0; i < NR_POINT_LIGHTS; i++)
-        result += CalcPointLight(material, pointLights[i], N, FragPos, V);
+#ifdef CLUSTERED_LIGHTS
+    // only those binned into this fragment's cluster
+    float viewDepth = -(view * vec4(FragPos, 1.0)).z;
+    int slice = clamp(int(log(viewDepth) * clusterDepthScaleBias.x + clusterDepthScaleBias.y), 0, clusterSlices - 1);
+    ivec2 tile = min(ivec2(gl_FragCoord.xy / clusterTileSize), ivec2(clusterColumns - 1, clusterRows - 1));
+    uvec2 record = texelFetch(clusterRecords, (slice * clusterRows + tile.y) * clusterColumns + tile.x).xy;
+    for(uint i = 0u; i < record.y; i++)
+    {
+        int light = int(texelFetch(clusterLightIndices, int(record.x + i)).x);
+        result += CalcPointLight(pointLights[light], N, FragPos, V, diffuseColor, specularColor, shininess);
+    }
+#else
+    for(int i = 0; i < pointLightCount; i++)
+        result += CalcPointLight(pointLights[i], N, FragPos, V, diffuseColor, specularColor, shininess);
+#endif
       
     FragColor = vec4(result, 1.0);
 }
 
 // calculates the color when using a point light.
-vec3 CalcPointLight(Material material, PointLight light, vec3 N, vec3 fragPos, vec3 V)
+vec3 CalcPointLight(PointLight light, vec3 N, vec3 fragPos, vec3 V, vec3 diffuseColor, vec3 specularColor, float shininess)
 {
     vec3 L = normalize(light.position - fragPos);
     vec3 R = reflect(-L, N);
@@ -55,10 +133,12 @@ vec3 CalcPointLight(Material material, PointLight light, vec3 N, vec3 fragPos, v
     // attenuation
     float d = length(light.position - fragPos);
     float attenuation = 1.0 / (light.k_c + light.k_l * d + light.k_q * (d * d));
-    
-    vec3 ambient = vec3(texture(material.diffuse, TexCoords)) * light.ambient;
-    vec3 diffuse = vec3(texture(material.diffuse, TexCoords)) * max(dot(N, L), 0.0) * light.diffuse;
-    vec3 specular = vec3(texture(material.specular, TexCoords)) * pow(max(dot(V, R), 0.0), material.shininess) * light.specular;
+    // rescaled to reach 0 at the cutoff, so lights end where ClusterGrid stops binning them
+    attenuation = max((attenuation - light.cutoff) / (1.0 - light.cutoff), 0.0);
+
+    vec3 ambient = diffuseColor * light.ambient;
+    vec3 diffuse = diffuseColor * max(dot(N, L), 0.0) * light.diffuse;
+    vec3 specular = specularColor * pow(max(dot(V, R), 0.0), shininess) * light.specular;
     
     ambient *= attenuation;
     diffuse *= attenuation;
@@ -0,0 +1,114 @@
+//
+//  frameRing.h
+//  test
+//
+//  Per-frame scratch space in one GL buffer for data written every frame
+//  (uniform blocks and the like), without waiting on the GPU.
+//
+
+#ifndef frameRing_h
+#define frameRing_h
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+#include "glHandle.h"
+
+// The buffer is split into frameCount segments and each frame takes the
+// next one, filling it linearly: push() copies data at the current offset
+// and returns where it went. A segment is written again only after the
+// fence placed at the end of the frame that last used it has signaled, so
+// with 3 segments the CPU can run up to two frames ahead and the mapping
+// can be unsynchronized, like PixelUnpackRing's.
+//
+// Call beginFrame() before the first push() of a frame and endFrame() after
+// the frame's last draw that reads it.
+class FrameRing {
+public:
+    explicit FrameRing(size_t bytesPerFrame = 64 * 1024, unsigned int frameCount = 3)
+    {
+        this->bytesPerFrame = bytesPerFrame;
+        fences.resize(frameCount, nullptr);
+    }
+
+    void beginFrame()
+    {
+        if (!buffer)
+        {
+            buffer = GLBuffer::create();
+            glBindBuffer(GL_COPY_WRITE_BUFFER, buffer.get());
+            glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)(bytesPerFrame * fences.size()), NULL, GL_STREAM_DRAW);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        }
+
+        frame = (frame + 1) % fences.size();
+        GLsync& fence = fences[frame];
+        if (fence)
+        {
+            // only blocks when the CPU is a whole ring of frames ahead
+            glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+        cursor = 0;
+    }
+
+    // copies size bytes into this frame's segment at the given alignment and returns their
+    // offset in name(), or (size_t)-1 when the segment is full
+    size_t push(const void* data, size_t size, size_t alignment = 4)
+    {
+        size_t start = (cursor + alignment - 1) / alignment * alignment;
+        if (start + size > bytesPerFrame)
+            return (size_t)-1;
+
+        size_t offset = frame * bytesPerFrame + start;
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer.get());
+        void* mapped = glMapBufferRange(GL_COPY_WRITE_BUFFER, (GLintptr)offset, (GLsizeiptr)size,
+                                        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        if (mapped)
+        {
+            memcpy(mapped, data, size);
+            glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+        }
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        if (!mapped)
+            return (size_t)-1;
+
+        cursor = start + size;
+        return offset;
+    }
+
+    void endFrame()
+    {
+        fences[frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    GLuint name() const
+    {
+        return buffer.get();
+    }
+
+    // call before the GL context goes away
+    void release()
+    {
+        for (GLsync& fence : fences)
+        {
+            if (fence)
+                glDeleteSync(fence);
+            fence = nullptr;
+        }
+        buffer.reset();
+    }
+
+private:
+    size_t bytesPerFrame;
+    std::vector<GLsync> fences;     // one per segment
+    size_t frame = 0;
+    size_t cursor = 0;
+    GLBuffer buffer;
+};
+
+#endif /* frameRing_h */
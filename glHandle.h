@@ -0,0 +1,154 @@
+//
+//  glHandle.h
+//  test
+//
+//  Move-only owners for GL object names: the name is deleted exactly once,
+//  by whichever handle holds it last.
+//
+
+#ifndef glHandle_h
+#define glHandle_h
+
+#include <glad/glad.h>
+
+// A GLHandle owns one name (0 means none). It cannot be copied, so a class
+// holding handles cannot be copied by accident and delete the same names
+// twice; moving transfers the name and leaves the source empty, which makes
+// such classes safe to keep in std::vector. Deletion needs the GL context
+// current, so objects that outlive it call reset() (or their own release())
+// before the context goes away.
+//
+// Traits supplies the GL calls:
+//   static GLuint create();
+//   static void destroy(GLuint name);
+template <typename Traits>
+class GLHandle {
+public:
+    GLHandle()
+    {
+    }
+
+    // takes ownership of a name created elsewhere
+    explicit GLHandle(GLuint name) : name(name)
+    {
+    }
+
+    ~GLHandle()
+    {
+        reset();
+    }
+
+    GLHandle(const GLHandle&) = delete;
+    GLHandle& operator=(const GLHandle&) = delete;
+
+    GLHandle(GLHandle&& other) noexcept : name(other.name)
+    {
+        other.name = 0;
+    }
+
+    GLHandle& operator=(GLHandle&& other) noexcept
+    {
+        if (this != &other)
+        {
+            reset();
+            name = other.name;
+            other.name = 0;
+        }
+        return *this;
+    }
+
+    static GLHandle create()
+    {
+        return GLHandle(Traits::create());
+    }
+
+    GLuint get() const
+    {
+        return name;
+    }
+
+    explicit operator bool() const
+    {
+        return name != 0;
+    }
+
+    // deletes the name held, if any, and takes ownership of newName
+    void reset(GLuint newName = 0)
+    {
+        if (name)
+            Traits::destroy(name);
+        name = newName;
+    }
+
+    // gives up ownership without deleting
+    GLuint detach()
+    {
+        GLuint detached = name;
+        name = 0;
+        return detached;
+    }
+
+private:
+    GLuint name = 0;
+};
+
+struct GLBufferTraits {
+    static GLuint create()
+    {
+        GLuint name;
+        glGenBuffers(1, &name);
+        return name;
+    }
+
+    static void destroy(GLuint name)
+    {
+        glDeleteBuffers(1, &name);
+    }
+};
+
+struct GLVertexArrayTraits {
+    static GLuint create()
+    {
+        GLuint name;
+        glGenVertexArrays(1, &name);
+        return name;
+    }
+
+    static void destroy(GLuint name)
+    {
+        glDeleteVertexArrays(1, &name);
+    }
+};
+
+struct GLTextureTraits {
+    static GLuint create()
+    {
+        GLuint name;
+        glGenTextures(1, &name);
+        return name;
+    }
+
+    static void destroy(GLuint name)
+    {
+        glDeleteTextures(1, &name);
+    }
+};
+
+struct GLProgramTraits {
+    static GLuint create()
+    {
+        return glCreateProgram();
+    }
+
+    static void destroy(GLuint name)
+    {
+        glDeleteProgram(name);
+    }
+};
+
+typedef GLHandle<GLBufferTraits> GLBuffer;
+typedef GLHandle<GLVertexArrayTraits> GLVertexArray;
+typedef GLHandle<GLTextureTraits> GLTexture;
+typedef GLHandle<GLProgramTraits> GLProgram;
+
+#endif /* glHandle_h */
@@ -0,0 +1,159 @@
+//
+//  ktxTexture.h
+//  test
+//
+//  Reader/writer for the subset of KTX 1.1 produced by the texture baker:
+//  a single 2D image with a full chain of block-compressed mip levels.
+//
+
+#ifndef ktxTexture_h
+#define ktxTexture_h
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_RED_RGTC1
+#define GL_COMPRESSED_RED_RGTC1 0x8DBB
+#endif
+
+class KtxTexture {
+public:
+    struct Level {
+        uint32_t width;
+        uint32_t height;
+        size_t offset;      // into the buffer passed to parse()
+        uint32_t size;
+    };
+
+    GLenum internalFormat = 0;
+    GLenum baseInternalFormat = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<Level> levels;
+
+    // BC1 and BC4 store a 4x4 block in 8 bytes, BC3 in 16
+    static uint32_t blockBytes(GLenum format)
+    {
+        return format == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT ? 16 : 8;
+    }
+
+    static uint32_t levelSize(GLenum format, uint32_t levelWidth, uint32_t levelHeight)
+    {
+        return ((levelWidth + 3) / 4) * ((levelHeight + 3) / 4) * blockBytes(format);
+    }
+
+    static bool isKtx(const unsigned char* bytes, size_t size)
+    {
+        return size >= identifierSize && memcmp(bytes, identifier(), identifierSize) == 0;
+    }
+
+    // where the baker writes the baked version of a source image: "dir/wall.jpg" -> "dir/wall.ktx";
+    // a dot in a directory name ("v1.2/wall") is not an extension, so that gives "v1.2/wall.ktx"
+    static std::string bakedPath(const std::string& sourcePath)
+    {
+        size_t dot = sourcePath.find_last_of('.');
+        size_t slash = sourcePath.find_last_of("/\\");
+        if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+            return sourcePath + ".ktx";
+        return sourcePath.substr(0, dot) + ".ktx";
+    }
+
+    // where the baker writes a diffuse image with a specular mask packed into its alpha, as BC3:
+    // ("dir/wall.jpg", "maps/floor.jpg") -> "dir/wall+floor.ktx"
+    static std::string packedBakedPath(const std::string& diffusePath, const std::string& maskPath)
+    {
+        std::string diffuse = bakedPath(diffusePath);
+        size_t slash = maskPath.find_last_of("/\\");
+        return diffuse.substr(0, diffuse.size() - 4) + "+" + bakedPath(maskPath.substr(slash == std::string::npos ? 0 : slash + 1));
+    }
+
+    // fills in the header fields and level table; the level data stays in bytes
+    bool parse(const unsigned char* bytes, size_t size)
+    {
+        if (!isKtx(bytes, size) || size < headerSize)
+            return false;
+
+        uint32_t header[13];
+        memcpy(header, bytes + identifierSize, sizeof(header));
+        if (header[0] != 0x04030201 || header[1] != 0 || header[8] != 0 || header[9] != 0 || header[10] != 1)
+            return false;
+
+        internalFormat = header[4];
+        baseInternalFormat = header[5];
+        width = header[6];
+        height = header[7];
+        if (internalFormat != GL_COMPRESSED_RGB_S3TC_DXT1_EXT && internalFormat != GL_COMPRESSED_RGBA_S3TC_DXT5_EXT &&
+            internalFormat != GL_COMPRESSED_RED_RGTC1)
+            return false;
+
+        uint32_t levelCount = header[11] == 0 ? 1 : header[11];
+        size_t offset = headerSize + header[12];
+        levels.clear();
+        for (uint32_t level = 0; level < levelCount; level++)
+        {
+            uint32_t imageSize;
+            if (offset + 4 > size)
+                return false;
+            memcpy(&imageSize, bytes + offset, 4);
+            offset += 4;
+
+            Level entry;
+            entry.width = width >> level ? width >> level : 1;
+            entry.height = height >> level ? height >> level : 1;
+            entry.offset = offset;
+            entry.size = imageSize;
+            if (imageSize != levelSize(internalFormat, entry.width, entry.height) || offset + imageSize > size)
+                return false;
+            levels.push_back(entry);
+
+            offset += (imageSize + 3) & ~3u;
+        }
+        return true;
+    }
+
+    // levelData[i] holds level i, each exactly levelSize() bytes
+    static bool write(const char* path, GLenum format, uint32_t width, uint32_t height, const std::vector<std::vector<unsigned char>>& levelData)
+    {
+        std::ofstream file(path, std::ios::binary);
+        if (!file)
+            return false;
+
+        GLenum baseFormat = format == GL_COMPRESSED_RED_RGTC1 ? GL_RED : format == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT ? GL_RGBA : GL_RGB;
+        uint32_t header[13] = { 0x04030201, 0, 1, 0, format, baseFormat, width, height, 0, 0, 1, (uint32_t)levelData.size(), 0 };
+        file.write((const char*)identifier(), identifierSize);
+        file.write((const char*)header, sizeof(header));
+
+        for (const std::vector<unsigned char>& level : levelData)
+        {
+            uint32_t imageSize = (uint32_t)level.size();
+            file.write((const char*)&imageSize, 4);
+            file.write((const char*)level.data(), level.size());
+            static const char padding[3] = { 0, 0, 0 };
+            file.write(padding, (4 - imageSize % 4) % 4);
+        }
+        return (bool)file;
+    }
+
+private:
+    static const size_t identifierSize = 12;
+    static const size_t headerSize = identifierSize + 13 * 4;
+
+    static const unsigned char* identifier()
+    {
+        static const unsigned char bytes[identifierSize] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+        return bytes;
+    }
+};
+
+#endif /* ktxTexture_h */
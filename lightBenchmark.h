@@ -0,0 +1,151 @@
+//
+//  lightBenchmark.h
+//  test
+//
+//  Benchmark scene: fills the house with flickering candles in steps and
+//  prints the frame time at each light count.
+//
+
+#ifndef lightBenchmark_h
+#define lightBenchmark_h
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "clusterGrid.h"
+#include "lightBlock.h"
+
+// The scene's own lights keep the first firstLight elements of the
+// LightBlock; candles fill the elements after them up to each step's light
+// count, at fixed random spots inside the given bounds, each flickering at
+// its own rate so every candle is re-uploaded every frame. A step runs
+// warmupFrames unmeasured, then measuredFrames timed from one endFrame() to
+// the next; endFrame() calls glFinish, so the times are what the GPU took,
+// not how far ahead the CPU got. Run it with vsync off, once with clustered
+// lights and once without, to compare the two. Clustered runs also print the
+// light indices per frame and any references dropped from full clusters; a
+// step that dropped some did not shade the same lights as the other run.
+class LightBenchmark {
+public:
+    std::vector<int> lightCounts = { 8, 16, 32, 64, 128, 192, 255 };
+    int warmupFrames = 30;
+    int measuredFrames = 120;
+
+    LightBenchmark(const glm::vec3& boundsMin, const glm::vec3& boundsMax, int firstLight)
+    {
+        this->firstLight = firstLight;
+        uint32_t seed = 12345u;
+        for (int i = firstLight; i < LightBlock::maxLights; i++)
+        {
+            Candle candle;
+            candle.position = glm::vec3(random(seed), random(seed), random(seed)) * (boundsMax - boundsMin) + boundsMin;
+            candle.rate = 5.0f + 10.0f * random(seed);
+            candle.phase = 6.2831853f * random(seed);
+            candles.push_back(candle);
+        }
+    }
+
+    bool running() const
+    {
+        return step < lightCounts.size();
+    }
+
+    // call before lights.upload(); places the current step's candles
+    void update(LightBlock& lights, float time)
+    {
+        if (!running())
+            return;
+        int count = std::min(lightCounts[step], (int)LightBlock::maxLights);
+        lights.truncate(std::max(count, firstLight));
+        for (int i = firstLight; i < count; i++)
+        {
+            const Candle& candle = candles[i - firstLight];
+            float flicker = 0.75f + 0.25f * std::sin(time * candle.rate + candle.phase);
+            LightBlock::Light light;
+            light.position = candle.position;
+            // a small flame: bright close up, reaching about 2.5 units
+            light.ambient = glm::vec3(0.02f, 0.012f, 0.005f) * flicker;
+            light.diffuse = glm::vec3(0.6f, 0.35f, 0.12f) * flicker;
+            light.specular = glm::vec3(0.2f, 0.12f, 0.05f) * flicker;
+            light.k_c = 1.0f;
+            light.k_l = 0.7f;
+            light.k_q = 20.0f;
+            lights.set(i, light);
+        }
+    }
+
+    // call after the frame's last draw; clusters is the grid built this frame, if lights are clustered
+    void endFrame(LightBlock& lights, const ClusterGrid* clusters = nullptr)
+    {
+        if (!running())
+            return;
+        glFinish();
+        auto now = std::chrono::steady_clock::now();
+        if (frame > warmupFrames)
+        {
+            frameMilliseconds += std::chrono::duration<double, std::milli>(now - lastFrame).count();
+            if (clusters)
+            {
+                binMilliseconds += clusters->lastBuildMilliseconds();
+                clusterIndices += clusters->indexCount();
+                droppedLights += clusters->overflowCount();
+            }
+        }
+        lastFrame = now;
+
+        if (++frame > warmupFrames + measuredFrames)
+        {
+            int measured = measuredFrames;
+            std::cout << std::fixed << std::setprecision(2) << "Light benchmark: " << std::setw(3) << lightCounts[step] << " lights, "
+                      << std::setw(6) << frameMilliseconds / measured << " ms/frame (" << std::setw(6) << 1000.0 * measured / frameMilliseconds
+                      << " fps)";
+            if (clusters)
+                std::cout << ", binning " << binMilliseconds / measured << " ms, " << (double)clusterIndices / measured << " indices, "
+                          << (double)droppedLights / measured << " dropped per frame";
+            std::cout << std::endl;
+            step++;
+            frame = 0;
+            frameMilliseconds = 0.0;
+            binMilliseconds = 0.0;
+            clusterIndices = 0;
+            droppedLights = 0;
+            // back to the scene's own lights when done
+            if (!running())
+                lights.truncate(firstLight);
+        }
+    }
+
+private:
+    struct Candle {
+        glm::vec3 position;
+        float rate;
+        float phase;
+    };
+
+    int firstLight;
+    std::vector<Candle> candles;
+    size_t step = 0;
+    int frame = 0;
+    double frameMilliseconds = 0.0;
+    double binMilliseconds = 0.0;
+    size_t clusterIndices = 0;
+    long long droppedLights = 0;
+    std::chrono::steady_clock::time_point lastFrame;
+
+    // 0..1, from a linear congruential generator, so every run places the candles alike
+    static float random(uint32_t& seed)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        return (seed >> 8) * (1.0f / 16777216.0f);
+    }
+};
+
+#endif /* lightBenchmark_h */
@@ -0,0 +1,155 @@
+//
+//  lightBlock.h
+//  test
+//
+//  The scene's point lights in one std140 uniform buffer, the LightBlock
+//  the textured fragment shader loops over.
+//
+
+#ifndef lightBlock_h
+#define lightBlock_h
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+#include "glHandle.h"
+#include "shaderUniforms.h"
+
+// set() stores a light's values on the CPU, with the cutoff at which its
+// brightest channel (ambient + diffuse + specular, the most it can add)
+// falls below lightThreshold, and marks it dirty only when they changed; upload() then writes each run of consecutive dirty lights
+// with one glBufferSubData, and the live count when it changed, so a frame
+// in which no light changes uploads nothing. The shader loops over the
+// first count() lights, so any number up to maxLights can be live.
+class LightBlock {
+public:
+    // one PointLight as laid out in the block; checked against the generated offsets below
+    struct Light {
+        glm::vec3 position;
+        float k_c;
+        glm::vec3 ambient;
+        float k_l;
+        glm::vec3 diffuse;
+        float k_q;
+        glm::vec3 specular;
+        float cutoff;   // filled in by set()
+    };
+
+    float lightThreshold = 1.0f / 256.0f;   // a light ends where it adds less than this to a channel
+
+    static const int maxLights = (int)((LightBlockLayout::size - LightBlockLayout::pointLights) / LightBlockLayout::pointLightsStride);
+
+    // index past the current count makes the lights up to it live; returns false past maxLights
+    bool set(int index, Light light)
+    {
+        if (index < 0 || index >= maxLights)
+            return false;
+        glm::vec3 total = light.ambient + light.diffuse + light.specular;
+        float brightest = std::max(total.x, std::max(total.y, total.z));
+        // a light too dim to matter gets a cutoff of its own, short of 1 so the shader can divide by 1 - cutoff
+        light.cutoff = brightest > 2.0f * lightThreshold ? lightThreshold / brightest : 0.5f;
+        if (index >= (int)lights.size())
+        {
+            // lights not set yet are black, with an attenuation the shader can divide by
+            Light unset = Light();
+            unset.k_c = 1.0f;
+            unset.cutoff = 0.5f;
+            lights.resize(index + 1, unset);
+            dirty.resize(index + 1, true);
+        }
+        if (memcmp(&lights[index], &light, sizeof(Light)) != 0)
+        {
+            lights[index] = light;
+            dirty[index] = true;
+        }
+        return true;
+    }
+
+    int count() const
+    {
+        return (int)lights.size();
+    }
+
+    // drops the lights from index count on
+    void truncate(int count)
+    {
+        if (count < (int)lights.size())
+        {
+            lights.resize(std::max(count, 0));
+            dirty.resize(lights.size());
+        }
+    }
+
+    const std::vector<Light>& all() const
+    {
+        return lights;
+    }
+
+    // writes what changed since the last upload and binds the buffer to the block's binding point
+    void upload()
+    {
+        if (!buffer)
+        {
+            buffer = GLBuffer::create();
+            glBindBuffer(GL_UNIFORM_BUFFER, buffer.get());
+            glBufferData(GL_UNIFORM_BUFFER, LightBlockLayout::size, NULL, GL_DYNAMIC_DRAW);
+            uploadedCount = -1;
+        }
+        else
+            glBindBuffer(GL_UNIFORM_BUFFER, buffer.get());
+
+        GLint liveCount = count();
+        if (liveCount != uploadedCount)
+        {
+            glBufferSubData(GL_UNIFORM_BUFFER, LightBlockLayout::pointLightCount, sizeof(liveCount), &liveCount);
+            uploadedCount = liveCount;
+        }
+        for (size_t first = 0; first < lights.size();)
+        {
+            if (!dirty[first])
+            {
+                first++;
+                continue;
+            }
+            size_t end = first;
+            while (end < lights.size() && dirty[end])
+                dirty[end++] = false;
+            glBufferSubData(GL_UNIFORM_BUFFER, (GLintptr)(LightBlockLayout::pointLights + first * sizeof(Light)),
+                            (GLsizeiptr)((end - first) * sizeof(Light)), &lights[first]);
+            first = end;
+        }
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        glBindBufferBase(GL_UNIFORM_BUFFER, LightBlockLayout::binding, buffer.get());
+    }
+
+    // call before the GL context goes away
+    void release()
+    {
+        buffer.reset();
+        dirty.assign(dirty.size(), true);
+    }
+
+private:
+    std::vector<Light> lights;
+    std::vector<bool> dirty;
+    GLint uploadedCount = -1;
+    GLBuffer buffer;
+};
+
+static_assert(offsetof(LightBlock::Light, position) == PointLightLayout::position &&
+              offsetof(LightBlock::Light, k_c) == PointLightLayout::k_c &&
+              offsetof(LightBlock::Light, ambient) == PointLightLayout::ambient &&
+              offsetof(LightBlock::Light, k_l) == PointLightLayout::k_l &&
+              offsetof(LightBlock::Light, diffuse) == PointLightLayout::diffuse &&
+              offsetof(LightBlock::Light, k_q) == PointLightLayout::k_q &&
+              offsetof(LightBlock::Light, specular) == PointLightLayout::specular &&
+              offsetof(LightBlock::Light, cutoff) == PointLightLayout::cutoff &&
+              sizeof(LightBlock::Light) == LightBlockLayout::pointLightsStride,
+              "LightBlock::Light must match the std140 PointLight in the shader");
+
+#endif /* lightBlock_h */
@@ -14,11 +14,22 @@
 
 
 #include "shader.h"
+#include "shaderUniforms.h"
 #include "camera.h"
 #include "basic_camera.h"
 #include "pointLight.h"
 #include "cube.h"
+#include "cubeInstances.h"
+#include "proceduralBoxes.h"
+#include "staticBatch.h"
 #include "stb_image.h"
+#include "assetPack.h"
+#include "cameraBlock.h"
+#include "lightBlock.h"
+#include "clusterGrid.h"
+#include "lightBenchmark.h"
+#include "textureArray.h"
+#include "textureRegistry.h"
 
 #include <iostream>
 
@@ -29,7 +40,9 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void processInput(GLFWwindow* window);
-unsigned int loadTexture(char const* path, GLenum textureWrappingModeS, GLenum textureWrappingModeT, GLenum textureFilteringModeMin, GLenum textureFilteringModeMax);
+unsigned int loadTexture(char const* path, GLenum textureWrappingModeS, GLenum textureWrappingModeT, GLenum textureFilteringModeMin, GLenum textureFilteringModeMax, int scaleShift = -1);
+unsigned int loadDiffuseTexture(char const* path, char const* specularPath, GLenum textureWrappingModeS, GLenum textureWrappingModeT, GLenum textureFilteringModeMin, GLenum textureFilteringModeMax);
+unsigned int loadSpecularTexture(char const* path, GLenum textureWrappingModeS, GLenum textureWrappingModeT, GLenum textureFilteringModeMin, GLenum textureFilteringModeMax);
 void bed(Shader& lightingShader, glm::mat4 alTogether, Cube& cube);
 
 
@@ -138,6 +151,31 @@ bool diffuseToggle = true;
 bool specularToggle = true;
 
 
+// textures
+TextureRegistry textureRegistry;
+bool useTextureArray = false;   // all material images resampled into one uncompressed array texture, no per-cube texture binds;
+                                // off, textures come from the registry: shared, streamed through PBOs, and loaded from TextureBaker's
+                                // KTX files when present (BC3 "<diffuse>+<specular>.ktx" for packed materials, "<name>.ktx" otherwise)
+int textureQuality = 0;         // textures load at 1 / (1 << textureQuality) of their size (0-3); raise on low-end hardware
+bool packSpecularInAlpha = true;    // specular map luminance stored in the diffuse texture's alpha: one texture and one fetch per material;
+                                    // loads the baker's BC3 "<diffuse>+<specular>.ktx" when present
+
+// how the house's boxes are drawn
+enum HouseRendering {
+    HOUSE_PER_BOX,          // one drawCubeWithTexture per box
+    HOUSE_INSTANCED,        // one glDrawElementsInstanced per texture group (CubeInstances)
+    HOUSE_PROCEDURAL,       // generated in the vertex shader from 48 byte records, no vertex buffer (ProceduralBoxes)
+    HOUSE_STATIC_BATCH      // pre-transformed into one merged buffer, one draw per material (StaticBatch)
+};
+HouseRendering houseRendering = HOUSE_STATIC_BATCH;
+VertexFormat meshVertexFormat = VERTEX_FORMAT_COMPACT;    // 16 byte vertices and 16 bit indices instead of 32 bytes and 32 bits
+bool removeHiddenFaces = true;  // static batch drops face parts buried in or pressed against other boxes
+bool useInstancing = true;      // lamps drawn with one glDrawElementsInstanced instead of one draw each
+bool usePositionStreams = true; // position-only draws (lamps, depth prepass) read a tightly packed position buffer
+bool useDepthPrepass = false;   // static batch: depth laid down first, so the lit pass shades each pixel once
+bool useClusteredLights = true; // each fragment shades only the lights binned into its cell of a view-space grid (ClusterGrid)
+bool runLightBenchmark = false; // fills the house with flickering candles in steps, printing frame time against light count
+
 // timing
 float deltaTime = 0.0f;    // time between current frame and last frame
 float lastFrame = 0.0f;
@@ -184,18 +222,46 @@ int main()
     // -----------------------------
     glEnable(GL_DEPTH_TEST);
 
+    // map the asset pack built with the game; shaders and textures below are read out of it
+    // (the loose files are still used when it is missing)
+    AssetPack assets;
+    if (assets.open("assets.pak"))
+    {
+        AssetPack::mount(&assets);
+        std::cout << "Asset pack: " << assets.fileCount() << " files, " << assets.byteSize() / 1024 << " KB mapped" << std::endl;
+    }
+
     // build and compile our shader zprogram
     // ------------------------------------
     
-    Shader lightingShaderWithTexture("vertexShaderForPhongShadingWithTexture.vs", "fragmentShaderForPhongShadingWithTexture.fs");
-    Shader ourShader("vertexShader.vs", "fragmentShader.fs");
+    string textureShaderDefines = string(useTextureArray ? "#define TEXTURE_ARRAY\n" : "") + (packSpecularInAlpha ? "#define SPECULAR_IN_ALPHA\n" : "");
+    if (houseRendering == HOUSE_INSTANCED)
+        textureShaderDefines += "#define INSTANCED\n";
+    else if (houseRendering == HOUSE_PROCEDURAL)
+        textureShaderDefines += "#define PROCEDURAL_BOXES\n";
+    if (useClusteredLights)
+        textureShaderDefines += "#define CLUSTERED_LIGHTS\n";
+    Shader lightingShaderWithTexture("vertexShaderForPhongShadingWithTexture.vs", "fragmentShaderForPhongShadingWithTexture.fs",
+                                     nullptr, textureShaderDefines);
+    Shader ourShader("vertexShader.vs", "fragmentShader.fs", nullptr, useInstancing ? "#define INSTANCED\n" : "");
+    Shader depthShader("vertexShader.vs", "fragmentShader.fs");
+    // typed uniform slots, generated from the shaders by ShaderReflect; binding them also
+    // attaches each program's CameraBlock to cameraBlock's binding point
+    TexturedPhongUniforms texturedUniforms(lightingShaderWithTexture);
+    FlatColorUniforms lampUniforms(ourShader);
+    FlatColorUniforms depthUniforms(depthShader);
+    CameraBlock cameraBlock;
+    LightBlock lightBlock;
+
+    // every registry texture below loads at textureQuality unless it asks otherwise; materialMaps further down is sized from it too
+    textureRegistry.scaleShift = textureQuality;
 
     string diffuseMapPath = "ghost.jpg";
     string specularMapPath = "ghost.jpg";
 
 
-    unsigned int diffMap = loadTexture(diffuseMapPath.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
-    unsigned int specMap = loadTexture(specularMapPath.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
+    unsigned int diffMap = loadDiffuseTexture(diffuseMapPath.c_str(), specularMapPath.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
+    unsigned int specMap = loadSpecularTexture(specularMapPath.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
     Cube cube = Cube(diffMap, specMap, 32.0f, 0.0f, 0.0f, 1.0f, 1.0f);
 
 
@@ -204,8 +270,8 @@ int main()
     string specularMapPath1 = "wall.jpg";
 
 
-    unsigned int diffMap1 = loadTexture(diffuseMapPath1.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
-    unsigned int specMap1 = loadTexture(specularMapPath1.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
+    unsigned int diffMap1 = loadDiffuseTexture(diffuseMapPath1.c_str(), specularMapPath1.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
+    unsigned int specMap1 = loadSpecularTexture(specularMapPath1.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
     Cube cube1 = Cube(diffMap1, specMap1, 32.0f, 0.0f, 0.0f, 1.0f, 1.0f);
 
     //room 1 side wall 1
@@ -213,8 +279,8 @@ int main()
     string specularMapPath2 = "wall.jpg";
 
 
-    unsigned int diffMap2 = loadTexture(diffuseMapPath1.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
-    unsigned int specMap2 = loadTexture(specularMapPath1.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
+    unsigned int diffMap2 = loadDiffuseTexture(diffuseMapPath1.c_str(), specularMapPath1.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
+    unsigned int specMap2 = loadSpecularTexture(specularMapPath1.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
     Cube cube2 = Cube(diffMap2, specMap2, 32.0f, 0.0f, 0.0f, 1.0f, 1.0f);
 
     //second wall
@@ -222,8 +288,8 @@ int main()
     string specularMapPath3 = "wall.jpg";
 
 
-    unsigned int diffMap3 = loadTexture(diffuseMapPath1.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
-    unsigned int specMap3 = loadTexture(specularMapPath1.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
+    unsigned int diffMap3 = loadDiffuseTexture(diffuseMapPath1.c_str(), specularMapPath1.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
+    unsigned int specMap3 = loadSpecularTexture(specularMapPath1.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
     Cube cube3 = Cube(diffMap2, specMap2, 32.0f, 0.0f, 0.0f, 1.0f, 1.0f);
 
 
@@ -232,8 +298,8 @@ int main()
     string specularMapPath4 = "wall.jpg";
 
 
-    unsigned int diffMap4 = loadTexture(diffuseMapPath4.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
-    unsigned int specMap4 = loadTexture(specularMapPath4.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
+    unsigned int diffMap4 = loadDiffuseTexture(diffuseMapPath4.c_str(), specularMapPath4.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
+    unsigned int specMap4 = loadSpecularTexture(specularMapPath4.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
     Cube cube4 = Cube(diffMap4, specMap4, 32.0f, 0.0f, 0.0f, 1.0f, 1.0f);
 
     //room 1 side wall 2 door 
@@ -241,8 +307,8 @@ int main()
     string specularMapPath5 = "wall.jpg";
 
 
-    unsigned int diffMap5 = loadTexture(diffuseMapPath5.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
-    unsigned int specMap5 = loadTexture(specularMapPath5.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
+    unsigned int diffMap5 = loadDiffuseTexture(diffuseMapPath5.c_str(), specularMapPath5.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
+    unsigned int specMap5 = loadSpecularTexture(specularMapPath5.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
     Cube cube5 = Cube(diffMap5, specMap5, 32.0f, 0.0f, 0.0f, 1.0f, 1.0f);
 
     //room 1 side wall 2 door top
@@ -250,8 +316,8 @@ int main()
     string specularMapPath6 = "wall.jpg";
 
 
-    unsigned int diffMap6 = loadTexture(diffuseMapPath6.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
-    unsigned int specMap6 = loadTexture(specularMapPath6.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
+    unsigned int diffMap6 = loadDiffuseTexture(diffuseMapPath6.c_str(), specularMapPath6.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
+    unsigned int specMap6 = loadSpecularTexture(specularMapPath6.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
     Cube cube6 = Cube(diffMap6, specMap6, 32.0f, 0.0f, 0.0f, 1.0f, 1.0f);
 
     //floor one
@@ -259,8 +325,8 @@ int main()
     string specularMapPath7 = "floor.jpg";
 
 
-    unsigned int diffMap7 = loadTexture(diffuseMapPath7.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
-    unsigned int specMap7 = loadTexture(specularMapPath7.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
+    unsigned int diffMap7 = loadDiffuseTexture(diffuseMapPath7.c_str(), specularMapPath7.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
+    unsigned int specMap7 = loadSpecularTexture(specularMapPath7.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
     Cube cube7 = Cube(diffMap7, specMap7, 32.0f, 0.0f, 0.0f, 1.0f, 1.0f);
 
     //celling one
@@ -268,8 +334,8 @@ int main()
     string specularMapPath8 = "wall.jpg";
 
 
-    unsigned int diffMap8 = loadTexture(diffuseMapPath8.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
-    unsigned int specMap8 = loadTexture(specularMapPath8.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
+    unsigned int diffMap8 = loadDiffuseTexture(diffuseMapPath8.c_str(), specularMapPath8.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
+    unsigned int specMap8 = loadSpecularTexture(specularMapPath8.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
     Cube cube8 = Cube(diffMap8, specMap8, 32.0f, 0.0f, 0.0f, 1.0f, 1.0f);
 
     //floor 2
@@ -277,50 +343,50 @@ int main()
     string specularMapPath9 = "floor.jpg";
 
 
-    unsigned int diffMap9 = loadTexture(diffuseMapPath9.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
-    unsigned int specMap9 = loadTexture(specularMapPath9.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
+    unsigned int diffMap9 = loadDiffuseTexture(diffuseMapPath9.c_str(), specularMapPath9.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
+    unsigned int specMap9 = loadSpecularTexture(specularMapPath9.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
     Cube cube9 = Cube(diffMap9, specMap9, 32.0f, 0.0f, 0.0f, 1.0f, 1.0f);
 
     //celling 2
     string diffuseMapPath10 = "celling.jpg";
     string specularMapPath10 = "celling.jpg";
-    unsigned int diffMap10 = loadTexture(diffuseMapPath10.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
-    unsigned int specMap10 = loadTexture(specularMapPath10.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
+    unsigned int diffMap10 = loadDiffuseTexture(diffuseMapPath10.c_str(), specularMapPath10.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
+    unsigned int specMap10 = loadSpecularTexture(specularMapPath10.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
     Cube cube10 = Cube(diffMap10, specMap10, 32.0f, 0.0f, 0.0f, 1.0f, 1.0f);
 
     //room 2 wall 1
     string diffuseMapPath11 = "wall.jpg";
     string specularMapPath11 = "wall.jpg";
-    unsigned int diffMap11 = loadTexture(diffuseMapPath11.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
-    unsigned int specMap11 = loadTexture(specularMapPath11.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
+    unsigned int diffMap11 = loadDiffuseTexture(diffuseMapPath11.c_str(), specularMapPath11.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
+    unsigned int specMap11 = loadSpecularTexture(specularMapPath11.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
     Cube cube11 = Cube(diffMap11, specMap11, 32.0f, 0.0f, 0.0f, 1.0f, 1.0f);
 
     //room 2 wall 1 door top
     string diffuseMapPath12 = "wall.jpg";
     string specularMapPath12 = "wall.jpg";
-    unsigned int diffMap12 = loadTexture(diffuseMapPath12.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
-    unsigned int specMap12 = loadTexture(specularMapPath12.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
+    unsigned int diffMap12 = loadDiffuseTexture(diffuseMapPath12.c_str(), specularMapPath12.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
+    unsigned int specMap12 = loadSpecularTexture(specularMapPath12.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
     Cube cube12 = Cube(diffMap12, specMap12, 32.0f, 0.0f, 0.0f, 1.0f, 1.0f);
 
     //room 2 wall 1 last part
     string diffuseMapPath13 = "wall.jpg";
     string specularMapPath13 = "wall.jpg";
-    unsigned int diffMap13 = loadTexture(diffuseMapPath13.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
-    unsigned int specMap13 = loadTexture(specularMapPath13.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
+    unsigned int diffMap13 = loadDiffuseTexture(diffuseMapPath13.c_str(), specularMapPath13.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
+    unsigned int specMap13 = loadSpecularTexture(specularMapPath13.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
     Cube cube13 = Cube(diffMap13, specMap13, 32.0f, 0.0f, 0.0f, 1.0f, 1.0f);
 
     //room 2 side wall 1
     string diffuseMapPath14 = "wall.jpg";
     string specularMapPath14 = "wall.jpg";
-    unsigned int diffMap14 = loadTexture(diffuseMapPath14.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
-    unsigned int specMap14 = loadTexture(specularMapPath14.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
+    unsigned int diffMap14 = loadDiffuseTexture(diffuseMapPath14.c_str(), specularMapPath14.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
+    unsigned int specMap14 = loadSpecularTexture(specularMapPath14.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
     Cube cube14 = Cube(diffMap14, specMap14, 32.0f, 0.0f, 0.0f, 1.0f, 1.0f);
 
     //room 2 wall 2
     string diffuseMapPath15 = "wall.jpg";
     string specularMapPath15 = "wall.jpg";
-    unsigned int diffMap15 = loadTexture(diffuseMapPath15.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
-    unsigned int specMap15 = loadTexture(specularMapPath15.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
+    unsigned int diffMap15 = loadDiffuseTexture(diffuseMapPath15.c_str(), specularMapPath15.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
+    unsigned int specMap15 = loadSpecularTexture(specularMapPath15.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
     Cube cube15 = Cube(diffMap15, specMap15, 32.0f, 0.0f, 0.0f, 1.0f, 1.0f);
 
     //floor 3
@@ -328,8 +394,8 @@ int main()
     string specularMapPath16 = "floor.jpg";
 
 
-    unsigned int diffMap16 = loadTexture(diffuseMapPath16.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
-    unsigned int specMap16 = loadTexture(specularMapPath16.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
+    unsigned int diffMap16 = loadDiffuseTexture(diffuseMapPath16.c_str(), specularMapPath16.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
+    unsigned int specMap16 = loadSpecularTexture(specularMapPath16.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
     Cube cube16 = Cube(diffMap16, specMap16, 32.0f, 0.0f, 0.0f, 1.0f, 1.0f);
 
     //celling 3
@@ -337,8 +403,8 @@ int main()
     string specularMapPath17 = "celling.jpg";
 
 
-    unsigned int diffMap17 = loadTexture(diffuseMapPath17.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
-    unsigned int specMap17 = loadTexture(specularMapPath17.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
+    unsigned int diffMap17 = loadDiffuseTexture(diffuseMapPath17.c_str(), specularMapPath17.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
+    unsigned int specMap17 = loadSpecularTexture(specularMapPath17.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
     Cube cube17 = Cube(diffMap17, specMap17, 32.0f, 0.0f, 0.0f, 1.0f, 1.0f);
 
     //room 3 sidewaLL 1
@@ -346,8 +412,8 @@ int main()
     string specularMapPath18 = "wall.jpg";
 
 
-    unsigned int diffMap18 = loadTexture(diffuseMapPath18.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
-    unsigned int specMap18 = loadTexture(specularMapPath18.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
+    unsigned int diffMap18 = loadDiffuseTexture(diffuseMapPath18.c_str(), specularMapPath18.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
+    unsigned int specMap18 = loadSpecularTexture(specularMapPath18.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
     Cube cube18 = Cube(diffMap18, specMap18, 32.0f, 0.0f, 0.0f, 1.0f, 1.0f);
 
     //room 3 window wall 1
@@ -355,8 +421,8 @@ int main()
     string specularMapPath19 = "wall.jpg";
 
 
-    unsigned int diffMap19 = loadTexture(diffuseMapPath19.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
-    unsigned int specMap19 = loadTexture(specularMapPath19.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
+    unsigned int diffMap19 = loadDiffuseTexture(diffuseMapPath19.c_str(), specularMapPath19.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
+    unsigned int specMap19 = loadSpecularTexture(specularMapPath19.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
     Cube cube19 = Cube(diffMap19, specMap19, 32.0f, 0.0f, 0.0f, 1.0f, 1.0f);
 
     //room 3 window top
@@ -364,8 +430,8 @@ int main()
     string specularMapPath20 = "wall.jpg";
 
 
-    unsigned int diffMap20 = loadTexture(diffuseMapPath20.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
-    unsigned int specMap20 = loadTexture(specularMapPath20.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
+    unsigned int diffMap20 = loadDiffuseTexture(diffuseMapPath20.c_str(), specularMapPath20.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
+    unsigned int specMap20 = loadSpecularTexture(specularMapPath20.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
     Cube cube20 = Cube(diffMap20, specMap20, 32.0f, 0.0f, 0.0f, 1.0f, 1.0f);
 
     //room 3 window bottom
@@ -373,8 +439,8 @@ int main()
     string specularMapPath21 = "wall.jpg";
 
 
-    unsigned int diffMap21 = loadTexture(diffuseMapPath21.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
-    unsigned int specMap21 = loadTexture(specularMapPath21.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
+    unsigned int diffMap21 = loadDiffuseTexture(diffuseMapPath21.c_str(), specularMapPath21.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
+    unsigned int specMap21 = loadSpecularTexture(specularMapPath21.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
     Cube cube21 = Cube(diffMap21, specMap21, 32.0f, 0.0f, 0.0f, 1.0f, 1.0f);
 
     //room 3 second wall
@@ -382,8 +448,8 @@ int main()
     string specularMapPath22 = "wall.jpg";
 
 
-    unsigned int diffMap22 = loadTexture(diffuseMapPath22.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
-    unsigned int specMap22 = loadTexture(specularMapPath22.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
+    unsigned int diffMap22 = loadDiffuseTexture(diffuseMapPath22.c_str(), specularMapPath22.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
+    unsigned int specMap22 = loadSpecularTexture(specularMapPath22.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
     Cube cube22 = Cube(diffMap22, specMap22, 32.0f, 0.0f, 0.0f, 1.0f, 1.0f);
 
     //room 3 sidewall2
@@ -391,8 +457,8 @@ int main()
     string specularMapPath23 = "wall.jpg";
 
 
-    unsigned int diffMap23 = loadTexture(diffuseMapPath23.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
-    unsigned int specMap23 = loadTexture(specularMapPath23.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
+    unsigned int diffMap23 = loadDiffuseTexture(diffuseMapPath23.c_str(), specularMapPath23.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
+    unsigned int specMap23 = loadSpecularTexture(specularMapPath23.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
     Cube cube23 = Cube(diffMap23, specMap23, 32.0f, 0.0f, 0.0f, 1.0f, 1.0f);
 
     //room 3 sidewall2
@@ -400,8 +466,8 @@ int main()
     string specularMapPath24 = "wall.jpg";
 
 
-    unsigned int diffMap24 = loadTexture(diffuseMapPath24.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
-    unsigned int specMap24 = loadTexture(specularMapPath24.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
+    unsigned int diffMap24 = loadDiffuseTexture(diffuseMapPath24.c_str(), specularMapPath24.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
+    unsigned int specMap24 = loadSpecularTexture(specularMapPath24.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
     Cube cube24 = Cube(diffMap24, specMap24, 32.0f, 0.0f, 0.0f, 1.0f, 1.0f);
 
     //room 4
@@ -409,10 +475,230 @@ int main()
     string specularMapPath25 = "floor.jpg";
 
 
-    unsigned int diffMap25 = loadTexture(diffuseMapPath25.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
-    unsigned int specMap25 = loadTexture(specularMapPath25.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
+    unsigned int diffMap25 = loadDiffuseTexture(diffuseMapPath25.c_str(), specularMapPath25.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
+    unsigned int specMap25 = loadSpecularTexture(specularMapPath25.c_str(), GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
     Cube cube25 = Cube(diffMap25, specMap25, 32.0f, 0.0f, 0.0f, 1.0f, 1.0f);
 
+    // texture array mode: the same images become layers of one array texture and each cube keeps only its layer indices
+    TextureArray materialMaps(1024 >> textureQuality, 1024 >> textureQuality);
+    auto addMaterialLayers = [&materialMaps](Cube& target, const string& diffusePath, const string& specularPath)
+    {
+        if (packSpecularInAlpha)
+            target.setTextureLayers(materialMaps.addLayer(diffusePath, specularPath), -1);
+        else
+            target.setTextureLayers(materialMaps.addLayer(diffusePath), materialMaps.addLayer(specularPath));
+    };
+    if (useTextureArray)
+    {
+        addMaterialLayers(cube, diffuseMapPath, specularMapPath);
+        addMaterialLayers(cube1, diffuseMapPath1, specularMapPath1);
+        addMaterialLayers(cube2, diffuseMapPath2, specularMapPath2);
+        addMaterialLayers(cube3, diffuseMapPath3, specularMapPath3);
+        addMaterialLayers(cube4, diffuseMapPath4, specularMapPath4);
+        addMaterialLayers(cube5, diffuseMapPath5, specularMapPath5);
+        addMaterialLayers(cube6, diffuseMapPath6, specularMapPath6);
+        addMaterialLayers(cube7, diffuseMapPath7, specularMapPath7);
+        addMaterialLayers(cube8, diffuseMapPath8, specularMapPath8);
+        addMaterialLayers(cube9, diffuseMapPath9, specularMapPath9);
+        addMaterialLayers(cube10, diffuseMapPath10, specularMapPath10);
+        addMaterialLayers(cube11, diffuseMapPath11, specularMapPath11);
+        addMaterialLayers(cube12, diffuseMapPath12, specularMapPath12);
+        addMaterialLayers(cube13, diffuseMapPath13, specularMapPath13);
+        addMaterialLayers(cube14, diffuseMapPath14, specularMapPath14);
+        addMaterialLayers(cube15, diffuseMapPath15, specularMapPath15);
+        addMaterialLayers(cube16, diffuseMapPath16, specularMapPath16);
+        addMaterialLayers(cube17, diffuseMapPath17, specularMapPath17);
+        addMaterialLayers(cube18, diffuseMapPath18, specularMapPath18);
+        addMaterialLayers(cube19, diffuseMapPath19, specularMapPath19);
+        addMaterialLayers(cube20, diffuseMapPath20, specularMapPath20);
+        addMaterialLayers(cube21, diffuseMapPath21, specularMapPath21);
+        addMaterialLayers(cube22, diffuseMapPath22, specularMapPath22);
+        addMaterialLayers(cube23, diffuseMapPath23, specularMapPath23);
+        addMaterialLayers(cube24, diffuseMapPath24, specularMapPath24);
+        addMaterialLayers(cube25, diffuseMapPath25, specularMapPath25);
+        materialMaps.build(GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
+        lightingShaderWithTexture.use();
+        texturedUniforms.materialMaps.set(lightingShaderWithTexture, 0);
+    }
+    else
+    {
+        // decode every texture requested above in parallel, then upload them
+        textureRegistry.flush();
+        textureRegistry.printStatistics();
+    }
+
+    // the house: every box with its transform relative to the scene's model matrix
+    struct Box {
+        Cube* cube;
+        glm::mat4 transform;
+    };
+    vector<Box> houseBoxes;
+    auto addBox = [&houseBoxes](Cube& cube, glm::vec3 position, glm::vec3 size)
+    {
+        houseBoxes.push_back(Box{ &cube, glm::scale(glm::translate(glm::mat4(1.0f), position), size) });
+    };
+
+    addBox(cube, glm::vec3(-0.45f, -0.4f, -2.8f), glm::vec3(1.0f));
+
+    //first wall
+    addBox(cube1, glm::vec3(-8.0f, 1.2f, -5.0f), glm::vec3(10.0f, -4.45f, -0.3f));
+
+    //room 1 side 1
+    addBox(cube2, glm::vec3(-8.5f, 1.2f, 1.4f), glm::vec3(0.5f, -4.45f, -6.5f));
+
+    //second wall
+    addBox(cube3, glm::vec3(-8.0f, 1.2f, 1.7f), glm::vec3(10.0f, -4.45f, -0.3f));
+
+    //room 1 side 2 door side 1
+    addBox(cube4, glm::vec3(2.0f, 1.2f, -2.5f), glm::vec3(0.5f, -4.45f, -2.5f));
+
+    //room 1 side 2 door side 2
+    addBox(cube5, glm::vec3(2.0f, 1.2f, 1.65f), glm::vec3(0.5f, -4.45f, -2.5f));
+
+    //room 1 side 2 door top
+    addBox(cube6, glm::vec3(2.0f, 1.2f, -0.80f), glm::vec3(0.5f, -1.45f, -1.7f));
+
+    //first FLoor
+    addBox(cube7, glm::vec3(2.0f, -2.92f, 1.40f), glm::vec3(-10.0f, -0.30f, -6.5f));
+
+    //first celling
+    addBox(cube8, glm::vec3(2.0f, 1.2f, 1.40f), glm::vec3(-10.0f, -0.30f, -6.5f));
+
+    //          THE SECOND ROOM                                     THE SECOND ROOM
+
+    //second floor
+    addBox(cube9, glm::vec3(12.0f, -2.92f, 1.40f), glm::vec3(-10.0f, -0.30f, -6.5f));
+
+    //second celling
+    addBox(cube10, glm::vec3(12.0f, 1.2f, 1.40f), glm::vec3(-10.0f, -0.30f, -6.5f));
+
+    //room 2 first wall
+    addBox(cube11, glm::vec3(2.0f, 1.2f, -5.0f), glm::vec3(4.5f, -4.45f, -0.3f));
+
+    //room2 1st wall door top
+    addBox(cube12, glm::vec3(6.5f, 1.2f, -5.0f), glm::vec3(1.70f, -1.45f, -0.3f));
+
+    //room 2 first wall last part
+    addBox(cube13, glm::vec3(8.2f, 1.2f, -5.0f), glm::vec3(3.80f, -4.45f, -0.3f));
+
+    //room 2 side 1
+    addBox(cube14, glm::vec3(8.9f, 1.2f, 1.4f), glm::vec3(0.5f, -4.45f, -6.5f));
+
+    //room 2 second wall
+    addBox(cube15, glm::vec3(2.0f, 1.2f, 1.7f), glm::vec3(10.0f, -4.45f, -0.3f));
+
+    //                       THIRD ROOM                                                           THIRD ROOM
+
+    //room 3 floor
+    addBox(cube16, glm::vec3(12.0f, -2.92f, -5.0f), glm::vec3(-16.0f, -0.30f, -6.5f));
+
+    //room 3 celling
+    addBox(cube17, glm::vec3(12.0f, 1.2f, -5.0f), glm::vec3(-16.0f, -0.30f, -6.5f));
+
+    //room 3 sidewall 1
+    addBox(cube18, glm::vec3(12.0f, 1.2f, -5.0f), glm::vec3(0.5f, -4.45f, -6.5f));
+
+    //room 3 window wall first, mane ghore dhukte age choke jeta pore
+    addBox(cube19, glm::vec3(12.0f, 1.2f, -11.5f), glm::vec3(-8.6f, -4.45f, -0.3f));
+
+    //room 3 window top
+    addBox(cube20, glm::vec3(3.5f, 1.2f, -11.5f), glm::vec3(-1.6f, -1.45f, -0.3f));
+
+    //room 3 window bottom
+    addBox(cube21, glm::vec3(3.5f, -1.3f, -11.5f), glm::vec3(-1.6f, -1.65f, -0.3f));
+
+    //room 3 second wall
+    addBox(cube22, glm::vec3(1.9f, 1.2f, -11.5f), glm::vec3(-5.9f, -4.45f, -0.3f));
+
+    //room 3 sidewall 2
+    addBox(cube23, glm::vec3(-4.1f, 1.2f, -5.1f), glm::vec3(0.5f, -4.45f, -4.60f));
+
+    //room 3 door top
+    addBox(cube24, glm::vec3(-4.1f, 1.2f, -9.6f), glm::vec3(0.5f, -1.45f, -2.0f));
+
+    //          fourth room                         FOURTH ROOM
+
+    //room 4 floor
+    addBox(cube25, glm::vec3(8.0f, -2.92f, -5.0f), glm::vec3(-2.6f, -0.30f, -6.5f));
+
+    // one light bulb per point light
+    vector<glm::mat4> lampTransforms;
+    for (unsigned int i = 0; i <= 4; i++)
+    {
+        glm::mat4 lamp = glm::translate(glm::mat4(1.0f), pointLightPositions[i]);
+        lampTransforms.push_back(glm::scale(lamp, glm::vec3(0.2f))); // Make it a smaller cube
+    }
+
+    // every mode but per box puts the transforms, UV rects and materials into GPU buffers once, instead of uniforms per box per frame
+    CubeInstances houseInstances;
+    ProceduralBoxes houseBoxRecords;
+    StaticBatch houseBatch;
+    CubeMesh::shared().setVertexFormat(meshVertexFormat);
+    houseBatch.vertexFormat = meshVertexFormat;
+    CubeMesh::shared().setPositionStream(usePositionStreams);
+    houseBatch.positionStream = usePositionStreams && useDepthPrepass;
+    if (houseRendering == HOUSE_INSTANCED)
+    {
+        for (const Box& box : houseBoxes)
+            houseInstances.add(box.transform, box.cube);
+        houseInstances.upload();
+        std::cout << "Instancing: " << houseInstances.size() << " boxes in " << houseInstances.groupCount() << " draws" << std::endl;
+    }
+    else if (houseRendering == HOUSE_PROCEDURAL)
+    {
+        for (const Box& box : houseBoxes)
+            houseBoxRecords.add(box.transform, box.cube);
+        houseBoxRecords.upload();
+        std::cout << "Procedural boxes: " << houseBoxRecords.size() << " boxes, " << houseBoxRecords.recordBytes() << " bytes of records in "
+                  << houseBoxRecords.groupCount() << " draws" << std::endl;
+    }
+    else if (houseRendering == HOUSE_STATIC_BATCH)
+    {
+        for (const Box& box : houseBoxes)
+            houseBatch.add(box.transform, *box.cube);
+        houseBatch.build(removeHiddenFaces);
+        std::cout << "Static batch: " << houseBatch.size() << " boxes, " << houseBatch.vertexBytes() / 1024 << " KB of vertices in "
+                  << houseBatch.materialCount() << " draws" << std::endl;
+        if (houseBatch.positionBytes())
+            std::cout << "Static batch position stream: " << houseBatch.positionBytes() / 1024 << " KB" << std::endl;
+        if (removeHiddenFaces)
+        {
+            const BoxFaceCuller::Statistics& faces = houseBatch.faceStatistics();
+            std::cout << "Hidden faces: " << faces.facesRemoved << " removed, " << faces.facesSplit << " split; triangles "
+                      << faces.trianglesBefore << " -> " << faces.trianglesAfter << ", surface area " << faces.areaBefore << " -> "
+                      << faces.areaAfter << " (" << 100.0 * (1.0 - faces.areaAfter / faces.areaBefore) << "% less overdraw)" << std::endl;
+        }
+    }
+
+    CubeInstances lampInstances;
+    lampInstances.positionsOnly = true;
+    if (useInstancing)
+    {
+        for (const glm::mat4& lamp : lampTransforms)
+            lampInstances.add(lamp);
+        lampInstances.upload();
+    }
+    MeshArena::shared().printStatistics();
+
+    // the benchmark's candles go anywhere inside the house
+    glm::vec3 houseMin(1e30f), houseMax(-1e30f);
+    for (const Box& box : houseBoxes)
+    {
+        for (int corner = 0; corner < 8; corner++)
+        {
+            glm::vec4 unitCorner((float)(corner & 1), (float)((corner >> 1) & 1), (float)(corner >> 2), 1.0f);
+            glm::vec3 point = glm::vec3(box.transform * unitCorner);
+            houseMin = glm::min(houseMin, point);
+            houseMax = glm::max(houseMax, point);
+        }
+    }
+    LightBenchmark lightBenchmark(houseMin, houseMax, 5);
+    if (runLightBenchmark)
+        glfwSwapInterval(0);    // time the frames, not the display's refresh
+    else
+        lightBenchmark.lightCounts.clear();     // no steps to run
+    ClusterGrid clusterGrid;
+
     //Sphere sphere = Sphere();
 
     //glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
@@ -432,6 +718,9 @@ int main()
         // -----
         processInput(window);
 
+        // upload any textures requested since the last frame, within a per-frame budget
+        textureRegistry.update();
+
         // render
         // ------
         glClearColor(0.5f, 0.5f, 0.5f, 1.0f);
@@ -439,17 +728,20 @@ int main()
 
         // be sure to activate shader when setting uniforms/drawing objects
         lightingShaderWithTexture.use();
-        lightingShaderWithTexture.setVec3("viewPos", camera.Position);
+        if (useTextureArray)
+            materialMaps.bind(GL_TEXTURE0);
 
         // pass projection matrix to shader (note that in this case it could change every frame)
-        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+        const float nearPlane = 0.1f, farPlane = 100.0f;
+        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, nearPlane, farPlane);
         //glm::mat4 projection = glm::ortho(-2.0f, +2.0f, -1.5f, +1.5f, 0.1f, 100.0f);
-        lightingShaderWithTexture.setMat4("projection", projection);
 
         // camera/view transformation
         glm::mat4 view = camera.GetViewMatrix();
         //glm::mat4 view = basic_camera.createViewMatrix();
-        lightingShaderWithTexture.setMat4("view", view);
+
+        // once for every program this frame
+        cameraBlock.update(projection, view, camera.Position);
 
         // Modelling Transformation
         glm::mat4 identityMatrix = glm::mat4(1.0f); // make sure to initialize matrix to identity matrix first
@@ -463,272 +755,82 @@ int main()
 
         lightingShaderWithTexture.use();
         // point light 1
-        pointlight1.setUpPointLight(lightingShaderWithTexture);
+        pointlight1.setUpPointLight(lightBlock);
         // point light 2
-        pointlight2.setUpPointLight(lightingShaderWithTexture);
+        pointlight2.setUpPointLight(lightBlock);
         // point light 3
-        pointlight3.setUpPointLight(lightingShaderWithTexture);
+        pointlight3.setUpPointLight(lightBlock);
         // point light 4
-        pointlight4.setUpPointLight(lightingShaderWithTexture);
+        pointlight4.setUpPointLight(lightBlock);
         //point light 5
-        pointlight5.setUpPointLight(lightingShaderWithTexture);
-
-        glm::mat4 modelMatrixForContainer = glm::mat4(1.0f);
-        modelMatrixForContainer = glm::translate(model, glm::vec3(-0.45f, -0.4f, -2.8f));
-        cube.drawCubeWithTexture(lightingShaderWithTexture, modelMatrixForContainer);
-
-        //first wall
-        
-
-        glm::mat4 modelMatrixForContainer1 = glm::mat4(1.0f);
-        modelMatrixForContainer1 = glm::translate(model, glm::vec3(-8.0f, 1.2f, -5.0f));
-        modelMatrixForContainer1 = glm::scale(modelMatrixForContainer1, glm::vec3(10.0f, -4.45f, -0.3f));
-        cube1.drawCubeWithTexture(lightingShaderWithTexture, modelMatrixForContainer1);
-
-        //room 1 side 1
-        
-
-        glm::mat4 modelMatrixForContainer2 = glm::mat4(1.0f);
-        modelMatrixForContainer2 = glm::translate(model, glm::vec3(-8.5f, 1.2f, 1.4f));
-        modelMatrixForContainer2 = glm::scale(modelMatrixForContainer2, glm::vec3(0.5f, -4.45f, -6.5f));
-        cube2.drawCubeWithTexture(lightingShaderWithTexture, modelMatrixForContainer2);
-
-        //second wall
-       
-
-        glm::mat4 modelMatrixForContainer3 = glm::mat4(1.0f);
-        modelMatrixForContainer3 = glm::translate(model, glm::vec3(-8.0f, 1.2f, 1.7f));
-        modelMatrixForContainer3 = glm::scale(modelMatrixForContainer3, glm::vec3(10.0f, -4.45f, -0.3f));
-        cube3.drawCubeWithTexture(lightingShaderWithTexture, modelMatrixForContainer3);
-        // also draw the lamp object(s)
-     
-
-        //room 1 side 2 door side 1
-        lightingShaderWithTexture.use();
-       
-        
-
-        glm::mat4 modelMatrixForContainer4 = glm::mat4(1.0f);
-        modelMatrixForContainer4 = glm::translate(model, glm::vec3(2.0f, 1.2f, -2.5f));
-        modelMatrixForContainer4 = glm::scale(modelMatrixForContainer4, glm::vec3(0.5f, -4.45f, -2.5f));
-        cube4.drawCubeWithTexture(lightingShaderWithTexture, modelMatrixForContainer4);
-
-        //room 1 side 2 door side 2
-       
-
-        glm::mat4 modelMatrixForContainer5 = glm::mat4(1.0f);
-        modelMatrixForContainer5 = glm::translate(model, glm::vec3(2.0f, 1.2f, 1.65f));
-        modelMatrixForContainer5 = glm::scale(modelMatrixForContainer5, glm::vec3(0.5f, -4.45f, -2.5f));
-        cube5.drawCubeWithTexture(lightingShaderWithTexture, modelMatrixForContainer5);
-
-        //room 1 side 2 door top
-       
-
-        glm::mat4 modelMatrixForContainer6 = glm::mat4(1.0f);
-        modelMatrixForContainer6 = glm::translate(model, glm::vec3(2.0f, 1.2f, -0.80f));
-        modelMatrixForContainer6 = glm::scale(modelMatrixForContainer6, glm::vec3(0.5f, -1.45f, -1.7f));
-        cube6.drawCubeWithTexture(lightingShaderWithTexture, modelMatrixForContainer6);
-
-        //first FLoor
-
-        lightingShaderWithTexture.use();
-        
-
-        glm::mat4 modelMatrixForContainer7 = glm::mat4(1.0f);
-        modelMatrixForContainer7 = glm::translate(model, glm::vec3(2.0f, -2.92f, 1.40f));
-        modelMatrixForContainer7 = glm::scale(modelMatrixForContainer7, glm::vec3(-10.0f, -0.30f, -6.5f));
-        cube7.drawCubeWithTexture(lightingShaderWithTexture, modelMatrixForContainer7);
-
-        // also draw the lamp object(s)
-        ourShader.use();
-        ourShader.setMat4("projection", projection);
-        ourShader.setMat4("view", view);
-
-        //first celling
-       
-
-        glm::mat4 modelMatrixForContainer8 = glm::mat4(1.0f);
-        modelMatrixForContainer8 = glm::translate(model, glm::vec3(2.0f, 1.2f, 1.40f));
-        modelMatrixForContainer8 = glm::scale(modelMatrixForContainer8, glm::vec3(-10.0f, -0.30f, -6.5f));
-        cube8.drawCubeWithTexture(lightingShaderWithTexture, modelMatrixForContainer8);
-
-
-                        //          THE SECOND ROOM                                     THE SECOND ROOM
-
-        //second floor
-
-      
-
-        glm::mat4 modelMatrixForContainer9 = glm::mat4(1.0f);
-        modelMatrixForContainer9 = glm::translate(model, glm::vec3(12.0f, -2.92f, 1.40f));
-        modelMatrixForContainer9 = glm::scale(modelMatrixForContainer9, glm::vec3(-10.0f, -0.30f, -6.5f));
-        cube9.drawCubeWithTexture(lightingShaderWithTexture, modelMatrixForContainer9);
-
-        //second celling
-        
-
-        glm::mat4 modelMatrixForContainer10 = glm::mat4(1.0f);
-        modelMatrixForContainer10 = glm::translate(model, glm::vec3(12.0f, 1.2f, 1.40f));
-        modelMatrixForContainer10 = glm::scale(modelMatrixForContainer10, glm::vec3(-10.0f, -0.30f, -6.5f));
-        cube10.drawCubeWithTexture(lightingShaderWithTexture, modelMatrixForContainer10);
-
-        //room 2 first wall
-       
-
-        glm::mat4 modelMatrixForContainer11 = glm::mat4(1.0f);
-        modelMatrixForContainer11 = glm::translate(model, glm::vec3(2.0f, 1.2f, -5.0f));
-        modelMatrixForContainer11 = glm::scale(modelMatrixForContainer11, glm::vec3(4.5f, -4.45f, -0.3f));
-        cube11.drawCubeWithTexture(lightingShaderWithTexture, modelMatrixForContainer11);
-
-        //room2 1st wall door top
-
-       
-
-        glm::mat4 modelMatrixForContainer12 = glm::mat4(1.0f);
-        modelMatrixForContainer12 = glm::translate(model, glm::vec3(6.5f, 1.2f, -5.0f));
-        modelMatrixForContainer12 = glm::scale(modelMatrixForContainer12, glm::vec3(1.70f, -1.45f, -0.3f));
-        cube12.drawCubeWithTexture(lightingShaderWithTexture, modelMatrixForContainer12);
-
-        //room 2 first wall last part
-     
-
-        glm::mat4 modelMatrixForContainer13 = glm::mat4(1.0f);
-        modelMatrixForContainer13 = glm::translate(model, glm::vec3(8.2f, 1.2f, -5.0f));
-        modelMatrixForContainer13 = glm::scale(modelMatrixForContainer13, glm::vec3(3.80f, -4.45f, -0.3f));
-        cube13.drawCubeWithTexture(lightingShaderWithTexture, modelMatrixForContainer13);
-
-        //room 2 side 1
-       
-
-        glm::mat4 modelMatrixForContainer14 = glm::mat4(1.0f);
-        modelMatrixForContainer14 = glm::translate(model, glm::vec3(8.9f, 1.2f, 1.4f));
-        modelMatrixForContainer14 = glm::scale(modelMatrixForContainer14, glm::vec3(0.5f, -4.45f, -6.5f));
-        cube14.drawCubeWithTexture(lightingShaderWithTexture, modelMatrixForContainer14);
-
-        //room 2 second wall
-        
-
-        glm::mat4 modelMatrixForContainer15 = glm::mat4(1.0f);
-        modelMatrixForContainer15 = glm::translate(model, glm::vec3(2.0f, 1.2f, 1.7f));
-        modelMatrixForContainer15 = glm::scale(modelMatrixForContainer15, glm::vec3(10.0f, -4.45f, -0.3f));
-        cube15.drawCubeWithTexture(lightingShaderWithTexture, modelMatrixForContainer15);
-
-
-
-        //                       THIRD ROOM                                                           THIRD ROOM
-
-        //room 3 floor
-        
-       
-
-        glm::mat4 modelMatrixForContainer16 = glm::mat4(1.0f);
-        modelMatrixForContainer16 = glm::translate(model, glm::vec3(12.0f, -2.92f, -5.0f));
-        modelMatrixForContainer16 = glm::scale(modelMatrixForContainer16, glm::vec3(-16.0f, -0.30f, -6.5f));
-        cube16.drawCubeWithTexture(lightingShaderWithTexture, modelMatrixForContainer16);
-
-        //room 3 celling 
-
-        
-
-        glm::mat4 modelMatrixForContainer17 = glm::mat4(1.0f);
-        modelMatrixForContainer17 = glm::translate(model, glm::vec3(12.0f, 1.2f, -5.0f));
-        modelMatrixForContainer17 = glm::scale(modelMatrixForContainer17, glm::vec3(-16.0f, -0.30f, -6.5f));
-        cube17.drawCubeWithTexture(lightingShaderWithTexture, modelMatrixForContainer17);
-
-        //room 3 sidewall 1
-
-       
-
-        glm::mat4 modelMatrixForContainer18 = glm::mat4(1.0f);
-        modelMatrixForContainer18 = glm::translate(model, glm::vec3(12.0f, 1.2f, -5.0f));
-        modelMatrixForContainer18 = glm::scale(modelMatrixForContainer18, glm::vec3(0.5f, -4.45f, -6.5f));
-        cube18.drawCubeWithTexture(lightingShaderWithTexture, modelMatrixForContainer18);
-
-        //room 3 window wall first, mane ghore dhukte age choke jeta pore
-        
-
-        glm::mat4 modelMatrixForContainer19 = glm::mat4(1.0f);
-        modelMatrixForContainer19 = glm::translate(model, glm::vec3(12.0f, 1.2f, -11.5f));
-        modelMatrixForContainer19 = glm::scale(modelMatrixForContainer19, glm::vec3(-8.6f, -4.45f, -0.3f));
-        cube19.drawCubeWithTexture(lightingShaderWithTexture, modelMatrixForContainer19);
-
-        //room 3 window top
-       
-
-        glm::mat4 modelMatrixForContainer20 = glm::mat4(1.0f);
-        modelMatrixForContainer20 = glm::translate(model, glm::vec3(3.5f, 1.2f, -11.5f));
-        modelMatrixForContainer20 = glm::scale(modelMatrixForContainer20, glm::vec3(-1.6f, -1.45f, -0.3f));
-        cube20.drawCubeWithTexture(lightingShaderWithTexture, modelMatrixForContainer20);
-
-        //room 3 window bottom
-       
-
-        glm::mat4 modelMatrixForContainer21 = glm::mat4(1.0f);
-        modelMatrixForContainer21 = glm::translate(model, glm::vec3(3.5f, -1.3f, -11.5f));
-        modelMatrixForContainer21 = glm::scale(modelMatrixForContainer21, glm::vec3(-1.6f, -1.65f, -0.3f));
-        cube21.drawCubeWithTexture(lightingShaderWithTexture, modelMatrixForContainer21);
-
-        //room 3 second wall
-        
-
-        glm::mat4 modelMatrixForContainer22 = glm::mat4(1.0f);
-        modelMatrixForContainer22 = glm::translate(model, glm::vec3(1.9f, 1.2f, -11.5f));
-        modelMatrixForContainer22 = glm::scale(modelMatrixForContainer22, glm::vec3(-5.9f, -4.45f, -0.3f));
-        cube22.drawCubeWithTexture(lightingShaderWithTexture, modelMatrixForContainer22);
-
-        //room 3 sidewall 2
-
-        
-
-        glm::mat4 modelMatrixForContainer23 = glm::mat4(1.0f);
-        modelMatrixForContainer23 = glm::translate(model, glm::vec3(-4.1f, 1.2f, -5.1f));
-        modelMatrixForContainer23 = glm::scale(modelMatrixForContainer23, glm::vec3(0.5f, -4.45f, -4.60f));
-        cube23.drawCubeWithTexture(lightingShaderWithTexture, modelMatrixForContainer23);
-
-        //room 3 door top
-
-        glm::mat4 modelMatrixForContainer24 = glm::mat4(1.0f);
-        modelMatrixForContainer24 = glm::translate(model, glm::vec3(-4.1f, 1.2f, -9.6f));
-        modelMatrixForContainer24 = glm::scale(modelMatrixForContainer24, glm::vec3(0.5f, -1.45f, -2.0f));
-        cube24.drawCubeWithTexture(lightingShaderWithTexture, modelMatrixForContainer24);
-
-
-
-        //          fourth room                         FOURTH ROOM 
-
-
-
-        //room 4 floor
-
-        glm::mat4 modelMatrixForContainer25 = glm::mat4(1.0f);
-        modelMatrixForContainer25 = glm::translate(model, glm::vec3(8.0f, -2.92f, -5.0f));
-        modelMatrixForContainer25 = glm::scale(modelMatrixForContainer25, glm::vec3(-2.6f, -0.30f, -6.5f));
-        cube25.drawCubeWithTexture(lightingShaderWithTexture, modelMatrixForContainer25);
-
-        // also draw the lamp object(s)
-        ourShader.use();
-        ourShader.setMat4("projection", projection);
-        ourShader.setMat4("view", view);
+        pointlight5.setUpPointLight(lightBlock);
+        lightBenchmark.update(lightBlock, currentFrame);
+        // only the lights that changed since the last frame
+        lightBlock.upload();
+        if (useClusteredLights)
+        {
+            int framebufferWidth, framebufferHeight;
+            glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+            clusterGrid.build(projection, view, nearPlane, farPlane, lightBlock, framebufferWidth, framebufferHeight);
+            clusterGrid.bind(lightingShaderWithTexture, texturedUniforms);
+        }
 
+        if (houseRendering == HOUSE_PER_BOX)
+        {
+            for (const Box& box : houseBoxes)
+                box.cube->drawCubeWithTexture(lightingShaderWithTexture, texturedUniforms, model * box.transform);
+        }
+        else
+        {
+            // the whole house in one draw per texture group or material; the boxes' own transforms are in GPU buffers
+            if (houseRendering == HOUSE_STATIC_BATCH)
+            {
+                if (useDepthPrepass)
+                {
+                    // depth only, from the position stream; the lit pass then passes the depth test once per pixel
+                    depthShader.use();
+                    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+                    houseBatch.drawPositions(depthShader, depthUniforms, model);
+                    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+                    glDepthFunc(GL_LEQUAL);
+                    lightingShaderWithTexture.use();
+                }
+                houseBatch.draw(lightingShaderWithTexture, texturedUniforms, model);
+                glDepthFunc(GL_LESS);
+            }
+            else
+            {
+                texturedUniforms.model.set(lightingShaderWithTexture, model);
+                texturedUniforms.normalMatrix.set(lightingShaderWithTexture, glm::transpose(glm::inverse(glm::mat3(model))));
+                if (houseRendering == HOUSE_PROCEDURAL)
+                    houseBoxRecords.draw(lightingShaderWithTexture, texturedUniforms);
+                else
+                    houseInstances.draw(lightingShaderWithTexture, texturedUniforms);
+            }
+        }
 
         // also draw the lamp object(s)
         ourShader.use();
-        ourShader.setMat4("projection", projection);
-        ourShader.setMat4("view", view);
 
         // we now draw as many light bulbs as we have point lights.
-        for (unsigned int i = 0; i <= 4; i++)
+        if (useInstancing)
+        {
+            lampUniforms.model.set(ourShader, glm::mat4(1.0f));
+            lampUniforms.color.set(ourShader, glm::vec3(0.8f, 0.8f, 0.8f));
+            lampInstances.draw();
+        }
+        else
         {
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, pointLightPositions[i]);
-            model = glm::scale(model, glm::vec3(0.2f)); // Make it a smaller cube
-            cube.drawCube(ourShader, model, 0.8f, 0.8f, 0.8f);
+            for (const glm::mat4& lamp : lampTransforms)
+                cube.drawCube(ourShader, lampUniforms, lamp, 0.8f, 0.8f, 0.8f);
         }
 
         
 
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
         // -------------------------------------------------------------------------------
+        lightBenchmark.endFrame(lightBlock, useClusteredLights ? &clusterGrid : nullptr);
+        cameraBlock.endFrame();
         glfwSwapBuffers(window);
         glfwPollEvents();
     }
@@ -736,6 +838,20 @@ int main()
    
     // optional: de-allocate all resources once they've outlived their purpose:
     // ------------------------------------------------------------------------
+    textureRegistry.clear();
+    materialMaps.release();
+    houseInstances.release();
+    houseBoxRecords.release();
+    houseBatch.release();
+    lampInstances.release();
+    CubeMesh::shared().release();
+    MeshArena::shared().release();
+    cameraBlock.release();
+    lightBlock.release();
+    clusterGrid.release();
+    lightingShaderWithTexture.release();
+    ourShader.release();
+    depthShader.release();
 
 
     // glfw: terminate, clearing all previously allocated GLFW resources.
@@ -965,40 +1081,32 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
     camera.ProcessMouseScroll(static_cast<float>(yoffset));
 }
 
-unsigned int loadTexture(char const* path, GLenum textureWrappingModeS, GLenum textureWrappingModeT, GLenum textureFilteringModeMin, GLenum textureFilteringModeMax)
+// textures are shared through the registry, so asking for the same file twice costs one decode and one upload
+// scaleShift 1-3 loads this texture at 1/2, 1/4 or 1/8 size; -1 follows textureQuality
+unsigned int loadTexture(char const* path, GLenum textureWrappingModeS, GLenum textureWrappingModeT, GLenum textureFilteringModeMin, GLenum textureFilteringModeMax, int scaleShift)
 {
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
+    // in texture array mode the images are loaded as layers of materialMaps instead
+    if (useTextureArray)
+        return 0;
 
-    int width, height, nrComponents;
-    stbi_set_flip_vertically_on_load(true);
-    unsigned char* data = stbi_load(path, &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
+    return textureRegistry.acquire(path, textureWrappingModeS, textureWrappingModeT, textureFilteringModeMin, textureFilteringModeMax, scaleShift);
+}
 
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
+// with packSpecularInAlpha the specular map at specularPath ends up in this texture's alpha
+unsigned int loadDiffuseTexture(char const* path, char const* specularPath, GLenum textureWrappingModeS, GLenum textureWrappingModeT, GLenum textureFilteringModeMin, GLenum textureFilteringModeMax)
+{
+    if (useTextureArray)
+        return 0;
 
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, textureWrappingModeS);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, textureWrappingModeT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, textureFilteringModeMin);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, textureFilteringModeMax);
+    return textureRegistry.acquire(path, textureWrappingModeS, textureWrappingModeT, textureFilteringModeMin, textureFilteringModeMax, -1,
+                                   packSpecularInAlpha ? specularPath : nullptr);
+}
 
-        stbi_image_free(data);
-    }
-    else
-    {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
+// returns 0 when the specular map is packed into the diffuse texture instead
+unsigned int loadSpecularTexture(char const* path, GLenum textureWrappingModeS, GLenum textureWrappingModeT, GLenum textureFilteringModeMin, GLenum textureFilteringModeMax)
+{
+    if (packSpecularInAlpha)
+        return 0;
 
-    return textureID;
+    return loadTexture(path, textureWrappingModeS, textureWrappingModeT, textureFilteringModeMin, textureFilteringModeMax);
 }
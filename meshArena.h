@@ -0,0 +1,244 @@
+//
+//  meshArena.h
+//  test
+//
+//  The vertex and index buffers every static mesh is stored in, and the
+//  shared VAOs they are drawn with.
+//
+
+#ifndef meshArena_h
+#define meshArena_h
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <iostream>
+
+#include "bufferArena.h"
+#include "glHandle.h"
+#include "packedMesh.h"
+
+// All meshes share one vertex BufferArena and one index BufferArena. A
+// mesh's vertices start on a multiple of its stride, so it is drawn with
+// glDrawElementsBaseVertex(baseVertex = offset / stride) and its indices
+// stay relative to its own first vertex. That makes the VAO independent of
+// the mesh: there is one per vertex format (and one per position stream
+// format, see PackedMesh), all pointing at offset 0 of the shared buffers,
+// and drawing another mesh of the same format needs no VAO change at all.
+//
+// Vertex arrays that add attributes of their own (per instance) point
+// attributes 0-2 at the arena with configureVertexArray() the same way.
+//
+// Capacities are read when the buffers are first created; a mesh that does
+// not fit is reported and left empty, which draws nothing.
+class MeshArena {
+public:
+    // one mesh's ranges in the arena; it moves but does not copy, so its ranges are freed once
+    struct Mesh {
+        VertexFormat format = VERTEX_FORMAT_FLOAT;
+        GLenum indexType = GL_UNSIGNED_INT;
+        GLint baseVertex = 0;
+        GLint positionBaseVertex = 0;   // baseVertex when there is no position stream
+        BufferArena::Range vertices;
+        BufferArena::Range positions;
+        BufferArena::Range indices;
+
+        Mesh()
+        {
+        }
+
+        Mesh(const Mesh&) = delete;
+        Mesh& operator=(const Mesh&) = delete;
+
+        Mesh(Mesh&& other) noexcept
+        {
+            *this = static_cast<Mesh&&>(other);
+        }
+
+        // the mesh moved into must already be empty (see MeshArena::remove)
+        Mesh& operator=(Mesh&& other) noexcept
+        {
+            format = other.format;
+            indexType = other.indexType;
+            baseVertex = other.baseVertex;
+            positionBaseVertex = other.positionBaseVertex;
+            vertices = other.vertices;
+            positions = other.positions;
+            indices = other.indices;
+            other.vertices = other.positions = other.indices = BufferArena::Range();
+            return *this;
+        }
+
+        bool empty() const
+        {
+            return indices.size == 0;
+        }
+
+        bool hasPositionStream() const
+        {
+            return positions.size != 0;
+        }
+
+        // the indices argument of a draw starting at index firstIndex of this mesh
+        const void* indexOffset(size_t firstIndex = 0) const
+        {
+            size_t indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+            return (const void*)(indices.offset + firstIndex * indexSize);
+        }
+    };
+
+    size_t vertexCapacity = 4 * 1024 * 1024;
+    size_t indexCapacity = 1024 * 1024;
+
+    static MeshArena& shared()
+    {
+        static MeshArena arena;
+        return arena;
+    }
+
+    MeshArena(const MeshArena&) = delete;
+    MeshArena& operator=(const MeshArena&) = delete;
+
+    // copies the packed mesh in; mesh must be empty
+    bool add(const PackedMesh& packed, Mesh& mesh)
+    {
+        size_t stride = PackedMesh::stride(packed.format);
+        size_t positionStride = PackedMesh::positionStride(packed.format);
+        size_t vertexCount = packed.vertices.size() / stride;
+
+        mesh.format = packed.format;
+        mesh.indexType = packed.indexType;
+        mesh.vertices = vertexArena().allocate(packed.vertices.size(), stride);
+        if (!packed.positions.empty())
+            mesh.positions = vertexArena().allocate(vertexCount * positionStride, positionStride);
+        mesh.indices = indexArena().allocate(packed.indices.size(), packed.indexSize());
+        if (mesh.vertices.size == 0 || mesh.indices.size == 0 || (!packed.positions.empty() && mesh.positions.size == 0))
+        {
+            std::cout << "Mesh arena: no room for " << packed.vertices.size() + packed.positions.size() << " bytes of vertices and "
+                      << packed.indices.size() << " bytes of indices" << std::endl;
+            remove(mesh);
+            return false;
+        }
+
+        vertexArena().upload(mesh.vertices, packed.vertices.data(), packed.vertices.size());
+        indexArena().upload(mesh.indices, packed.indices.data(), packed.indices.size());
+        mesh.baseVertex = (GLint)(mesh.vertices.offset / stride);
+        mesh.positionBaseVertex = mesh.baseVertex;
+        if (mesh.hasPositionStream())
+        {
+            vertexArena().upload(mesh.positions, packed.positions.data(), packed.positions.size());
+            mesh.positionBaseVertex = (GLint)(mesh.positions.offset / positionStride);
+        }
+        return true;
+    }
+
+    void remove(Mesh& mesh)
+    {
+        vertexArena().free(mesh.vertices);
+        vertexArena().free(mesh.positions);
+        indexArena().free(mesh.indices);
+    }
+
+    // binds the VAO for the mesh's format; draw with mesh.baseVertex
+    void bind(const Mesh& mesh)
+    {
+        GLVertexArray& VAO = vertexArrays[mesh.format];
+        if (!VAO)
+        {
+            VAO = GLVertexArray::create();
+            glBindVertexArray(VAO.get());
+            configureVertexArray(mesh.format);
+        }
+        glBindVertexArray(VAO.get());
+    }
+
+    // binds the position-only VAO when the mesh has a position stream, bind(mesh) otherwise; draw with mesh.positionBaseVertex
+    void bindPositions(const Mesh& mesh)
+    {
+        if (!mesh.hasPositionStream())
+        {
+            bind(mesh);
+            return;
+        }
+        GLVertexArray& VAO = positionArrays[mesh.format];
+        if (!VAO)
+        {
+            VAO = GLVertexArray::create();
+            glBindVertexArray(VAO.get());
+            configurePositionVertexArray(mesh.format);
+        }
+        glBindVertexArray(VAO.get());
+    }
+
+    // points attributes 0-2 of the bound VAO at the arena and attaches the index buffer
+    void configureVertexArray(VertexFormat format)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, vertexArena().name());
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexArena().name());
+        PackedMesh::configureAttributes(format);
+    }
+
+    // the same for attribute 0 alone, read from position streams
+    void configurePositionVertexArray(VertexFormat format)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, vertexArena().name());
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexArena().name());
+        PackedMesh::configurePositionAttribute(format);
+    }
+
+    void printStatistics()
+    {
+        std::cout << "Mesh arena: " << vertexArena().allocationCount() << " vertex ranges, " << vertexArena().used() / 1024 << " of "
+                  << vertexArena().capacity() / 1024 << " KB; " << indexArena().allocationCount() << " index ranges, "
+                  << indexArena().used() / 1024 << " of " << indexArena().capacity() / 1024 << " KB" << std::endl;
+    }
+
+    // call before the GL context goes away, after the meshes have been removed or released
+    void release()
+    {
+        for (int format = 0; format < formatCount; format++)
+        {
+            vertexArrays[format].reset();
+            positionArrays[format].reset();
+        }
+        vertices.release();
+        indices.release();
+    }
+
+private:
+    static const int formatCount = VERTEX_FORMAT_COMPACT + 1;
+
+    BufferArena vertices{ 0 };
+    BufferArena indices{ 0 };
+    bool sized = false;
+    GLVertexArray vertexArrays[formatCount];
+    GLVertexArray positionArrays[formatCount];
+
+    MeshArena()
+    {
+    }
+
+    BufferArena& vertexArena()
+    {
+        sizeArenas();
+        return vertices;
+    }
+
+    BufferArena& indexArena()
+    {
+        sizeArenas();
+        return indices;
+    }
+
+    // the capacities are public fields, so the arenas are made on first use
+    void sizeArenas()
+    {
+        if (sized)
+            return;
+        vertices = BufferArena(vertexCapacity);
+        indices = BufferArena(indexCapacity);
+        sized = true;
+    }
+};
+
+#endif /* meshArena_h */
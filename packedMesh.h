@@ -0,0 +1,212 @@
+//
+//  packedMesh.h
+//  test
+//
+//  Vertex and index data encoded for the GPU in either the plain float layout
+//  or a compact one, chosen per mesh.
+//
+
+#ifndef packedMesh_h
+#define packedMesh_h
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "vertexLayout.h"
+
+enum VertexFormat {
+    VERTEX_FORMAT_FLOAT,    // 32 bytes: float position, normal and texture coordinate
+    VERTEX_FORMAT_COMPACT   // 16 bytes: 16 bit position, 10 bit normal, half float texture coordinate
+};
+
+// Input is always TexturedVertexLayout, 8 floats per vertex (position,
+// normal, texture coordinate). The compact format is
+// CompactTexturedVertexLayout:
+//   0   position     3 x GL_UNSIGNED_SHORT normalized + 2 bytes padding, scaled to the mesh's bounds
+//   1   normal       GL_INT_2_10_10_10_REV normalized
+//   2   texcoord     2 x GL_HALF_FLOAT
+// Positions are stored as (p - min) / extent with one extent for all three
+// axes, so decoding them is a uniform scale plus a translation: the vertex
+// shader needs no changes, the mesh's owner multiplies positionDecode into
+// its model matrix, and the normals stay correct because a uniform scale
+// does not turn them.
+//
+// With positionStream, the positions are also written to a second, tightly
+// packed buffer (PositionVertexLayout or CompactPositionVertexLayout, same
+// encoding). Depth-only passes read just that: 12 or 8 bytes per vertex
+// instead of 32 or 16, so a cache line holds 3 (or 2) times the vertices.
+//
+// Indices are GL_UNSIGNED_SHORT whenever the mesh has at most 65536 vertices
+// and the format is compact, GL_UNSIGNED_INT otherwise.
+class PackedMesh {
+public:
+    static const int floatsPerVertex = TexturedVertexLayout::stride() / sizeof(float);
+
+    VertexFormat format = VERTEX_FORMAT_FLOAT;
+    std::vector<unsigned char> vertices;
+    std::vector<unsigned char> indices;
+    std::vector<unsigned char> positions;   // empty without positionStream
+    GLenum indexType = GL_UNSIGNED_INT;
+    glm::mat4 positionDecode = glm::mat4(1.0f);     // stored position to model space
+
+    static PackedMesh pack(VertexFormat format, const float* vertexData, size_t vertexCount, const unsigned int* indexData, size_t indexCount,
+                           bool positionStream = false)
+    {
+        PackedMesh mesh;
+        mesh.format = format;
+        if (format == VERTEX_FORMAT_COMPACT)
+            mesh.packCompactVertices(vertexData, vertexCount, positionStream);
+        else
+        {
+            mesh.vertices.assign((const unsigned char*)vertexData, (const unsigned char*)(vertexData + vertexCount * floatsPerVertex));
+            if (positionStream)
+            {
+                mesh.positions.resize(vertexCount * PositionVertexLayout::stride());
+                float* out = (float*)mesh.positions.data();
+                for (size_t i = 0; i < vertexCount; i++)
+                    memcpy(out + i * 3, vertexData + i * floatsPerVertex, 3 * sizeof(float));
+            }
+        }
+
+        if (format == VERTEX_FORMAT_COMPACT && vertexCount <= 65536)
+        {
+            mesh.indexType = GL_UNSIGNED_SHORT;
+            mesh.indices.resize(indexCount * sizeof(uint16_t));
+            uint16_t* out = (uint16_t*)mesh.indices.data();
+            for (size_t i = 0; i < indexCount; i++)
+                out[i] = (uint16_t)indexData[i];
+        }
+        else
+            mesh.indices.assign((const unsigned char*)indexData, (const unsigned char*)(indexData + indexCount));
+        return mesh;
+    }
+
+    static size_t stride(VertexFormat format)
+    {
+        return format == VERTEX_FORMAT_COMPACT ? CompactTexturedVertexLayout::stride() : TexturedVertexLayout::stride();
+    }
+
+    static size_t positionStride(VertexFormat format)
+    {
+        return format == VERTEX_FORMAT_COMPACT ? CompactPositionVertexLayout::stride() : PositionVertexLayout::stride();
+    }
+
+    size_t indexSize() const
+    {
+        return indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+    }
+
+    // points attributes 0-2 of the bound VAO at the bound GL_ARRAY_BUFFER
+    static void configureAttributes(VertexFormat format)
+    {
+        if (format == VERTEX_FORMAT_COMPACT)
+            CompactTexturedVertexLayout::configure();
+        else
+            TexturedVertexLayout::configure();
+    }
+
+    // points attribute 0 of the bound VAO at a bound position stream
+    static void configurePositionAttribute(VertexFormat format)
+    {
+        if (format == VERTEX_FORMAT_COMPACT)
+            CompactPositionVertexLayout::configure();
+        else
+            PositionVertexLayout::configure();
+    }
+
+    static uint16_t toHalf(float value)
+    {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        uint32_t sign = (bits >> 16) & 0x8000;
+        int exponent = (int)((bits >> 23) & 0xFF) - 127 + 15;
+        uint32_t mantissa = bits & 0x7FFFFF;
+
+        if (((bits >> 23) & 0xFF) == 0xFF)
+            return (uint16_t)(sign | 0x7C00 | (mantissa ? 0x200 : 0));     // inf, nan
+        if (exponent >= 31)
+            return (uint16_t)(sign | 0x7C00);
+        if (exponent <= 0)
+        {
+            // subnormal half, or zero below that
+            if (exponent < -10)
+                return (uint16_t)sign;
+            mantissa |= 0x800000;
+            int shift = 14 - exponent;
+            uint32_t half = mantissa >> shift;
+            uint32_t remainder = mantissa & ((1u << shift) - 1);
+            uint32_t halfway = 1u << (shift - 1);
+            if (remainder > halfway || (remainder == halfway && (half & 1)))
+                half++;
+            return (uint16_t)(sign | half);
+        }
+
+        uint32_t half = ((uint32_t)exponent << 10) | (mantissa >> 13);
+        uint32_t remainder = mantissa & 0x1FFF;
+        // round to nearest even; a carry into the exponent is still the right value
+        if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1)))
+            half++;
+        return (uint16_t)(sign | half);
+    }
+
+    static uint32_t toInt2101010(const glm::vec3& normal)
+    {
+        uint32_t packed = 0;
+        for (int i = 0; i < 3; i++)
+        {
+            int value = (int)std::lround(std::max(-1.0f, std::min(1.0f, normal[i])) * 511.0f);
+            packed |= ((uint32_t)value & 0x3FF) << (10 * i);
+        }
+        return packed;
+    }
+
+private:
+    void packCompactVertices(const float* vertexData, size_t vertexCount, bool positionStream)
+    {
+        glm::vec3 low(INFINITY), high(-INFINITY);
+        for (size_t i = 0; i < vertexCount; i++)
+        {
+            const float* vertex = vertexData + i * floatsPerVertex;
+            glm::vec3 position(vertex[0], vertex[1], vertex[2]);
+            low = glm::min(low, position);
+            high = glm::max(high, position);
+        }
+        if (vertexCount == 0)
+            low = high = glm::vec3(0.0f);
+        float extent = std::max(high.x - low.x, std::max(high.y - low.y, high.z - low.z));
+        if (extent <= 0.0f)
+            extent = 1.0f;
+        positionDecode = glm::scale(glm::translate(glm::mat4(1.0f), low), glm::vec3(extent));
+
+        typedef CompactTexturedVertexLayout Layout;
+        static_assert(Position3un16::size() == 3 * sizeof(uint16_t) && Normal10::size() == sizeof(uint32_t) && UV2h::size() == 2 * sizeof(uint16_t), "attribute sizes the writes below assume");
+        vertices.assign(vertexCount * Layout::stride(), 0);
+        if (positionStream)
+            positions.assign(vertexCount * CompactPositionVertexLayout::stride(), 0);
+        unsigned char* out = vertices.data();
+        for (size_t i = 0; i < vertexCount; i++, out += Layout::stride())
+        {
+            const float* vertex = vertexData + i * floatsPerVertex;
+            uint16_t position[3];
+            for (int axis = 0; axis < 3; axis++)
+                position[axis] = (uint16_t)std::lround(std::max(0.0f, std::min(1.0f, (vertex[axis] - low[axis]) / extent)) * 65535.0f);
+            uint32_t normal = toInt2101010(glm::vec3(vertex[3], vertex[4], vertex[5]));
+            uint16_t texCoords[2] = { toHalf(vertex[6]), toHalf(vertex[7]) };
+
+            memcpy(out + Layout::offset(0), position, sizeof(position));
+            memcpy(out + Layout::offset(1), &normal, sizeof(normal));
+            memcpy(out + Layout::offset(2), texCoords, sizeof(texCoords));
+            if (positionStream)
+                memcpy(positions.data() + i * CompactPositionVertexLayout::stride(), position, sizeof(position));
+        }
+    }
+};
+
+#endif /* packedMesh_h */
@@ -0,0 +1,177 @@
+//
+//  pixelUnpackRing.h
+//  test
+//
+//  Ring of pixel unpack buffers used to stage texture uploads.
+//
+
+#ifndef pixelUnpackRing_h
+#define pixelUnpackRing_h
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <vector>
+
+// Each slot is its own PBO so one can be mapped (and filled by a worker
+// thread) while others are unmapped and feeding glTexSubImage2D. A slot is
+// only handed out again once the fence placed after its last upload has
+// signaled, so the driver never has to stall or copy behind our back.
+class PixelUnpackRing {
+public:
+    explicit PixelUnpackRing(unsigned int slotCount = 4)
+    {
+        slots.resize(slotCount);
+    }
+
+    ~PixelUnpackRing()
+    {
+        release();
+    }
+
+    PixelUnpackRing(const PixelUnpackRing&) = delete;
+    PixelUnpackRing& operator=(const PixelUnpackRing&) = delete;
+
+    // what acquire() returns when it has no slot to hand out
+    static const int busy = -1;         // every slot is still in use; try again later
+    static const int unavailable = -2;  // the buffer could not be mapped, or waiting got nowhere
+
+    // Returns a free slot with room for size bytes, mapped for writing, or
+    // busy if every slot is still in use. With wait set it blocks on the
+    // oldest fence instead of giving up, and returns unavailable when that
+    // frees nothing. A failed map (out of memory, say) is unavailable too:
+    // stage that texture some other way rather than asking again.
+    int acquire(size_t size, void** mapped, bool wait)
+    {
+        for (int attempt = 0; attempt < 2; attempt++)
+        {
+            for (size_t i = 0; i < slots.size(); i++)
+            {
+                Slot& slot = slots[(next + i) % slots.size()];
+                if (slot.mapped || !isIdle(slot, 0))
+                    continue;
+
+                int index = (int)((next + i) % slots.size());
+                next = (index + 1) % slots.size();
+                *mapped = map(slot, size);
+                return *mapped ? index : unavailable;
+            }
+
+            if (!wait)
+                return busy;
+
+            // nothing idle yet; wait for the oldest upload still in flight
+            Slot* oldest = nullptr;
+            for (Slot& slot : slots)
+                if (!slot.mapped && slot.fence && (!oldest || slot.fenceSerial < oldest->fenceSerial))
+                    oldest = &slot;
+            if (!oldest)
+                return unavailable;
+            isIdle(*oldest, GL_TIMEOUT_IGNORED);
+        }
+        return unavailable;
+    }
+
+    // unmaps the slot and leaves its PBO bound to GL_PIXEL_UNPACK_BUFFER; upload from offset 0, then call fence()
+    bool bindForUpload(int index)
+    {
+        Slot& slot = slots[index];
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+        bool intact = glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_TRUE;
+        slot.mapped = false;
+        return intact;
+    }
+
+    // marks the uploads issued from the slot; it is reused once the GPU is past them
+    void fence(int index)
+    {
+        Slot& slot = slots[index];
+        slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        slot.fenceSerial = ++fenceCount;
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+
+    // gives a slot back without uploading from it (for example after a failed decode)
+    void discard(int index)
+    {
+        bindForUpload(index);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+
+    void release()
+    {
+        for (Slot& slot : slots)
+        {
+            if (slot.fence)
+                glDeleteSync(slot.fence);
+            if (slot.buffer)
+            {
+                if (slot.mapped)
+                {
+                    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+                    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+                    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+                }
+                glDeleteBuffers(1, &slot.buffer);
+            }
+            slot = Slot();
+        }
+    }
+
+    size_t slotCount() const
+    {
+        return slots.size();
+    }
+
+private:
+    struct Slot {
+        unsigned int buffer = 0;
+        size_t capacity = 0;
+        GLsync fence = nullptr;
+        unsigned long long fenceSerial = 0;
+        bool mapped = false;
+    };
+
+    std::vector<Slot> slots;
+    size_t next = 0;
+    unsigned long long fenceCount = 0;
+
+    static bool isIdle(Slot& slot, GLuint64 timeout)
+    {
+        if (!slot.fence)
+            return true;
+
+        GLenum status = glClientWaitSync(slot.fence, timeout == 0 ? 0 : GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+        if (status == GL_TIMEOUT_EXPIRED || status == GL_WAIT_FAILED)
+            return false;
+
+        glDeleteSync(slot.fence);
+        slot.fence = nullptr;
+        return true;
+    }
+
+    void* map(Slot& slot, size_t size)
+    {
+        if (!slot.buffer)
+            glGenBuffers(1, &slot.buffer);
+
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+        if (slot.capacity < size)
+        {
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+            slot.capacity = size;
+        }
+
+        // the fence already guarantees the GPU is done reading, so skip the driver's own synchronization
+        void* pointer = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size,
+                                         GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        slot.mapped = pointer != nullptr;
+        // glBufferData may have failed as well; allocate again next time
+        if (!pointer)
+            slot.capacity = 0;
+        return pointer;
+    }
+};
+
+#endif /* pixelUnpackRing_h */
@@ -11,6 +11,7 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 #include "shader.h"
+#include "lightBlock.h"
 
 class PointLight {
 public:
@@ -34,50 +35,18 @@ public:
         k_q = quadratic;
         lightNumber = num;
     }
-    void setUpPointLight(Shader& lightingShader)
+    // light lightNumber goes to element lightNumber - 1 of the block; uploaded by lights.upload()
+    void setUpPointLight(LightBlock& lights)
     {
-        lightingShader.use();
-
-        if (lightNumber == 1) {
-            lightingShader.setVec3("pointLights[0].position", position);
-            lightingShader.setVec3("pointLights[0].ambient", ambientOn * ambient);
-            lightingShader.setVec3("pointLights[0].diffuse", diffuseOn * diffuse);
-            lightingShader.setVec3("pointLights[0].specular", specularOn * specular);
-            lightingShader.setFloat("pointLights[0].k_c", k_c);
-            lightingShader.setFloat("pointLights[0].k_l", k_l);
-            lightingShader.setFloat("pointLights[0].k_q", k_q);
-        }
-
-        else if (lightNumber == 2)
-        {
-            lightingShader.setVec3("pointLights[1].position", position);
-            lightingShader.setVec3("pointLights[1].ambient", ambientOn * ambient);
-            lightingShader.setVec3("pointLights[1].diffuse", diffuseOn * diffuse);
-            lightingShader.setVec3("pointLights[1].specular", specularOn * specular);
-            lightingShader.setFloat("pointLights[1].k_c", k_c);
-            lightingShader.setFloat("pointLights[1].k_l", k_l);
-            lightingShader.setFloat("pointLights[1].k_q", k_q);
-        }
-        else if (lightNumber == 3)
-        {
-            lightingShader.setVec3("pointLights[2].position", position);
-            lightingShader.setVec3("pointLights[2].ambient", ambientOn * ambient);
-            lightingShader.setVec3("pointLights[2].diffuse", diffuseOn * diffuse);
-            lightingShader.setVec3("pointLights[2].specular", specularOn * specular);
-            lightingShader.setFloat("pointLights[2].k_c", k_c);
-            lightingShader.setFloat("pointLights[2].k_l", k_l);
-            lightingShader.setFloat("pointLights[2].k_q", k_q);
-        }
-        else
-        {
-            lightingShader.setVec3("pointLights[3].position", position);
-            lightingShader.setVec3("pointLights[3].ambient", ambientOn * ambient);
-            lightingShader.setVec3("pointLights[3].diffuse", diffuseOn * diffuse);
-            lightingShader.setVec3("pointLights[3].specular", specularOn * specular);
-            lightingShader.setFloat("pointLights[3].k_c", k_c);
-            lightingShader.setFloat("pointLights[3].k_l", k_l);
-            lightingShader.setFloat("pointLights[3].k_q", k_q);
-        }
+        LightBlock::Light light;
+        light.position = position;
+        light.ambient = ambientOn * ambient;
+        light.diffuse = diffuseOn * diffuse;
+        light.specular = specularOn * specular;
+        light.k_c = k_c;
+        light.k_l = k_l;
+        light.k_q = k_q;
+        lights.set(lightNumber - 1, light);
     }
     void turnOff()
     {
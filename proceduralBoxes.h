@@ -0,0 +1,186 @@
+//
+//  proceduralBoxes.h
+//  test
+//
+//  Axis-aligned boxes drawn without any vertex buffer: the vertex shader builds
+//  each corner, normal and UV from gl_VertexID and a 48 byte per-box record.
+//
+
+#ifndef proceduralBoxes_h
+#define proceduralBoxes_h
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <vector>
+
+#include "cube.h"
+#include "glHandle.h"
+#include "shader.h"
+#include "shaderUniforms.h"
+
+// Every box is three RGBA32F texels of a buffer texture:
+//   0   min corner, packed layers (diffuse layer + layerStride * (specular layer + 1))
+//   1   max corner, shininess
+//   2   UV rectangle (u min, v min, u max, v max)
+// Boxes are drawn as glDrawArraysInstanced(GL_TRIANGLES, 0, 36, count) with an
+// empty VAO; shaders compiled with PROCEDURAL_BOXES read record boxOffset +
+// gl_InstanceID and pick the face (gl_VertexID / 6) and corner from tables.
+// Like CubeInstances, boxes are grouped by texture, one draw per group.
+//
+// Only the box's extent is stored, so a transform with negative scale
+// draws the same box but without the mirrored texture it gets as a mesh.
+class ProceduralBoxes {
+public:
+    // sampler unit of the box records; 0 and 1 hold the material maps
+    static const int recordUnit = 2;
+    static const int layerStride = 2048;
+
+    void add(const glm::vec3& minCorner, const glm::vec3& maxCorner, const Cube* cube = nullptr)
+    {
+        PendingBox box;
+        box.record[0] = glm::vec4(glm::min(minCorner, maxCorner), 0.0f);
+        box.record[1] = glm::vec4(glm::max(minCorner, maxCorner), 32.0f);
+        box.record[2] = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+        box.diffuseMap = 0;
+        box.specularMap = 0;
+        if (cube)
+        {
+            int diffuseLayer = std::max(cube->diffuseLayer, 0);
+            box.record[0].w = (float)(diffuseLayer + layerStride * (cube->specularLayer + 1));
+            box.record[1].w = cube->shininess;
+            box.record[2] = glm::vec4(cube->TXmin, cube->TYmin, cube->TXmax, cube->TYmax);
+            if (cube->diffuseLayer < 0)
+            {
+                box.diffuseMap = cube->diffuseMap;
+                box.specularMap = cube->specularMap;
+            }
+        }
+        pendingBoxes.push_back(box);
+    }
+
+    // the unit cube under transform, which must only scale and translate
+    void add(const glm::mat4& transform, const Cube* cube = nullptr)
+    {
+        add(glm::vec3(transform * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f)), glm::vec3(transform * glm::vec4(1.0f, 1.0f, 1.0f, 1.0f)), cube);
+    }
+
+    size_t size() const
+    {
+        return pendingBoxes.size();
+    }
+
+    size_t groupCount() const
+    {
+        return groups.size();
+    }
+
+    size_t recordBytes() const
+    {
+        return pendingBoxes.size() * sizeof(glm::vec4) * 3;
+    }
+
+    void upload()
+    {
+        groups.clear();
+        if (pendingBoxes.empty())
+            return;
+
+        std::vector<PendingBox> sorted = pendingBoxes;
+        std::stable_sort(sorted.begin(), sorted.end(), [](const PendingBox& a, const PendingBox& b) {
+            return a.diffuseMap != b.diffuseMap ? a.diffuseMap < b.diffuseMap : a.specularMap < b.specularMap;
+        });
+
+        std::vector<glm::vec4> records;
+        records.reserve(sorted.size() * 3);
+        for (const PendingBox& box : sorted)
+        {
+            GLsizei index = (GLsizei)(records.size() / 3);
+            if (groups.empty() || groups.back().diffuseMap != box.diffuseMap || groups.back().specularMap != box.specularMap)
+                groups.push_back(Group{ box.diffuseMap, box.specularMap, index, 0 });
+            groups.back().count++;
+            records.insert(records.end(), box.record, box.record + 3);
+        }
+
+        if (!recordBuffer)
+        {
+            recordBuffer = GLBuffer::create();
+            recordTexture = GLTexture::create();
+            // a core profile draw needs a VAO bound even when it has no attributes
+            VAO = GLVertexArray::create();
+        }
+        glBindBuffer(GL_TEXTURE_BUFFER, recordBuffer.get());
+        glBufferData(GL_TEXTURE_BUFFER, records.size() * sizeof(glm::vec4), records.data(), GL_STATIC_DRAW);
+        glBindTexture(GL_TEXTURE_BUFFER, recordTexture.get());
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, recordBuffer.get());
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+
+    // the shader must be in use, with its PROCEDURAL_BOXES path, uniforms bound to it and the scene model/normalMatrix set
+    void draw(const Shader& shader, const TexturedPhongUniforms& uniforms) const
+    {
+        if (groups.empty())
+            return;
+
+        uniforms.boxRecords.set(shader, recordUnit);
+        glActiveTexture(GL_TEXTURE0 + recordUnit);
+        glBindTexture(GL_TEXTURE_BUFFER, recordTexture.get());
+        glBindVertexArray(VAO.get());
+
+        for (const Group& group : groups)
+        {
+            if (group.diffuseMap)
+            {
+                uniforms.material.diffuse.set(shader, 0);
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, group.diffuseMap);
+                if (group.specularMap)
+                {
+                    uniforms.material.specular.set(shader, 1);
+                    glActiveTexture(GL_TEXTURE1);
+                    glBindTexture(GL_TEXTURE_2D, group.specularMap);
+                }
+            }
+
+            uniforms.boxOffset.set(shader, group.first);
+            glDrawArraysInstanced(GL_TRIANGLES, 0, 36, group.count);
+        }
+    }
+
+    void clear()
+    {
+        pendingBoxes.clear();
+        groups.clear();
+    }
+
+    void release()
+    {
+        groups.clear();
+        recordTexture.reset();
+        recordBuffer.reset();
+        VAO.reset();
+    }
+
+private:
+    struct PendingBox {
+        glm::vec4 record[3];
+        unsigned int diffuseMap;
+        unsigned int specularMap;
+    };
+
+    struct Group {
+        unsigned int diffuseMap;
+        unsigned int specularMap;
+        GLsizei first;
+        GLsizei count;
+    };
+
+    std::vector<PendingBox> pendingBoxes;
+    std::vector<Group> groups;
+    GLBuffer recordBuffer;
+    GLTexture recordTexture;
+    GLVertexArray VAO;
+};
+
+#endif /* proceduralBoxes_h */
@@ -4,59 +4,49 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
+#include <cstdint>
+#include <cstring>
 #include <string>
+#include <vector>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 
+#include "assetPack.h"
+#include "glHandle.h"
+
+// Owns its program; move-only, like the GLProgram it holds.
 class Shader
 {
 public:
-    unsigned int ID;
     // constructor generates the shader on the fly
+    // defines (e.g. "#define TEXTURE_ARRAY\n") is inserted right after each stage's #version line
+    // sources come from the mounted AssetPack when it has them
     // ------------------------------------------------------------------------
-    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
+    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr, const std::string& defines = "")
     {
         // 1. retrieve the vertex/fragment source code from filePath
         std::string vertexCode;
         std::string fragmentCode;
         std::string geometryCode;
-        std::ifstream vShaderFile;
-        std::ifstream fShaderFile;
-        std::ifstream gShaderFile;
-        // ensure ifstream objects can throw exceptions:
-        vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-        fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-        gShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
         try
         {
-            // open files
-            vShaderFile.open(vertexPath);
-            fShaderFile.open(fragmentPath);
-            std::stringstream vShaderStream, fShaderStream;
-            // read file's buffer contents into streams
-            vShaderStream << vShaderFile.rdbuf();
-            fShaderStream << fShaderFile.rdbuf();
-            // close file handlers
-            vShaderFile.close();
-            fShaderFile.close();
-            // convert stream into string
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();
+            vertexCode = readSource(vertexPath);
+            fragmentCode = readSource(fragmentPath);
             // if geometry shader path is present, also load a geometry shader
             if (geometryPath != nullptr)
-            {
-                gShaderFile.open(geometryPath);
-                std::stringstream gShaderStream;
-                gShaderStream << gShaderFile.rdbuf();
-                gShaderFile.close();
-                geometryCode = gShaderStream.str();
-            }
+                geometryCode = readSource(geometryPath);
         }
         catch (std::ifstream::failure& e)
         {
             std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << e.what() << std::endl;
         }
+        if (!defines.empty())
+        {
+            insertDefines(vertexCode, defines);
+            insertDefines(fragmentCode, defines);
+            insertDefines(geometryCode, defines);
+        }
         const char* vShaderCode = vertexCode.c_str();
         const char* fShaderCode = fragmentCode.c_str();
         // 2. compile shaders
@@ -82,13 +72,14 @@ public:
             checkCompileErrors(geometry, "GEOMETRY");
         }
         // shader Program
-        ID = glCreateProgram();
-        glAttachShader(ID, vertex);
-        glAttachShader(ID, fragment);
+        program = GLProgram::create();
+        glAttachShader(program.get(), vertex);
+        glAttachShader(program.get(), fragment);
         if (geometryPath != nullptr)
-            glAttachShader(ID, geometry);
-        glLinkProgram(ID);
-        checkCompileErrors(ID, "PROGRAM");
+            glAttachShader(program.get(), geometry);
+        glLinkProgram(program.get());
+        checkCompileErrors(program.get(), "PROGRAM");
+        reflectUniforms();
         // delete the shaders as they're linked into our program now and no longer necessary
         glDeleteShader(vertex);
         glDeleteShader(fragment);
@@ -100,68 +91,292 @@ public:
     // ------------------------------------------------------------------------
     void use()
     {
-        glUseProgram(ID);
+        glUseProgram(program.get());
+    }
+    // deletes the program; call before the GL context goes away
+    // ------------------------------------------------------------------------
+    void release()
+    {
+        program.reset();
+    }
+    // points the program's uniform block name at a binding point, if it has the block
+    // ------------------------------------------------------------------------
+    void bindUniformBlock(const char* name, GLuint binding) const
+    {
+        GLuint index = glGetUniformBlockIndex(program.get(), name);
+        if (index != GL_INVALID_INDEX)
+            glUniformBlockBinding(program.get(), index, binding);
     }
     // utility uniform functions
+    // Names are looked up in the table built after linking, so a call makes no
+    // glGetUniformLocation call and no allocation; a value equal to the one
+    // last set is not uploaded again. uniform() resolves a name once for
+    // setters that skip even the lookup.
+    // ------------------------------------------------------------------------
+    struct Uniform {
+        int slot = -1;  // -1 when the program has no such active uniform
+    };
+    Uniform uniform(const char* name) const
+    {
+        Uniform handle;
+        handle.slot = findUniform(name);
+        return handle;
+    }
     // ------------------------------------------------------------------------
-    void setBool(const std::string& name, bool value) const
+    void setBool(const char* name, bool value) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+        setInt(name, (int)value);
     }
     // ------------------------------------------------------------------------
-    void setInt(const std::string& name, int value) const
+    void setInt(const char* name, int value) const
+    {
+        setInt(uniform(name), value);
+    }
+    void setInt(Uniform handle, int value) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+        GLint location = changedLocation(handle, &value, sizeof(value));
+        if (location >= 0)
+            glUniform1i(location, value);
     }
     // ------------------------------------------------------------------------
-    void setFloat(const std::string& name, float value) const
+    void setFloat(const char* name, float value) const
     {
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+        setFloat(uniform(name), value);
+    }
+    void setFloat(Uniform handle, float value) const
+    {
+        GLint location = changedLocation(handle, &value, sizeof(value));
+        if (location >= 0)
+            glUniform1f(location, value);
     }
     // ------------------------------------------------------------------------
-    void setVec2(const std::string& name, const glm::vec2& value) const
+    void setVec2(const char* name, const glm::vec2& value) const
     {
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        setVec2(uniform(name), value);
     }
-    void setVec2(const std::string& name, float x, float y) const
+    void setVec2(const char* name, float x, float y) const
     {
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+        setVec2(uniform(name), glm::vec2(x, y));
+    }
+    void setVec2(Uniform handle, const glm::vec2& value) const
+    {
+        GLint location = changedLocation(handle, &value[0], sizeof(float) * 2);
+        if (location >= 0)
+            glUniform2fv(location, 1, &value[0]);
     }
     // ------------------------------------------------------------------------
-    void setVec3(const std::string& name, const glm::vec3& value) const
+    void setVec3(const char* name, const glm::vec3& value) const
     {
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        setVec3(uniform(name), value);
     }
-    void setVec3(const std::string& name, float x, float y, float z) const
+    void setVec3(const char* name, float x, float y, float z) const
     {
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+        setVec3(uniform(name), glm::vec3(x, y, z));
+    }
+    void setVec3(Uniform handle, const glm::vec3& value) const
+    {
+        GLint location = changedLocation(handle, &value[0], sizeof(float) * 3);
+        if (location >= 0)
+            glUniform3fv(location, 1, &value[0]);
     }
     // ------------------------------------------------------------------------
-    void setVec4(const std::string& name, const glm::vec4& value) const
+    void setVec4(const char* name, const glm::vec4& value) const
+    {
+        setVec4(uniform(name), value);
+    }
+    void setVec4(const char* name, float x, float y, float z, float w) const
     {
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        setVec4(uniform(name), glm::vec4(x, y, z, w));
     }
-    void setVec4(const std::string& name, float x, float y, float z, float w)
+    void setVec4(Uniform handle, const glm::vec4& value) const
     {
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+        GLint location = changedLocation(handle, &value[0], sizeof(float) * 4);
+        if (location >= 0)
+            glUniform4fv(location, 1, &value[0]);
     }
     // ------------------------------------------------------------------------
-    void setMat2(const std::string& name, const glm::mat2& mat) const
+    void setMat2(const char* name, const glm::mat2& mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        GLint location = changedLocation(uniform(name), &mat[0][0], sizeof(float) * 4);
+        if (location >= 0)
+            glUniformMatrix2fv(location, 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
-    void setMat3(const std::string& name, const glm::mat3& mat) const
+    void setMat3(const char* name, const glm::mat3& mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        setMat3(uniform(name), mat);
+    }
+    void setMat3(Uniform handle, const glm::mat3& mat) const
+    {
+        GLint location = changedLocation(handle, &mat[0][0], sizeof(float) * 9);
+        if (location >= 0)
+            glUniformMatrix3fv(location, 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
-    void setMat4(const std::string& name, const glm::mat4& mat) const
+    void setMat4(const char* name, const glm::mat4& mat) const
+    {
+        setMat4(uniform(name), mat);
+    }
+    void setMat4(Uniform handle, const glm::mat4& mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        GLint location = changedLocation(handle, &mat[0][0], sizeof(float) * 16);
+        if (location >= 0)
+            glUniformMatrix4fv(location, 1, GL_FALSE, &mat[0][0]);
     }
 
 private:
+    // one active uniform; arrays get an entry per element ("pointLights[2].k_q")
+    struct UniformSlot {
+        uint32_t hash;
+        uint32_t nameOffset;    // into uniformNames, null terminated
+        GLint location;
+        uint32_t valueOffset;   // into uniformValues
+        uint32_t valueSize;
+    };
+
+    GLProgram program;
+    std::vector<UniformSlot> uniforms;
+    std::vector<int> uniformTable;      // open addressing, power of two size; -1 is empty
+    std::vector<char> uniformNames;
+    mutable std::vector<unsigned char> uniformValues;
+    mutable std::vector<bool> uniformKnown;     // whether uniformValues holds what the program has
+
+    static uint32_t hashName(const char* name)
+    {
+        // FNV-1a
+        uint32_t hash = 2166136261u;
+        for (; *name; name++)
+            hash = (hash ^ (unsigned char)*name) * 16777619u;
+        return hash;
+    }
+    // ------------------------------------------------------------------------
+    int findUniform(const char* name) const
+    {
+        if (uniformTable.empty())
+            return -1;
+        uint32_t hash = hashName(name);
+        size_t mask = uniformTable.size() - 1;
+        for (size_t i = hash & mask;; i = (i + 1) & mask)
+        {
+            int slot = uniformTable[i];
+            if (slot < 0)
+                return -1;
+            if (uniforms[slot].hash == hash && strcmp(&uniformNames[uniforms[slot].nameOffset], name) == 0)
+                return slot;
+        }
+    }
+    // ------------------------------------------------------------------------
+    // the location to upload to, or -1 when there is no such uniform or it already holds value
+    GLint changedLocation(Uniform handle, const void* value, size_t size) const
+    {
+        if (handle.slot < 0)
+            return -1;
+        const UniformSlot& slot = uniforms[handle.slot];
+        if (size <= slot.valueSize)
+        {
+            unsigned char* cached = &uniformValues[slot.valueOffset];
+            if (uniformKnown[handle.slot] && memcmp(cached, value, size) == 0)
+                return -1;
+            memcpy(cached, value, size);
+            uniformKnown[handle.slot] = true;
+        }
+        return slot.location;
+    }
+    // ------------------------------------------------------------------------
+    static size_t uniformBytes(GLenum type)
+    {
+        switch (type)
+        {
+        case GL_FLOAT_VEC2: case GL_INT_VEC2: case GL_BOOL_VEC2: return 8;
+        case GL_FLOAT_VEC3: case GL_INT_VEC3: case GL_BOOL_VEC3: return 12;
+        case GL_FLOAT_VEC4: case GL_INT_VEC4: case GL_BOOL_VEC4: case GL_FLOAT_MAT2: return 16;
+        case GL_FLOAT_MAT3: return 36;
+        case GL_FLOAT_MAT4: return 64;
+        default: return 4;  // scalars and samplers
+        }
+    }
+    // ------------------------------------------------------------------------
+    // builds the name table from the linked program's active uniforms
+    void reflectUniforms()
+    {
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(program.get(), GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(program.get(), GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::vector<char> name(maxLength + 16);
+        size_t valueBytes = 0;
+        for (GLint i = 0; i < count; i++)
+        {
+            GLint arraySize;
+            GLenum type;
+            glGetActiveUniform(program.get(), (GLuint)i, maxLength, NULL, &arraySize, &type, name.data());
+            // "a[0]" for an array; its elements are looked up by their own names
+            std::string baseName = name.data();
+            bool isArray = baseName.size() > 3 && baseName.compare(baseName.size() - 3, 3, "[0]") == 0;
+            if (isArray)
+                baseName.resize(baseName.size() - 3);
+            for (GLint element = 0; element < (isArray ? arraySize : 1); element++)
+            {
+                std::string elementName = isArray ? baseName + "[" + std::to_string(element) + "]" : baseName;
+                GLint location = glGetUniformLocation(program.get(), elementName.c_str());
+                if (location < 0)
+                    continue;   // uniform block members
+                UniformSlot slot;
+                slot.hash = hashName(elementName.c_str());
+                slot.nameOffset = (uint32_t)uniformNames.size();
+                slot.location = location;
+                slot.valueOffset = (uint32_t)valueBytes;
+                slot.valueSize = (uint32_t)uniformBytes(type);
+                uniformNames.insert(uniformNames.end(), elementName.c_str(), elementName.c_str() + elementName.size() + 1);
+                valueBytes += slot.valueSize;
+                uniforms.push_back(slot);
+            }
+        }
+        uniformValues.assign(valueBytes, 0);
+        uniformKnown.assign(uniforms.size(), false);
+
+        size_t tableSize = 16;
+        while (tableSize < uniforms.size() * 2)
+            tableSize *= 2;
+        uniformTable.assign(tableSize, -1);
+        for (size_t slot = 0; slot < uniforms.size(); slot++)
+        {
+            size_t mask = tableSize - 1;
+            size_t i = uniforms[slot].hash & mask;
+            while (uniformTable[i] >= 0)
+                i = (i + 1) & mask;
+            uniformTable[i] = (int)slot;
+        }
+    }
+
+    // straight from the mapped pack if it holds path, otherwise from the file; throws std::ifstream::failure
+    // ------------------------------------------------------------------------
+    static std::string readSource(const char* path)
+    {
+        const unsigned char* data;
+        size_t size;
+        if (AssetPack::findMounted(path, &data, &size))
+            return std::string((const char*)data, size);
+
+        std::ifstream shaderFile;
+        // ensure ifstream objects can throw exceptions:
+        shaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+        shaderFile.open(path);
+        std::stringstream shaderStream;
+        shaderStream << shaderFile.rdbuf();
+        return shaderStream.str();
+    }
+    // #version has to stay the first line, so the defines go after it
+    // ------------------------------------------------------------------------
+    static void insertDefines(std::string& code, const std::string& defines)
+    {
+        if (code.empty())
+            return;
+        size_t lineEnd = code.compare(0, 8, "#version") == 0 ? code.find('\n') : std::string::npos;
+        if (lineEnd == std::string::npos)
+            code.insert(0, defines);
+        else
+            code.insert(lineEnd + 1, defines);
+    }
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     void checkCompileErrors(GLuint shader, std::string type)
@@ -0,0 +1,592 @@
+//
+//  shaderReflect.cpp
+//  test
+//
+//  Build step: reads each program's vertex and fragment shader and writes
+//  shaderUniforms.h, a struct per program with a typed slot for every
+//  uniform it declares, and the binding point and std140 offsets of every
+//  uniform block.
+//  Renaming or retyping a uniform in a shader then breaks the build where
+//  the C++ side still uses the old one, instead of silently setting nothing.
+//
+//  usage: ShaderReflect [-o header] [Name vertexShader fragmentShader ...]
+//
+
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+struct Member {
+    string type;
+    string name;
+    int arraySize;  // 0 when not an array
+};
+
+struct StructType {
+    string name;
+    vector<Member> members;
+};
+
+struct Block {
+    string name;
+    vector<Member> members;
+    string source;
+};
+
+struct Program {
+    string name;
+    vector<string> paths;
+    vector<Member> uniforms;
+    map<string, StructType> structs;
+    vector<string> blocks;
+};
+
+int errors = 0;
+
+void fail(const string& where, const string& message)
+{
+    cout << where << ": error: " << message << endl;
+    errors++;
+}
+
+bool readFile(const string& path, string& text)
+{
+    ifstream file(path, ios::binary);
+    if (!file)
+        return false;
+    text.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+    return true;
+}
+
+string stripComments(const string& text)
+{
+    string out;
+    for (size_t i = 0; i < text.size(); i++)
+    {
+        if (text.compare(i, 2, "//") == 0)
+        {
+            while (i < text.size() && text[i] != '\n')
+                i++;
+            out += '\n';
+        }
+        else if (text.compare(i, 2, "/*") == 0)
+        {
+            size_t end = text.find("*/", i + 2);
+            i = end == string::npos ? text.size() : end + 1;
+            out += ' ';
+        }
+        else
+            out += text[i];
+    }
+    return out;
+}
+
+// Preprocessor lines are dropped except integer #defines (array sizes), so
+// the declarations of every #if branch are read: a struct or program gets
+// the union of its variants' uniforms, and a variant that compiles some of
+// them out just leaves those slots unresolved.
+vector<string> tokenize(const string& source, map<string, int>& defines)
+{
+    vector<string> tokens;
+    istringstream lines(stripComments(source));
+    string line;
+    while (getline(lines, line))
+    {
+        size_t first = line.find_first_not_of(" \t\r");
+        if (first != string::npos && line[first] == '#')
+        {
+            istringstream directive(line.substr(first + 1));
+            string keyword, name, value;
+            directive >> keyword >> name >> value;
+            if (keyword == "define" && !value.empty() && isdigit((unsigned char)value[0]))
+                defines[name] = atoi(value.c_str());
+            continue;
+        }
+        for (size_t i = 0; i < line.size();)
+        {
+            unsigned char c = line[i];
+            if (isspace(c))
+                i++;
+            else if (isalnum(c) || c == '_')
+            {
+                size_t start = i;
+                while (i < line.size() && (isalnum((unsigned char)line[i]) || line[i] == '_' || line[i] == '.'))
+                    i++;
+                tokens.push_back(line.substr(start, i - start));
+            }
+            else
+                tokens.push_back(string(1, line[i++]));
+        }
+    }
+    return tokens;
+}
+
+bool isQualifier(const string& token)
+{
+    return token == "lowp" || token == "mediump" || token == "highp" || token == "flat" || token == "smooth";
+}
+
+// "type name [N], name2;" up to and including the semicolon
+bool parseDeclaration(const vector<string>& tokens, size_t& i, const map<string, int>& defines, vector<Member>& members,
+                      const string& where)
+{
+    while (i < tokens.size() && isQualifier(tokens[i]))
+        i++;
+    if (i >= tokens.size())
+        return false;
+    string type = tokens[i++];
+    while (i < tokens.size())
+    {
+        Member member;
+        member.type = type;
+        member.name = tokens[i++];
+        member.arraySize = 0;
+        if (i < tokens.size() && tokens[i] == "[")
+        {
+            string size = i + 1 < tokens.size() ? tokens[i + 1] : "";
+            auto define = defines.find(size);
+            if (define != defines.end())
+                member.arraySize = define->second;
+            else if (!size.empty() && isdigit((unsigned char)size[0]))
+                member.arraySize = atoi(size.c_str());
+            else
+                fail(where, "array size of " + member.name + " is not a number or #define");
+            i += 3;
+        }
+        members.push_back(member);
+        if (i < tokens.size() && tokens[i] == ",")
+        {
+            i++;
+            continue;
+        }
+        if (i < tokens.size() && tokens[i] == ";")
+        {
+            i++;
+            return true;
+        }
+        fail(where, "could not read the declaration of " + member.name);
+        return false;
+    }
+    return false;
+}
+
+void parseMembers(const vector<string>& tokens, size_t& i, const map<string, int>& defines, vector<Member>& members, const string& where)
+{
+    // i is just past the '{'
+    while (i < tokens.size() && tokens[i] != "}")
+    {
+        if (!parseDeclaration(tokens, i, defines, members, where))
+            return;
+    }
+    i++;
+}
+
+// adds members not yet present; the same name with another type is an error
+void mergeMembers(vector<Member>& into, const vector<Member>& members, const string& where)
+{
+    for (const Member& member : members)
+    {
+        bool found = false;
+        for (const Member& existing : into)
+        {
+            if (existing.name != member.name)
+                continue;
+            found = true;
+            if (existing.type != member.type || existing.arraySize != member.arraySize)
+                fail(where, member.name + " is declared as both " + existing.type + " and " + member.type);
+        }
+        if (!found)
+            into.push_back(member);
+    }
+}
+
+void parseShader(const string& path, Program& program, map<string, Block>& blocks)
+{
+    string source;
+    if (!readFile(path, source))
+    {
+        fail(path, "failed to read");
+        return;
+    }
+
+    map<string, int> defines;
+    vector<string> tokens = tokenize(source, defines);
+    int depth = 0;
+    for (size_t i = 0; i < tokens.size();)
+    {
+        const string& token = tokens[i];
+        if (token == "{" || token == "(")
+        {
+            depth++;
+            i++;
+        }
+        else if (token == "}" || token == ")")
+        {
+            depth--;
+            i++;
+        }
+        else if (depth == 0 && token == "struct" && i + 2 < tokens.size() && tokens[i + 2] == "{")
+        {
+            StructType& type = program.structs[tokens[i + 1]];
+            type.name = tokens[i + 1];
+            vector<Member> members;
+            i += 3;
+            parseMembers(tokens, i, defines, members, path);
+            mergeMembers(type.members, members, path);
+            if (i < tokens.size() && tokens[i] == ";")
+                i++;
+        }
+        else if (depth == 0 && token == "layout" && i + 1 < tokens.size() && tokens[i + 1] == "(")
+        {
+            // the qualifiers themselves do not matter; blocks are taken to be std140 (checked below)
+            bool std140 = false;
+            i += 2;
+            while (i < tokens.size() && tokens[i] != ")")
+                std140 |= tokens[i++] == "std140";
+            i++;
+            if (i + 2 < tokens.size() && tokens[i] == "uniform" && tokens[i + 2] == "{" && !std140)
+                fail(path, "uniform block " + tokens[i + 1] + " must be layout(std140)");
+        }
+        else if (depth == 0 && token == "uniform" && i + 2 < tokens.size() && tokens[i + 2] == "{")
+        {
+            Block block;
+            block.name = tokens[i + 1];
+            block.source = path;
+            i += 3;
+            parseMembers(tokens, i, defines, block.members, path);
+            // an instance name, if any, does not change the layout
+            while (i < tokens.size() && tokens[i] != ";")
+                i++;
+            i++;
+
+            auto existing = blocks.find(block.name);
+            if (existing == blocks.end())
+                blocks[block.name] = block;
+            else
+            {
+                bool same = existing->second.members.size() == block.members.size();
+                for (size_t m = 0; same && m < block.members.size(); m++)
+                {
+                    const Member& a = existing->second.members[m];
+                    const Member& b = block.members[m];
+                    same = a.type == b.type && a.name == b.name && a.arraySize == b.arraySize;
+                }
+                if (!same)
+                    fail(path, "uniform block " + block.name + " differs from the one in " + existing->second.source);
+            }
+            bool listed = false;
+            for (const string& name : program.blocks)
+                listed |= name == block.name;
+            if (!listed)
+                program.blocks.push_back(block.name);
+        }
+        else if (depth == 0 && token == "uniform")
+        {
+            vector<Member> members;
+            i++;
+            parseDeclaration(tokens, i, defines, members, path);
+            mergeMembers(program.uniforms, members, path);
+        }
+        else
+            i++;
+    }
+}
+
+// the C++ value type set through a slot, or "" for a GLSL struct or an unsupported type
+string cppType(const string& type)
+{
+    if (type == "float")
+        return "float";
+    if (type == "int" || type == "bool" || type.find("sampler") != string::npos)
+        return "int";   // samplers are set to their texture unit
+    if (type == "vec2" || type == "vec3" || type == "vec4" || type == "mat3" || type == "mat4")
+        return "glm::" + type;
+    return "";
+}
+
+// std140 base alignment and size of one element
+bool std140Layout(const string& type, const map<string, StructType>& structs, size_t& alignment, size_t& size);
+
+size_t roundUp(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// offsets of members laid out std140 from offset 0; returns false on an unknown type
+bool std140Members(const vector<Member>& members, const map<string, StructType>& structs, vector<size_t>& offsets,
+                   vector<size_t>& strides, size_t& size, size_t& maxAlignment)
+{
+    size_t offset = 0;
+    maxAlignment = 16;
+    for (const Member& member : members)
+    {
+        size_t alignment, elementSize;
+        if (!std140Layout(member.type, structs, alignment, elementSize))
+            return false;
+        size_t stride = 0;
+        if (member.arraySize > 0)
+        {
+            // array elements are rounded up to vec4
+            alignment = roundUp(alignment, 16);
+            stride = roundUp(elementSize, 16);
+            elementSize = stride * member.arraySize;
+        }
+        offset = roundUp(offset, alignment);
+        offsets.push_back(offset);
+        strides.push_back(stride);
+        offset += elementSize;
+    }
+    size = offset;
+    return true;
+}
+
+bool std140Layout(const string& type, const map<string, StructType>& structs, size_t& alignment, size_t& size)
+{
+    if (type == "float" || type == "int" || type == "uint" || type == "bool")
+        alignment = size = 4;
+    else if (type == "vec2" || type == "ivec2")
+        alignment = size = 8;
+    else if (type == "vec3" || type == "ivec3")
+    {
+        alignment = 16;
+        size = 12;
+    }
+    else if (type == "vec4" || type == "ivec4")
+        alignment = size = 16;
+    else if (type == "mat3")
+    {
+        // three vec3 columns, each padded to a vec4
+        alignment = 16;
+        size = 48;
+    }
+    else if (type == "mat4")
+    {
+        alignment = 16;
+        size = 64;
+    }
+    else
+    {
+        auto found = structs.find(type);
+        if (found == structs.end())
+            return false;
+        vector<size_t> offsets, strides;
+        size_t maxAlignment;
+        if (!std140Members(found->second.members, structs, offsets, strides, size, maxAlignment))
+            return false;
+        alignment = 16;
+        size = roundUp(size, 16);
+    }
+    return true;
+}
+
+// binding is -1 for a struct used inside a block
+void writeLayout(ostream& out, const string& name, int binding, const vector<Member>& members,
+                 const map<string, StructType>& structs, const string& where)
+{
+    vector<size_t> offsets, strides;
+    size_t size, maxAlignment;
+    if (!std140Members(members, structs, offsets, strides, size, maxAlignment))
+    {
+        fail(where, (binding < 0 ? "struct " : "uniform block ") + name + " has a member of a type with no std140 layout here");
+        return;
+    }
+    out << "struct " << name << "Layout {\n";
+    if (binding >= 0)
+        out << "    static const unsigned int binding = " << binding << ";\n";
+    for (size_t m = 0; m < members.size(); m++)
+    {
+        out << "    static const size_t " << members[m].name << " = " << offsets[m] << ";\n";
+        if (members[m].arraySize > 0)
+            out << "    static const size_t " << members[m].name << "Stride = " << strides[m] << ";\n";
+    }
+    out << "    static const size_t size = " << roundUp(size, 16) << ";\n";
+    out << "};\n\n";
+}
+
+void writeMembers(ostream& out, const vector<Member>& members, const string& indent)
+{
+    for (const Member& member : members)
+    {
+        string type = cppType(member.type);
+        out << indent << (type.empty() ? member.type : "TypedUniform<" + type + ">") << " " << member.name;
+        if (member.arraySize > 0)
+            out << "[" << member.arraySize << "]";
+        out << ";\n";
+    }
+}
+
+void writeBinds(ostream& out, const vector<Member>& members, const map<string, StructType>& structs, const string& indent,
+                const string& prefix)
+{
+    for (const Member& member : members)
+    {
+        bool isStruct = structs.count(member.type) != 0;
+        string name = prefix.empty() ? "\"" + member.name + "\"" : prefix + " + \"" + member.name + "\"";
+        string suffix = isStruct ? " + \".\"" : "";
+        if (member.arraySize > 0)
+        {
+            out << indent << "for (int i = 0; i < " << member.arraySize << "; i++)\n";
+            string element = "std::string(" + name + ") + \"[\" + std::to_string(i) + \"]\"" + suffix;
+            if (isStruct)
+                out << indent << "    " << member.name << "[i].bind(shader, " << element << ");\n";
+            else
+                out << indent << "    " << member.name << "[i] = TypedUniform<" << cppType(member.type) << ">(shader, (" << element
+                    << ").c_str());\n";
+        }
+        else if (isStruct)
+            out << indent << member.name << ".bind(shader, std::string(" << name << ")" << suffix << ");\n";
+        else if (prefix.empty())
+            out << indent << member.name << " = TypedUniform<" << cppType(member.type) << ">(shader, " << name << ");\n";
+        else
+            out << indent << member.name << " = TypedUniform<" << cppType(member.type) << ">(shader, (" << name << ").c_str());\n";
+    }
+}
+
+// structs used by the program's uniforms, those they use first
+void orderStructs(const string& type, const map<string, StructType>& structs, vector<string>& ordered)
+{
+    auto found = structs.find(type);
+    if (found == structs.end())
+        return;
+    for (const string& name : ordered)
+        if (name == type)
+            return;
+    for (const Member& member : found->second.members)
+        orderStructs(member.type, structs, ordered);
+    ordered.push_back(type);
+}
+
+void writeProgram(ostream& out, const Program& program)
+{
+    string where = program.name;
+    for (const Member& uniform : program.uniforms)
+    {
+        vector<string> check;
+        orderStructs(uniform.type, program.structs, check);
+        if (check.empty() && cppType(uniform.type).empty())
+            fail(where, "uniform " + uniform.name + " has unsupported type " + uniform.type);
+    }
+    vector<string> ordered;
+    for (const Member& uniform : program.uniforms)
+        orderStructs(uniform.type, program.structs, ordered);
+
+    out << "// " << program.paths[0];
+    for (size_t p = 1; p < program.paths.size(); p++)
+        out << " + " << program.paths[p];
+    out << "\n";
+    out << "struct " << program.name << "Uniforms {\n";
+    for (const string& name : ordered)
+    {
+        const StructType& type = program.structs.at(name);
+        for (const Member& member : type.members)
+            if (cppType(member.type).empty() && !program.structs.count(member.type))
+                fail(where, name + "." + member.name + " has unsupported type " + member.type);
+        out << "    struct " << name << " {\n";
+        writeMembers(out, type.members, "        ");
+        out << "\n        // prefix is the element's name with its trailing '.'\n";
+        out << "        void bind(const Shader& shader, const std::string& prefix)\n        {\n";
+        writeBinds(out, type.members, program.structs, "            ", "prefix");
+        out << "        }\n    };\n\n";
+    }
+    writeMembers(out, program.uniforms, "    ");
+    out << "\n    " << program.name << "Uniforms()\n    {\n    }\n\n";
+    out << "    explicit " << program.name << "Uniforms(const Shader& shader)\n    {\n        bind(shader);\n    }\n\n";
+    out << "    void bind(const Shader& shader)\n    {\n";
+    writeBinds(out, program.uniforms, program.structs, "        ", "");
+    for (const string& block : program.blocks)
+        out << "        shader.bindUniformBlock(\"" << block << "\", " << block << "Layout::binding);\n";
+    out << "    }\n";
+    out << "};\n\n";
+}
+
+int main(int argc, char** argv)
+{
+    string headerPath = "shaderUniforms.h";
+    vector<string> arguments;
+
+    for (int i = 1; i < argc; i++)
+    {
+        string argument = argv[i];
+        if (argument == "-o" && i + 1 < argc)
+            headerPath = argv[++i];
+        else
+            arguments.push_back(argument);
+    }
+
+    if (arguments.empty())
+    {
+        arguments = { "FlatColor", "vertexShader.vs", "fragmentShader.fs",
+                      "TexturedPhong", "vertexShaderForPhongShadingWithTexture.vs", "fragmentShaderForPhongShadingWithTexture.fs" };
+    }
+    if (arguments.size() % 3 != 0)
+    {
+        cout << "usage: ShaderReflect [-o header] [Name vertexShader fragmentShader ...]" << endl;
+        return 1;
+    }
+
+    vector<Program> programs;
+    map<string, Block> blocks;
+    for (size_t i = 0; i < arguments.size(); i += 3)
+    {
+        Program program;
+        program.name = arguments[i];
+        program.paths = { arguments[i + 1], arguments[i + 2] };
+        for (const string& path : program.paths)
+            parseShader(path, program, blocks);
+        programs.push_back(program);
+    }
+
+    ostringstream out;
+    out << "//\n//  " << headerPath << "\n//  test\n//\n";
+    out << "//  Generated by ShaderReflect from the shaders; do not edit.\n//\n\n";
+    out << "#ifndef shaderUniforms_h\n#define shaderUniforms_h\n\n";
+    out << "#include <glm/glm.hpp>\n\n#include <cstddef>\n#include <string>\n\n#include \"shader.h\"\n#include \"typedUniform.h\"\n\n";
+    map<string, StructType> structs;
+    for (const Program& program : programs)
+        structs.insert(program.structs.begin(), program.structs.end());
+    // the structs blocks hold get offsets of their own, for filling in an array element
+    vector<string> blockStructs;
+    for (const auto& block : blocks)
+        for (const Member& member : block.second.members)
+            orderStructs(member.type, structs, blockStructs);
+    for (const string& name : blockStructs)
+        writeLayout(out, name, -1, structs.at(name).members, structs, name);
+    // every program gets the same binding point for a block, so one glBindBufferRange serves them all
+    int binding = 0;
+    for (const auto& block : blocks)
+        writeLayout(out, block.first, binding++, block.second.members, structs, block.second.source);
+    for (const Program& program : programs)
+        writeProgram(out, program);
+    out << "#endif /* shaderUniforms_h */\n";
+
+    if (errors > 0)
+    {
+        cout << headerPath << " not written: " << errors << " error(s)" << endl;
+        return 1;
+    }
+
+    // left alone when nothing changed, so the game is not rebuilt for nothing
+    string existing;
+    if (readFile(headerPath, existing) && existing == out.str())
+    {
+        cout << headerPath << " is up to date" << endl;
+        return 0;
+    }
+    ofstream header(headerPath, ios::binary);
+    header << out.str();
+    if (!header)
+    {
+        cout << headerPath << ": failed to write" << endl;
+        return 1;
+    }
+    cout << "Wrote " << programs.size() << " programs and " << blocks.size() << " uniform blocks to " << headerPath << endl;
+    return 0;
+}
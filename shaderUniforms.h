@@ -0,0 +1,134 @@
+//
+//  shaderUniforms.h
+//  test
+//
+//  Generated by ShaderReflect from the shaders; do not edit.
+//
+
+#ifndef shaderUniforms_h
+#define shaderUniforms_h
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <string>
+
+#include "shader.h"
+#include "typedUniform.h"
+
+struct PointLightLayout {
+    static const size_t position = 0;
+    static const size_t k_c = 12;
+    static const size_t ambient = 16;
+    static const size_t k_l = 28;
+    static const size_t diffuse = 32;
+    static const size_t k_q = 44;
+    static const size_t specular = 48;
+    static const size_t cutoff = 60;
+    static const size_t size = 64;
+};
+
+struct CameraBlockLayout {
+    static const unsigned int binding = 0;
+    static const size_t projection = 0;
+    static const size_t view = 64;
+    static const size_t viewPos = 128;
+    static const size_t size = 144;
+};
+
+struct LightBlockLayout {
+    static const unsigned int binding = 1;
+    static const size_t pointLightCount = 0;
+    static const size_t pointLights = 16;
+    static const size_t pointLightsStride = 64;
+    static const size_t size = 16336;
+};
+
+// vertexShader.vs + fragmentShader.fs
+struct FlatColorUniforms {
+    TypedUniform<glm::mat4> model;
+    TypedUniform<glm::vec3> color;
+
+    FlatColorUniforms()
+    {
+    }
+
+    explicit FlatColorUniforms(const Shader& shader)
+    {
+        bind(shader);
+    }
+
+    void bind(const Shader& shader)
+    {
+        model = TypedUniform<glm::mat4>(shader, "model");
+        color = TypedUniform<glm::vec3>(shader, "color");
+        shader.bindUniformBlock("CameraBlock", CameraBlockLayout::binding);
+    }
+};
+
+// vertexShaderForPhongShadingWithTexture.vs + fragmentShaderForPhongShadingWithTexture.fs
+struct TexturedPhongUniforms {
+    struct Material {
+        TypedUniform<int> diffuseLayer;
+        TypedUniform<int> specularLayer;
+        TypedUniform<int> diffuse;
+        TypedUniform<int> specular;
+        TypedUniform<float> shininess;
+
+        // prefix is the element's name with its trailing '.'
+        void bind(const Shader& shader, const std::string& prefix)
+        {
+            diffuseLayer = TypedUniform<int>(shader, (prefix + "diffuseLayer").c_str());
+            specularLayer = TypedUniform<int>(shader, (prefix + "specularLayer").c_str());
+            diffuse = TypedUniform<int>(shader, (prefix + "diffuse").c_str());
+            specular = TypedUniform<int>(shader, (prefix + "specular").c_str());
+            shininess = TypedUniform<float>(shader, (prefix + "shininess").c_str());
+        }
+    };
+
+    TypedUniform<int> boxRecords;
+    TypedUniform<int> boxOffset;
+    TypedUniform<glm::mat4> model;
+    TypedUniform<glm::mat3> normalMatrix;
+    TypedUniform<glm::vec4> uvRect;
+    Material material;
+    TypedUniform<int> materialMaps;
+    TypedUniform<int> clusterRecords;
+    TypedUniform<int> clusterLightIndices;
+    TypedUniform<glm::vec2> clusterTileSize;
+    TypedUniform<glm::vec2> clusterDepthScaleBias;
+    TypedUniform<int> clusterColumns;
+    TypedUniform<int> clusterRows;
+    TypedUniform<int> clusterSlices;
+
+    TexturedPhongUniforms()
+    {
+    }
+
+    explicit TexturedPhongUniforms(const Shader& shader)
+    {
+        bind(shader);
+    }
+
+    void bind(const Shader& shader)
+    {
+        boxRecords = TypedUniform<int>(shader, "boxRecords");
+        boxOffset = TypedUniform<int>(shader, "boxOffset");
+        model = TypedUniform<glm::mat4>(shader, "model");
+        normalMatrix = TypedUniform<glm::mat3>(shader, "normalMatrix");
+        uvRect = TypedUniform<glm::vec4>(shader, "uvRect");
+        material.bind(shader, std::string("material") + ".");
+        materialMaps = TypedUniform<int>(shader, "materialMaps");
+        clusterRecords = TypedUniform<int>(shader, "clusterRecords");
+        clusterLightIndices = TypedUniform<int>(shader, "clusterLightIndices");
+        clusterTileSize = TypedUniform<glm::vec2>(shader, "clusterTileSize");
+        clusterDepthScaleBias = TypedUniform<glm::vec2>(shader, "clusterDepthScaleBias");
+        clusterColumns = TypedUniform<int>(shader, "clusterColumns");
+        clusterRows = TypedUniform<int>(shader, "clusterRows");
+        clusterSlices = TypedUniform<int>(shader, "clusterSlices");
+        shader.bindUniformBlock("CameraBlock", CameraBlockLayout::binding);
+        shader.bindUniformBlock("LightBlock", LightBlockLayout::binding);
+    }
+};
+
+#endif /* shaderUniforms_h */
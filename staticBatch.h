@@ -0,0 +1,314 @@
+//
+//  staticBatch.h
+//  test
+//
+//  Boxes that never move, baked once into world-space vertices in one merged
+//  buffer and drawn with one glDrawElements per material.
+//
+
+#ifndef staticBatch_h
+#define staticBatch_h
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <vector>
+
+#include "boxFaceCuller.h"
+#include "cube.h"
+#include "cubeMesh.h"
+#include "meshArena.h"
+#include "shader.h"
+#include "shaderUniforms.h"
+
+// build() transforms every added box's copy of the cube mesh on the CPU (its
+// UV rectangle applied to the texture coordinates), sorts the boxes by
+// material and stores them as one mesh in the shared MeshArena, with the
+// same vertex layout as CubeMesh. Each material is then a contiguous index range: drawing sets that
+// material's textures or layers and shininess and issues one glDrawElements,
+// with no per-box matrices or uniforms.
+//
+// With removeHiddenFaces, BoxFaceCuller first drops the face parts buried
+// in or pressed against other boxes; the remaining pieces keep the texture
+// coordinates they had on the whole face.
+//
+// The merged buffer uses vertexFormat (see PackedMesh); in the compact
+// format the position decode is folded into the model matrix at draw time.
+// With positionStream the positions are also stored on their own:
+// drawPositions() renders the whole batch from them in a single draw, since
+// depth-only passes do not care about materials.
+//
+// The result is drawn with the regular (not INSTANCED) path of the texture
+// shader; the scene model matrix passed to draw() still applies on top, so
+// the house can be moved as a whole. A batch owns its arena ranges, so it
+// can be moved but not copied.
+class StaticBatch {
+public:
+    // read by build()
+    VertexFormat vertexFormat = VERTEX_FORMAT_FLOAT;
+    bool positionStream = false;
+
+    void add(const glm::mat4& transform, const Cube& cube)
+    {
+        pendingBoxes.push_back(PendingBox{ transform, &cube });
+    }
+
+    size_t size() const
+    {
+        return pendingBoxes.size();
+    }
+
+    size_t materialCount() const
+    {
+        return ranges.size();
+    }
+
+    size_t vertexBytes() const
+    {
+        return bakedVertexBytes;
+    }
+
+    // 0 without positionStream
+    size_t positionBytes() const
+    {
+        return bakedPositionBytes;
+    }
+
+    // what the last build(true) removed
+    const BoxFaceCuller::Statistics& faceStatistics() const
+    {
+        return statistics;
+    }
+
+    // bakes the boxes added so far; the Cubes are only read here
+    void build(bool removeHiddenFaces = false)
+    {
+        MeshArena::shared().remove(mesh);
+        ranges.clear();
+        statistics = BoxFaceCuller::Statistics();
+        bakedVertexBytes = 0;
+        if (pendingBoxes.empty())
+            return;
+
+        std::vector<PendingBox> sorted = pendingBoxes;
+        std::stable_sort(sorted.begin(), sorted.end(), [](const PendingBox& a, const PendingBox& b) {
+            return materialOf(*a.cube) < materialOf(*b.cube);
+        });
+
+        std::vector<BoxFaceCuller::Piece> pieces;
+        if (removeHiddenFaces)
+        {
+            std::vector<glm::mat4> transforms;
+            for (const PendingBox& box : sorted)
+                transforms.push_back(box.transform);
+            pieces = BoxFaceCuller::cull(transforms, statistics);
+        }
+
+        std::vector<float> vertices;
+        std::vector<unsigned int> indices;
+        vertices.reserve(sorted.size() * CubeMesh::vertexCount * CubeMesh::floatsPerVertex);
+        indices.reserve(sorted.size() * CubeMesh::indexCount);
+        size_t nextPiece = 0;
+        for (size_t i = 0; i < sorted.size(); i++)
+        {
+            const PendingBox& box = sorted[i];
+            Material material = materialOf(*box.cube);
+            if (ranges.empty() || ranges.back().material < material || material < ranges.back().material)
+                ranges.push_back(Range{ material, (GLsizei)indices.size(), 0 });
+
+            size_t firstIndex = indices.size();
+            if (removeHiddenFaces)
+            {
+                // the pieces come in box order
+                for (; nextPiece < pieces.size() && pieces[nextPiece].box == (int)i; nextPiece++)
+                    appendPiece(box, pieces[nextPiece], vertices, indices);
+            }
+            else
+                appendBox(box, vertices, indices);
+            ranges.back().count += (GLsizei)(indices.size() - firstIndex);
+        }
+        PackedMesh packed = PackedMesh::pack(vertexFormat, vertices.data(), vertices.size() / CubeMesh::floatsPerVertex, indices.data(), indices.size(),
+                                             positionStream);
+        bakedVertexBytes = packed.vertices.size();
+        bakedPositionBytes = packed.positions.size();
+        positionDecode = packed.positionDecode;
+        indexCount = (GLsizei)indices.size();
+        if (!MeshArena::shared().add(packed, mesh))
+            ranges.clear();
+    }
+
+    // the shader must be in use, with uniforms bound to it; model is the scene's model matrix
+    void draw(const Shader& shader, const TexturedPhongUniforms& uniforms, const glm::mat4& model) const
+    {
+        if (ranges.empty())
+            return;
+
+        uniforms.model.set(shader, model * positionDecode);
+        // the UV rectangles are already baked into the vertices
+        uniforms.uvRect.set(shader, glm::vec4(0.0f, 0.0f, 1.0f, 1.0f));
+        MeshArena::shared().bind(mesh);
+        for (const Range& range : ranges)
+        {
+            const Material& material = range.material;
+            if (material.diffuseLayer >= 0)
+            {
+                uniforms.material.diffuseLayer.set(shader, material.diffuseLayer);
+                if (material.specularLayer >= 0)
+                    uniforms.material.specularLayer.set(shader, material.specularLayer);
+            }
+            else
+            {
+                uniforms.material.diffuse.set(shader, 0);
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, material.diffuseMap);
+                if (material.specularMap)
+                {
+                    uniforms.material.specular.set(shader, 1);
+                    glActiveTexture(GL_TEXTURE1);
+                    glBindTexture(GL_TEXTURE_2D, material.specularMap);
+                }
+            }
+            uniforms.material.shininess.set(shader, material.shininess);
+
+            glDrawElementsBaseVertex(GL_TRIANGLES, range.count, mesh.indexType, (void*)mesh.indexOffset(range.first), mesh.baseVertex);
+        }
+    }
+
+    // every box in one draw for a shader that reads only the position, e.g. a depth prepass;
+    // the interleaved vertices are used when there is no position stream
+    void drawPositions(const Shader& shader, const FlatColorUniforms& uniforms, const glm::mat4& model) const
+    {
+        if (ranges.empty())
+            return;
+
+        uniforms.model.set(shader, model * positionDecode);
+        MeshArena::shared().bindPositions(mesh);
+        glDrawElementsBaseVertex(GL_TRIANGLES, indexCount, mesh.indexType, (void*)mesh.indexOffset(), mesh.positionBaseVertex);
+    }
+
+    void clear()
+    {
+        pendingBoxes.clear();
+        ranges.clear();
+    }
+
+    // call before MeshArena's release()
+    void release()
+    {
+        ranges.clear();
+        MeshArena::shared().remove(mesh);
+    }
+
+private:
+    // everything drawCubeWithTexture sets per cube, apart from the model matrix and UV rectangle
+    struct Material {
+        unsigned int diffuseMap;
+        unsigned int specularMap;
+        int diffuseLayer;
+        int specularLayer;
+        float shininess;
+
+        bool operator<(const Material& other) const
+        {
+            if (diffuseMap != other.diffuseMap)
+                return diffuseMap < other.diffuseMap;
+            if (specularMap != other.specularMap)
+                return specularMap < other.specularMap;
+            if (diffuseLayer != other.diffuseLayer)
+                return diffuseLayer < other.diffuseLayer;
+            if (specularLayer != other.specularLayer)
+                return specularLayer < other.specularLayer;
+            return shininess < other.shininess;
+        }
+    };
+
+    struct PendingBox {
+        glm::mat4 transform;
+        const Cube* cube;
+    };
+
+    struct Range {
+        Material material;
+        GLsizei first;
+        GLsizei count;
+    };
+
+    std::vector<PendingBox> pendingBoxes;
+    std::vector<Range> ranges;
+    BoxFaceCuller::Statistics statistics;
+    size_t bakedVertexBytes = 0;
+    size_t bakedPositionBytes = 0;
+    glm::mat4 positionDecode = glm::mat4(1.0f);
+    GLsizei indexCount = 0;
+    MeshArena::Mesh mesh;
+
+    static Material materialOf(const Cube& cube)
+    {
+        // with layers the texture handles are not bound, so they do not split materials
+        bool layered = cube.diffuseLayer >= 0;
+        return Material{ layered ? 0u : cube.diffuseMap, layered ? 0u : cube.specularMap, cube.diffuseLayer, cube.specularLayer, cube.shininess };
+    }
+
+    static void appendBox(const PendingBox& box, std::vector<float>& vertices, std::vector<unsigned int>& indices)
+    {
+        glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(box.transform)));
+        glm::vec2 uvMin(box.cube->TXmin, box.cube->TYmin);
+        glm::vec2 uvMax(box.cube->TXmax, box.cube->TYmax);
+
+        unsigned int firstVertex = (unsigned int)(vertices.size() / CubeMesh::floatsPerVertex);
+        const float* vertex = CubeMesh::vertices();
+        for (int i = 0; i < CubeMesh::vertexCount; i++, vertex += CubeMesh::floatsPerVertex)
+        {
+            glm::vec3 position = glm::vec3(box.transform * glm::vec4(vertex[0], vertex[1], vertex[2], 1.0f));
+            glm::vec3 normal = glm::normalize(normalMatrix * glm::vec3(vertex[3], vertex[4], vertex[5]));
+            glm::vec2 uv = glm::mix(uvMin, uvMax, glm::vec2(vertex[6], vertex[7]));
+            appendVertex(position, normal, uv, vertices);
+        }
+
+        const unsigned int* cubeIndices = CubeMesh::indices();
+        for (int i = 0; i < CubeMesh::indexCount; i++)
+            indices.push_back(firstVertex + cubeIndices[i]);
+    }
+
+    // a piece of one of the mesh's faces; its texture coordinates are interpolated from the face's corners
+    static void appendPiece(const PendingBox& box, const BoxFaceCuller::Piece& piece, std::vector<float>& vertices, std::vector<unsigned int>& indices)
+    {
+        glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(box.transform)));
+        glm::vec2 uvMin(box.cube->TXmin, box.cube->TYmin);
+        glm::vec2 uvMax(box.cube->TXmax, box.cube->TYmax);
+
+        const float* faceVertices = CubeMesh::vertices() + piece.face * 4 * CubeMesh::floatsPerVertex;
+        glm::vec3 localNormal(faceVertices[3], faceVertices[4], faceVertices[5]);
+        glm::vec3 normal = glm::normalize(normalMatrix * localNormal);
+        int axis = localNormal.x != 0.0f ? 0 : (localNormal.y != 0.0f ? 1 : 2);
+        int u = (axis + 1) % 3, v = (axis + 2) % 3;
+
+        unsigned int firstVertex = (unsigned int)(vertices.size() / CubeMesh::floatsPerVertex);
+        for (const glm::vec3& corner : piece.corners)
+        {
+            // bilinear over the face's four corners, which sit at 0 or 1 along u and v
+            glm::vec2 meshUV(0.0f);
+            const float* vertex = faceVertices;
+            for (int i = 0; i < 4; i++, vertex += CubeMesh::floatsPerVertex)
+            {
+                float weight = (vertex[u] > 0.5f ? corner[u] : 1.0f - corner[u]) * (vertex[v] > 0.5f ? corner[v] : 1.0f - corner[v]);
+                meshUV += weight * glm::vec2(vertex[6], vertex[7]);
+            }
+            glm::vec3 position = glm::vec3(box.transform * glm::vec4(corner, 1.0f));
+            appendVertex(position, normal, glm::mix(uvMin, uvMax, meshUV), vertices);
+        }
+
+        const unsigned int quad[6] = { 0, 1, 2, 2, 3, 0 };
+        for (unsigned int index : quad)
+            indices.push_back(firstVertex + index);
+    }
+
+    static void appendVertex(const glm::vec3& position, const glm::vec3& normal, const glm::vec2& uv, std::vector<float>& vertices)
+    {
+        float baked[CubeMesh::floatsPerVertex] = { position.x, position.y, position.z, normal.x, normal.y, normal.z, uv.x, uv.y };
+        vertices.insert(vertices.end(), baked, baked + CubeMesh::floatsPerVertex);
+    }
+};
+
+#endif /* staticBatch_h */
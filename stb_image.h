@@ -307,8 +307,12 @@ publish, and distribute this file as you see fit.
 // code.)
 //
 // On x86, SSE2 will automatically be used when available based on a run-time
-// test; if not, the generic C versions are used as a fall-back. On ARM targets,
-// the typical path is to have separate builds for NEON and non-NEON devices
+// test; if not, the generic C versions are used as a fall-back. AVX2 versions
+// of the IDCT, the 2x chroma upsamplers and the YCbCr conversion are compiled
+// alongside (without needing -mavx2 for the whole file) and picked by the same
+// kind of run-time test; define STBI_NO_AVX2 to leave them out. The PNG
+// decoder uses SSE2 for the row filters of 8-bit RGB and RGBA images.
+// On ARM targets, the typical path is to have separate builds for NEON and non-NEON devices
 // (at least this is true for iOS and Android). Therefore, the NEON support is
 // toggled by a build flag: define STBI_NEON to get NEON loops.
 //
@@ -510,6 +514,22 @@ extern "C" {
     // flip the image vertically, so the first pixel in the output array is the bottom left
     STBIDEF void stbi_set_flip_vertically_on_load(int flag_true_if_should_flip);
 
+    // decode JPEGs at 1/(1 << scale_shift) of their size, scale_shift 0-3, by
+    // running a reduced IDCT per block; x and y receive the reduced size
+    // (rounded up). at 1/8 only the DC terms are used, so the AC scans of a
+    // progressive JPEG are skipped without being decoded. other formats load
+    // at full size.
+    STBIDEF stbi_uc* stbi_load_from_memory_scaled(stbi_uc const* buffer, int len, int* x, int* y, int* channels_in_file, int desired_channels, int scale_shift);
+#ifndef STBI_NO_STDIO
+    STBIDEF stbi_uc* stbi_load_scaled(char const* filename, int* x, int* y, int* channels_in_file, int desired_channels, int scale_shift);
+#endif
+    STBIDEF int      stbi_info_from_memory_scaled(stbi_uc const* buffer, int len, int* x, int* y, int* comp, int scale_shift);
+
+    // cap the SIMD kernels the JPEG and PNG decoders may pick: 0 = generic C,
+    // 1 = SSE2/NEON, 2 = AVX2 (default; each level is still only used if the CPU
+    // supports it). meant for benchmarking and testing; don't change it while decoding.
+    STBIDEF void stbi_set_simd_level(int max_level);
+
     // ZLIB client - used by PNG, available for other purposes
 
     STBIDEF char* stbi_zlib_decode_malloc_guesssize(const char* buffer, int len, int initial_size, int* outlen);
@@ -606,12 +626,14 @@ typedef unsigned short stbi__uint16;
 typedef   signed short stbi__int16;
 typedef unsigned int   stbi__uint32;
 typedef   signed int   stbi__int32;
+typedef unsigned __int64 stbi__uint64;
 #else
 #include <stdint.h>
 typedef uint16_t stbi__uint16;
 typedef int16_t  stbi__int16;
 typedef uint32_t stbi__uint32;
 typedef int32_t  stbi__int32;
+typedef uint64_t stbi__uint64;
 #endif
 
 // should produce compiler error if size is wrong
@@ -733,6 +755,42 @@ static int stbi__sse2_available()
 #endif
 #endif
 
+// AVX2 kernels are only built next to the SSE2 ones. Each AVX2 function is
+// compiled for AVX2 on its own (STBI__AVX2_TARGET), so callers must check
+// stbi__avx2_available() first.
+#if defined(STBI_SSE2) && !defined(STBI_NO_AVX2)
+#if defined(_MSC_VER) && _MSC_VER >= 1700 // VS2012 added the AVX2 intrinsics
+#define STBI_AVX2
+#define STBI__AVX2_TARGET
+#elif defined(__clang__) || (defined(__GNUC__) && (__GNUC__ * 100 + __GNUC_MINOR__) >= 409)
+#define STBI_AVX2
+#define STBI__AVX2_TARGET __attribute__((target("avx2")))
+#endif
+#endif
+
+#ifdef STBI_AVX2
+#include <immintrin.h>
+
+#ifdef _MSC_VER
+static int stbi__avx2_available()
+{
+    int info[4];
+    __cpuid(info, 1);
+    // the OS has to save the YMM registers (OSXSAVE, then XCR0 bits 1 and 2)
+    if (((info[2] >> 27) & 1) == 0 || (_xgetbv(0) & 6) != 6)
+        return 0;
+    __cpuidex(info, 7, 0);
+    return ((info[1] >> 5) & 1) != 0;
+}
+#else
+static int stbi__avx2_available()
+{
+    // also checks the OS saves the YMM registers
+    return __builtin_cpu_supports("avx2");
+}
+#endif
+#endif
+
 // ARM NEON
 #if defined(STBI_NO_SIMD) && defined(STBI_NEON)
 #undef STBI_NEON
@@ -768,6 +826,8 @@ typedef struct
 
     stbi_uc* img_buffer, * img_buffer_end;
     stbi_uc* img_buffer_original, * img_buffer_original_end;
+
+    int jpeg_scale_shift; // see stbi_load_from_memory_scaled
 } stbi__context;
 
 
@@ -778,6 +838,7 @@ static void stbi__start_mem(stbi__context* s, stbi_uc const* buffer, int len)
 {
     s->io.read = NULL;
     s->read_from_callbacks = 0;
+    s->jpeg_scale_shift = 0;
     s->img_buffer = s->img_buffer_original = (stbi_uc*)buffer;
     s->img_buffer_end = s->img_buffer_original_end = (stbi_uc*)buffer + len;
 }
@@ -789,6 +850,7 @@ static void stbi__start_callbacks(stbi__context* s, stbi_io_callbacks* c, void*
     s->io_user_data = user;
     s->buflen = sizeof(s->buffer_start);
     s->read_from_callbacks = 1;
+    s->jpeg_scale_shift = 0;
     s->img_buffer_original = s->buffer_start;
     stbi__refill_buffer(s);
     s->img_buffer_original_end = s->img_buffer_end;
@@ -1028,6 +1090,13 @@ STBIDEF void stbi_set_flip_vertically_on_load(int flag_true_if_should_flip)
     stbi__vertically_flip_on_load = flag_true_if_should_flip;
 }
 
+static int stbi__simd_level = 2;
+
+STBIDEF void stbi_set_simd_level(int max_level)
+{
+    stbi__simd_level = max_level;
+}
+
 static void* stbi__load_main(stbi__context* s, int* x, int* y, int* comp, int req_comp, stbi__result_info* ri, int bpc)
 {
     memset(ri, 0, sizeof(*ri)); // make sure it's initialized if we add new fields
@@ -1274,6 +1343,31 @@ STBIDEF stbi_uc* stbi_load_from_memory(stbi_uc const* buffer, int len, int* x, i
     return stbi__load_and_postprocess_8bit(&s, x, y, comp, req_comp);
 }
 
+STBIDEF stbi_uc* stbi_load_from_memory_scaled(stbi_uc const* buffer, int len, int* x, int* y, int* comp, int req_comp, int scale_shift)
+{
+    stbi__context s;
+    if (scale_shift < 0 || scale_shift > 3) return stbi__errpuc("bad scale", "Internal error");
+    stbi__start_mem(&s, buffer, len);
+    s.jpeg_scale_shift = scale_shift;
+    return stbi__load_and_postprocess_8bit(&s, x, y, comp, req_comp);
+}
+
+#ifndef STBI_NO_STDIO
+STBIDEF stbi_uc* stbi_load_scaled(char const* filename, int* x, int* y, int* comp, int req_comp, int scale_shift)
+{
+    FILE* f = stbi__fopen(filename, "rb");
+    unsigned char* result;
+    stbi__context s;
+    if (!f) return stbi__errpuc("can't fopen", "Unable to open file");
+    if (scale_shift < 0 || scale_shift > 3) { fclose(f); return stbi__errpuc("bad scale", "Internal error"); }
+    stbi__start_file(&s, f);
+    s.jpeg_scale_shift = scale_shift;
+    result = stbi__load_and_postprocess_8bit(&s, x, y, comp, req_comp);
+    fclose(f);
+    return result;
+}
+#endif
+
 STBIDEF stbi_uc* stbi_load_from_callbacks(stbi_io_callbacks const* clbk, void* user, int* x, int* y, int* comp, int req_comp)
 {
     stbi__context s;
@@ -1708,7 +1802,7 @@ static stbi_uc* stbi__hdr_to_ldr(float* data, int x, int y, int comp)
 //      - quality integer IDCT derived from IJG's 'slow'
 //    performance
 //      - fast huffman; reasonable integer IDCT
-//      - some SIMD kernels for common paths on targets with SSE2/NEON
+//      - some SIMD kernels for common paths on targets with SSE2/AVX2/NEON
 //      - uses a lot of intermediate memory, could cache poorly
 
 #ifndef STBI_NO_JPEG
@@ -1773,10 +1867,15 @@ typedef struct
     int scan_n, order[4];
     int restart_interval, todo;
 
+    int scale_shift;  // decoding at 1 / (1 << scale_shift) of the size
+    int block_size;   // 8 >> scale_shift, the side of a decoded block
+
     // kernels
     void(*idct_block_kernel)(stbi_uc* out, int out_stride, short data[64]);
+    void(*idct_block2_kernel)(stbi_uc* out, int out_stride, short data[128]); // two horizontally adjacent blocks, or NULL
     void(*YCbCr_to_RGB_kernel)(stbi_uc* out, const stbi_uc* y, const stbi_uc* pcb, const stbi_uc* pcr, int count, int step);
     stbi_uc* (*resample_row_hv_2_kernel)(stbi_uc* out, stbi_uc* in_near, stbi_uc* in_far, int w, int hs);
+    stbi_uc* (*resample_row_h_2_kernel)(stbi_uc* out, stbi_uc* in_near, stbi_uc* in_far, int w, int hs);
 } stbi__jpeg;
 
 static int stbi__build_huffman(stbi__huffman* h, int* count)
@@ -2297,6 +2396,76 @@ static void stbi__idct_block(stbi_uc* out, int out_stride, short data[64])
     }
 }
 
+// reduced-size IDCTs for decoding at 1/2, 1/4 and 1/8 scale. each output
+// sample is the average of the 2x2, 4x4 or 8x8 full-size samples it covers,
+// which comes down to one 8-tap row per output in each direction. only the
+// first half of the rows is stored: the second half is the same with the
+// odd taps negated.
+static const int stbi__idct_rows_4[2][8] = {
+    { stbi__f2f(0.353553391f), stbi__f2f(0.453063723f), stbi__f2f(0.326640741f), stbi__f2f(0.159094823f),
+      0, stbi__f2f(-0.106303762f), stbi__f2f(-0.135299025f), stbi__f2f(-0.090119978f) },
+    { stbi__f2f(0.353553391f), stbi__f2f(0.187665139f), stbi__f2f(-0.326640741f), stbi__f2f(-0.384088878f),
+      0, stbi__f2f(0.256639984f), stbi__f2f(0.135299025f), stbi__f2f(-0.037328917f) },
+};
+
+static const int stbi__idct_rows_2[1][8] = {
+    { stbi__f2f(0.353553391f), stbi__f2f(0.320364431f), 0, stbi__f2f(-0.112497028f),
+      0, stbi__f2f(0.075168111f), 0, stbi__f2f(-0.063724447f) },
+};
+
+stbi_inline static void stbi__idct_scaled(stbi_uc* out, int out_stride, short data[64], const int(*rows)[8], int n)
+{
+    int i, j, u, tmp[4 * 8];
+
+    // columns: 8 coefficients down to n samples, keeping 3 extra bits
+    for (i = 0; i < 8; ++i) {
+        if (data[8 + i] == 0 && data[16 + i] == 0 && data[24 + i] == 0 && data[32 + i] == 0 &&
+            data[40 + i] == 0 && data[48 + i] == 0 && data[56 + i] == 0) {
+            // flat column, as most are: every sample is just the scaled DC
+            int dc = (rows[0][0] * data[i] + 256) >> 9;
+            for (j = 0; j < n; ++j)
+                tmp[j * 8 + i] = dc;
+            continue;
+        }
+        for (j = 0; j < n / 2; ++j) {
+            int even = 0, odd = 0;
+            for (u = 0; u < 8; u += 2) even += rows[j][u] * data[u * 8 + i];
+            for (u = 1; u < 8; u += 2) odd += rows[j][u] * data[u * 8 + i];
+            tmp[j * 8 + i] = (even + odd + 256) >> 9;
+            tmp[(n - 1 - j) * 8 + i] = (even - odd + 256) >> 9;
+        }
+    }
+
+    // rows, then undo the scaling and the level shift
+    for (j = 0; j < n; ++j, out += out_stride) {
+        const int* t = tmp + j * 8;
+        for (i = 0; i < n / 2; ++i) {
+            int even = 0, odd = 0;
+            for (u = 0; u < 8; u += 2) even += rows[i][u] * t[u];
+            for (u = 1; u < 8; u += 2) odd += rows[i][u] * t[u];
+            out[i] = stbi__clamp(((even + odd + (1 << 14)) >> 15) + 128);
+            out[n - 1 - i] = stbi__clamp(((even - odd + (1 << 14)) >> 15) + 128);
+        }
+    }
+}
+
+static void stbi__idct_block_4x4(stbi_uc* out, int out_stride, short data[64])
+{
+    stbi__idct_scaled(out, out_stride, data, stbi__idct_rows_4, 4);
+}
+
+static void stbi__idct_block_2x2(stbi_uc* out, int out_stride, short data[64])
+{
+    stbi__idct_scaled(out, out_stride, data, stbi__idct_rows_2, 2);
+}
+
+static void stbi__idct_block_1x1(stbi_uc* out, int out_stride, short data[64])
+{
+    // the average of the whole block is the DC term / 8
+    STBI_NOTUSED(out_stride);
+    out[0] = stbi__clamp(((data[0] + 4) >> 3) + 128);
+}
+
 #ifdef STBI_SSE2
 // sse2 integer IDCT. not the fastest possible implementation but it
 // produces bit-identical results to the generic C version so it's
@@ -2478,6 +2647,203 @@ static void stbi__idct_simd(stbi_uc* out, int out_stride, short data[64])
 
 #endif // STBI_SSE2
 
+#ifdef STBI_AVX2
+// avx2 version of the sse2 IDCT above that transforms two blocks at once,
+// one per 128-bit lane. every AVX2 op used here works on the two lanes
+// independently, so each block goes through exactly the same arithmetic as
+// in stbi__idct_simd and the results stay bit-identical.
+//
+// data holds the two blocks back to back; the second block is written to
+// out + 8, i.e. the blocks must be horizontally adjacent in the output.
+static STBI__AVX2_TARGET void stbi__idct_avx2(stbi_uc* out, int out_stride, short data[128])
+{
+    __m256i row0, row1, row2, row3, row4, row5, row6, row7;
+    __m256i tmp;
+
+    // dot product constant: even elems=x, odd elems=y
+#define dct_const(x,y)  _mm256_setr_epi16((x),(y),(x),(y),(x),(y),(x),(y),(x),(y),(x),(y),(x),(y),(x),(y))
+
+    // out(0) = c0[even]*x + c0[odd]*y   (c0, x, y 16-bit, out 32-bit)
+    // out(1) = c1[even]*x + c1[odd]*y
+#define dct_rot(out0,out1, x,y,c0,c1) \
+      __m256i c0##lo = _mm256_unpacklo_epi16((x),(y)); \
+      __m256i c0##hi = _mm256_unpackhi_epi16((x),(y)); \
+      __m256i out0##_l = _mm256_madd_epi16(c0##lo, c0); \
+      __m256i out0##_h = _mm256_madd_epi16(c0##hi, c0); \
+      __m256i out1##_l = _mm256_madd_epi16(c0##lo, c1); \
+      __m256i out1##_h = _mm256_madd_epi16(c0##hi, c1)
+
+    // out = in << 12  (in 16-bit, out 32-bit)
+#define dct_widen(out, in) \
+      __m256i out##_l = _mm256_srai_epi32(_mm256_unpacklo_epi16(_mm256_setzero_si256(), (in)), 4); \
+      __m256i out##_h = _mm256_srai_epi32(_mm256_unpackhi_epi16(_mm256_setzero_si256(), (in)), 4)
+
+    // wide add
+#define dct_wadd(out, a, b) \
+      __m256i out##_l = _mm256_add_epi32(a##_l, b##_l); \
+      __m256i out##_h = _mm256_add_epi32(a##_h, b##_h)
+
+    // wide sub
+#define dct_wsub(out, a, b) \
+      __m256i out##_l = _mm256_sub_epi32(a##_l, b##_l); \
+      __m256i out##_h = _mm256_sub_epi32(a##_h, b##_h)
+
+    // butterfly a/b, add bias, then shift by "s" and pack
+#define dct_bfly32o(out0, out1, a,b,bias,s) \
+      { \
+         __m256i abiased_l = _mm256_add_epi32(a##_l, bias); \
+         __m256i abiased_h = _mm256_add_epi32(a##_h, bias); \
+         dct_wadd(sum, abiased, b); \
+         dct_wsub(dif, abiased, b); \
+         out0 = _mm256_packs_epi32(_mm256_srai_epi32(sum_l, s), _mm256_srai_epi32(sum_h, s)); \
+         out1 = _mm256_packs_epi32(_mm256_srai_epi32(dif_l, s), _mm256_srai_epi32(dif_h, s)); \
+      }
+
+    // 8-bit interleave step (for transposes)
+#define dct_interleave8(a, b) \
+      tmp = a; \
+      a = _mm256_unpacklo_epi8(a, b); \
+      b = _mm256_unpackhi_epi8(tmp, b)
+
+    // 16-bit interleave step (for transposes)
+#define dct_interleave16(a, b) \
+      tmp = a; \
+      a = _mm256_unpacklo_epi16(a, b); \
+      b = _mm256_unpackhi_epi16(tmp, b)
+
+#define dct_pass(bias,shift) \
+      { \
+         /* even part */ \
+         dct_rot(t2e,t3e, row2,row6, rot0_0,rot0_1); \
+         __m256i sum04 = _mm256_add_epi16(row0, row4); \
+         __m256i dif04 = _mm256_sub_epi16(row0, row4); \
+         dct_widen(t0e, sum04); \
+         dct_widen(t1e, dif04); \
+         dct_wadd(x0, t0e, t3e); \
+         dct_wsub(x3, t0e, t3e); \
+         dct_wadd(x1, t1e, t2e); \
+         dct_wsub(x2, t1e, t2e); \
+         /* odd part */ \
+         dct_rot(y0o,y2o, row7,row3, rot2_0,rot2_1); \
+         dct_rot(y1o,y3o, row5,row1, rot3_0,rot3_1); \
+         __m256i sum17 = _mm256_add_epi16(row1, row7); \
+         __m256i sum35 = _mm256_add_epi16(row3, row5); \
+         dct_rot(y4o,y5o, sum17,sum35, rot1_0,rot1_1); \
+         dct_wadd(x4, y0o, y4o); \
+         dct_wadd(x5, y1o, y5o); \
+         dct_wadd(x6, y2o, y5o); \
+         dct_wadd(x7, y3o, y4o); \
+         dct_bfly32o(row0,row7, x0,x7,bias,shift); \
+         dct_bfly32o(row1,row6, x1,x6,bias,shift); \
+         dct_bfly32o(row2,row5, x2,x5,bias,shift); \
+         dct_bfly32o(row3,row4, x3,x4,bias,shift); \
+      }
+
+    // load row r of the first block into the low lane and of the second into the high lane
+#define dct_load(r) \
+      _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_load_si128((const __m128i*) (data + (r) * 8))), \
+                              _mm_load_si128((const __m128i*) (data + 64 + (r) * 8)), 1)
+
+    // store 8 bytes of each lane: the first block's row at out, the second's at out + 8
+#define dct_store(v) \
+      _mm_storel_epi64((__m128i*) out, _mm256_castsi256_si128(v)); \
+      _mm_storel_epi64((__m128i*) (out + 8), _mm256_extracti128_si256(v, 1)); \
+      out += out_stride
+
+    __m256i rot0_0 = dct_const(stbi__f2f(0.5411961f), stbi__f2f(0.5411961f) + stbi__f2f(-1.847759065f));
+    __m256i rot0_1 = dct_const(stbi__f2f(0.5411961f) + stbi__f2f(0.765366865f), stbi__f2f(0.5411961f));
+    __m256i rot1_0 = dct_const(stbi__f2f(1.175875602f) + stbi__f2f(-0.899976223f), stbi__f2f(1.175875602f));
+    __m256i rot1_1 = dct_const(stbi__f2f(1.175875602f), stbi__f2f(1.175875602f) + stbi__f2f(-2.562915447f));
+    __m256i rot2_0 = dct_const(stbi__f2f(-1.961570560f) + stbi__f2f(0.298631336f), stbi__f2f(-1.961570560f));
+    __m256i rot2_1 = dct_const(stbi__f2f(-1.961570560f), stbi__f2f(-1.961570560f) + stbi__f2f(3.072711026f));
+    __m256i rot3_0 = dct_const(stbi__f2f(-0.390180644f) + stbi__f2f(2.053119869f), stbi__f2f(-0.390180644f));
+    __m256i rot3_1 = dct_const(stbi__f2f(-0.390180644f), stbi__f2f(-0.390180644f) + stbi__f2f(1.501321110f));
+
+    // rounding biases in column/row passes, see stbi__idct_block for explanation.
+    __m256i bias_0 = _mm256_set1_epi32(512);
+    __m256i bias_1 = _mm256_set1_epi32(65536 + (128 << 17));
+
+    // load
+    row0 = dct_load(0);
+    row1 = dct_load(1);
+    row2 = dct_load(2);
+    row3 = dct_load(3);
+    row4 = dct_load(4);
+    row5 = dct_load(5);
+    row6 = dct_load(6);
+    row7 = dct_load(7);
+
+    // column pass
+    dct_pass(bias_0, 10);
+
+    {
+        // 16bit 8x8 transpose pass 1
+        dct_interleave16(row0, row4);
+        dct_interleave16(row1, row5);
+        dct_interleave16(row2, row6);
+        dct_interleave16(row3, row7);
+
+        // transpose pass 2
+        dct_interleave16(row0, row2);
+        dct_interleave16(row1, row3);
+        dct_interleave16(row4, row6);
+        dct_interleave16(row5, row7);
+
+        // transpose pass 3
+        dct_interleave16(row0, row1);
+        dct_interleave16(row2, row3);
+        dct_interleave16(row4, row5);
+        dct_interleave16(row6, row7);
+    }
+
+    // row pass
+    dct_pass(bias_1, 17);
+
+    {
+        // pack
+        __m256i p0 = _mm256_packus_epi16(row0, row1); // a0a1a2a3...a7b0b1b2b3...b7
+        __m256i p1 = _mm256_packus_epi16(row2, row3);
+        __m256i p2 = _mm256_packus_epi16(row4, row5);
+        __m256i p3 = _mm256_packus_epi16(row6, row7);
+
+        // 8bit 8x8 transpose pass 1
+        dct_interleave8(p0, p2); // a0e0a1e1...
+        dct_interleave8(p1, p3); // c0g0c1g1...
+
+        // transpose pass 2
+        dct_interleave8(p0, p1); // a0c0e0g0...
+        dct_interleave8(p2, p3); // b0d0f0h0...
+
+        // transpose pass 3
+        dct_interleave8(p0, p2); // a0b0c0d0...
+        dct_interleave8(p1, p3); // a4b4c4d4...
+
+        // store
+        dct_store(p0);
+        dct_store(_mm256_shuffle_epi32(p0, 0x4e));
+        dct_store(p2);
+        dct_store(_mm256_shuffle_epi32(p2, 0x4e));
+        dct_store(p1);
+        dct_store(_mm256_shuffle_epi32(p1, 0x4e));
+        dct_store(p3);
+        dct_store(_mm256_shuffle_epi32(p3, 0x4e));
+    }
+
+#undef dct_const
+#undef dct_rot
+#undef dct_widen
+#undef dct_wadd
+#undef dct_wsub
+#undef dct_bfly32o
+#undef dct_interleave8
+#undef dct_interleave16
+#undef dct_pass
+#undef dct_load
+#undef dct_store
+}
+
+#endif // STBI_AVX2
+
 #ifdef STBI_NEON
 
 // NEON integer IDCT. should produce bit-identical
@@ -2738,7 +3104,7 @@ static int stbi__parse_entropy_coded_data(stbi__jpeg* z)
                 for (i = 0; i < w; ++i) {
                     int ha = z->img_comp[n].ha;
                     if (!stbi__jpeg_decode_block(z, data, z->huff_dc + z->img_comp[n].hd, z->huff_ac + ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
-                    z->idct_block_kernel(z->img_comp[n].data + z->img_comp[n].w2 * j * 8 + i * 8, z->img_comp[n].w2, data);
+                    z->idct_block_kernel(z->img_comp[n].data + z->img_comp[n].w2 * j * z->block_size + i * z->block_size, z->img_comp[n].w2, data);
                     // every data block is an MCU, so countdown the restart interval
                     if (--z->todo <= 0) {
                         if (z->code_bits < 24) stbi__grow_buffer_unsafe(z);
@@ -2763,8 +3129,8 @@ static int stbi__parse_entropy_coded_data(stbi__jpeg* z)
                         // by the basic H and V specified for the component
                         for (y = 0; y < z->img_comp[n].v; ++y) {
                             for (x = 0; x < z->img_comp[n].h; ++x) {
-                                int x2 = (i * z->img_comp[n].h + x) * 8;
-                                int y2 = (j * z->img_comp[n].v + y) * 8;
+                                int x2 = (i * z->img_comp[n].h + x) * z->block_size;
+                                int y2 = (j * z->img_comp[n].v + y) * z->block_size;
                                 int ha = z->img_comp[n].ha;
                                 if (!stbi__jpeg_decode_block(z, data, z->huff_dc + z->img_comp[n].hd, z->huff_ac + ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
                                 z->idct_block_kernel(z->img_comp[n].data + z->img_comp[n].w2 * y2 + x2, z->img_comp[n].w2, data);
@@ -2864,10 +3230,20 @@ static void stbi__jpeg_finish(stbi__jpeg* z)
             int w = (z->img_comp[n].x + 7) >> 3;
             int h = (z->img_comp[n].y + 7) >> 3;
             for (j = 0; j < h; ++j) {
-                for (i = 0; i < w; ++i) {
+                i = 0;
+                // neighbouring blocks in a row are contiguous in coeff, so they can go through the IDCT in pairs
+                if (z->idct_block2_kernel) {
+                    for (; i + 1 < w; i += 2) {
+                        short* data = z->img_comp[n].coeff + 64 * (i + j * z->img_comp[n].coeff_w);
+                        stbi__jpeg_dequantize(data, z->dequant[z->img_comp[n].tq]);
+                        stbi__jpeg_dequantize(data + 64, z->dequant[z->img_comp[n].tq]);
+                        z->idct_block2_kernel(z->img_comp[n].data + z->img_comp[n].w2 * j * z->block_size + i * z->block_size, z->img_comp[n].w2, data);
+                    }
+                }
+                for (; i < w; ++i) {
                     short* data = z->img_comp[n].coeff + 64 * (i + j * z->img_comp[n].coeff_w);
                     stbi__jpeg_dequantize(data, z->dequant[z->img_comp[n].tq]);
-                    z->idct_block_kernel(z->img_comp[n].data + z->img_comp[n].w2 * j * 8 + i * 8, z->img_comp[n].w2, data);
+                    z->idct_block_kernel(z->img_comp[n].data + z->img_comp[n].w2 * j * z->block_size + i * z->block_size, z->img_comp[n].w2, data);
                 }
             }
         }
@@ -3065,8 +3441,8 @@ static int stbi__process_frame_header(stbi__jpeg* z, int scan)
         //
         // img_mcu_x, img_mcu_y: <=17 bits; comp[i].h and .v are <=4 (checked earlier)
         // so these muls can't overflow with 32-bit ints (which we require)
-        z->img_comp[i].w2 = z->img_mcu_x * z->img_comp[i].h * 8;
-        z->img_comp[i].h2 = z->img_mcu_y * z->img_comp[i].v * 8;
+        z->img_comp[i].w2 = z->img_mcu_x * z->img_comp[i].h * z->block_size;
+        z->img_comp[i].h2 = z->img_mcu_y * z->img_comp[i].v * z->block_size;
         z->img_comp[i].coeff = 0;
         z->img_comp[i].raw_coeff = 0;
         z->img_comp[i].linebuf = NULL;
@@ -3076,10 +3452,10 @@ static int stbi__process_frame_header(stbi__jpeg* z, int scan)
         // align blocks for idct using mmx/sse
         z->img_comp[i].data = (stbi_uc*)(((size_t)z->img_comp[i].raw_data + 15) & ~15);
         if (z->progressive) {
-            // w2, h2 are multiples of 8 (see above)
-            z->img_comp[i].coeff_w = z->img_comp[i].w2 / 8;
-            z->img_comp[i].coeff_h = z->img_comp[i].h2 / 8;
-            z->img_comp[i].raw_coeff = stbi__malloc_mad3(z->img_comp[i].w2, z->img_comp[i].h2, sizeof(short), 15);
+            // coefficients are always kept for full-size blocks, even when decoding scaled down
+            z->img_comp[i].coeff_w = z->img_mcu_x * z->img_comp[i].h;
+            z->img_comp[i].coeff_h = z->img_mcu_y * z->img_comp[i].v;
+            z->img_comp[i].raw_coeff = stbi__malloc_mad3(z->img_comp[i].coeff_w * 8, z->img_comp[i].coeff_h * 8, sizeof(short), 15);
             if (z->img_comp[i].raw_coeff == NULL)
                 return stbi__free_jpeg_components(z, i + 1, stbi__err("outofmem", "Out of memory"));
             z->img_comp[i].coeff = (short*)(((size_t)z->img_comp[i].raw_coeff + 15) & ~15);
@@ -3120,6 +3496,26 @@ static int stbi__decode_jpeg_header(stbi__jpeg* z, int scan)
     return 1;
 }
 
+// a 1/8 scale decode only needs each block's DC term, so the AC scans of a
+// progressive file can be stepped over without entropy decoding them: just
+// find the next marker that isn't a stuffed byte or a restart marker
+static void stbi__jpeg_skip_scan(stbi__jpeg* j)
+{
+    while (!stbi__at_eof(j->s)) {
+        int x = stbi__get8(j->s);
+        if (x == 255) {
+            x = stbi__get8(j->s);
+            while (x == 255)
+                x = stbi__get8(j->s);
+            if (x != 0 && !STBI__RESTART(x)) {
+                j->marker = (stbi_uc)x;
+                return;
+            }
+        }
+    }
+    j->marker = STBI__MARKER_none;
+}
+
 // decode image to YCbCr format
 static int stbi__decode_jpeg_image(stbi__jpeg* j)
 {
@@ -3134,6 +3530,12 @@ static int stbi__decode_jpeg_image(stbi__jpeg* j)
     while (!stbi__EOI(m)) {
         if (stbi__SOS(m)) {
             if (!stbi__process_scan_header(j)) return 0;
+            if (j->progressive && j->spec_start != 0 && j->scale_shift == 3) {
+                stbi__jpeg_skip_scan(j);
+                if (j->marker == STBI__MARKER_none) return stbi__err("no EOI", "Corrupt JPEG");
+                m = stbi__get_marker(j);
+                continue;
+            }
             if (!stbi__parse_entropy_coded_data(j)) return 0;
             if (j->marker == STBI__MARKER_none) {
                 // handle 0s at the end of image data from IP Kamera 9060
@@ -3357,6 +3759,124 @@ static stbi_uc* stbi__resample_row_hv_2_simd(stbi_uc* out, stbi_uc* in_near, stb
 }
 #endif
 
+#ifdef STBI_AVX2
+static STBI__AVX2_TARGET stbi_uc* stbi__resample_row_hv_2_avx2(stbi_uc* out, stbi_uc* in_near, stbi_uc* in_far, int w, int hs)
+{
+    // same filter as stbi__resample_row_hv_2_simd, 16 pixels at a time
+    int i = 0, t0, t1;
+
+    if (w == 1) {
+        out[0] = out[1] = stbi__div4(3 * in_near[0] + in_far[0] + 2);
+        return out;
+    }
+
+    t1 = 3 * in_near[0] + in_far[0];
+    // as in the sse2 version the last pixel of the row is left to the scalar loop
+    for (; i < ((w - 1) & ~15); i += 16) {
+        // load and perform the vertical filtering pass
+        // this uses 3*x + y = 4*x + (y - x)
+        __m256i farw = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i*) (in_far + i)));
+        __m256i nearw = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i*) (in_near + i)));
+        __m256i diff = _mm256_sub_epi16(farw, nearw);
+        __m256i nears = _mm256_slli_epi16(nearw, 2);
+        __m256i curr = _mm256_add_epi16(nears, diff); // current row
+
+        // "prev" is the current row shifted right by 1 pixel with t1 shifted in,
+        // "next" shifted left by 1 pixel with the first pixel of the next group.
+        // alignr only shifts within a lane, so the neighbouring lane (or the
+        // inserted value) is moved in place with a lane permute first.
+        __m256i prvl = _mm256_permute2x128_si256(curr, _mm256_set1_epi16((short)t1), 0x02);
+        __m256i nxtl = _mm256_permute2x128_si256(curr, _mm256_set1_epi16((short)(3 * in_near[i + 16] + in_far[i + 16])), 0x21);
+        __m256i prev = _mm256_alignr_epi8(curr, prvl, 14);
+        __m256i next = _mm256_alignr_epi8(nxtl, curr, 2);
+
+        // horizontal filter, polyphase implementation since it's convenient:
+        // even pixels = 3*cur + prev = cur*4 + (prev - cur)
+        // odd  pixels = 3*cur + next = cur*4 + (next - cur)
+        // note the shared term.
+        __m256i bias = _mm256_set1_epi16(8);
+        __m256i curs = _mm256_slli_epi16(curr, 2);
+        __m256i prvd = _mm256_sub_epi16(prev, curr);
+        __m256i nxtd = _mm256_sub_epi16(next, curr);
+        __m256i curb = _mm256_add_epi16(curs, bias);
+        __m256i even = _mm256_add_epi16(prvd, curb);
+        __m256i odd = _mm256_add_epi16(nxtd, curb);
+
+        // interleave even and odd pixels, then undo scaling. the unpacks and
+        // the pack all stay within lanes, which leaves the 32 bytes in order.
+        __m256i int0 = _mm256_unpacklo_epi16(even, odd);
+        __m256i int1 = _mm256_unpackhi_epi16(even, odd);
+        __m256i de0 = _mm256_srli_epi16(int0, 4);
+        __m256i de1 = _mm256_srli_epi16(int1, 4);
+
+        // pack and write output
+        __m256i outv = _mm256_packus_epi16(de0, de1);
+        _mm256_storeu_si256((__m256i*) (out + i * 2), outv);
+
+        // "previous" value for next iter
+        t1 = 3 * in_near[i + 15] + in_far[i + 15];
+    }
+
+    t0 = t1;
+    t1 = 3 * in_near[i] + in_far[i];
+    out[i * 2] = stbi__div16(3 * t1 + t0 + 8);
+
+    for (++i; i < w; ++i) {
+        t0 = t1;
+        t1 = 3 * in_near[i] + in_far[i];
+        out[i * 2 - 1] = stbi__div16(3 * t0 + t1 + 8);
+        out[i * 2] = stbi__div16(3 * t1 + t0 + 8);
+    }
+    out[w * 2 - 1] = stbi__div4(t1 + 2);
+
+    STBI_NOTUSED(hs);
+
+    return out;
+}
+
+static STBI__AVX2_TARGET stbi_uc* stbi__resample_row_h_2_avx2(stbi_uc* out, stbi_uc* in_near, stbi_uc* in_far, int w, int hs)
+{
+    // same results as stbi__resample_row_h_2; the neighbours come from unaligned loads one pixel either side
+    int i;
+    stbi_uc* input = in_near;
+
+    if (w == 1) {
+        // if only one sample, can't do any interpolation
+        out[0] = out[1] = input[0];
+        return out;
+    }
+
+    out[0] = input[0];
+    out[1] = stbi__div4(input[0] * 3 + input[1] + 2);
+    for (i = 1; i + 16 < w; i += 16) {
+        __m256i prev = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i*) (input + i - 1)));
+        __m256i curr = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i*) (input + i)));
+        __m256i next = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i*) (input + i + 1)));
+
+        // even pixels = (3*cur + prev + 2) >> 2, odd pixels = (3*cur + next + 2) >> 2
+        __m256i n = _mm256_add_epi16(_mm256_add_epi16(_mm256_slli_epi16(curr, 1), curr), _mm256_set1_epi16(2));
+        __m256i even = _mm256_srli_epi16(_mm256_add_epi16(n, prev), 2);
+        __m256i odd = _mm256_srli_epi16(_mm256_add_epi16(n, next), 2);
+
+        // interleave and write; unpacks and pack are in-lane, so the bytes come out in order
+        __m256i outv = _mm256_packus_epi16(_mm256_unpacklo_epi16(even, odd), _mm256_unpackhi_epi16(even, odd));
+        _mm256_storeu_si256((__m256i*) (out + i * 2), outv);
+    }
+    for (; i < w - 1; ++i) {
+        int n = 3 * input[i] + 2;
+        out[i * 2 + 0] = stbi__div4(n + input[i - 1]);
+        out[i * 2 + 1] = stbi__div4(n + input[i + 1]);
+    }
+    out[i * 2 + 0] = stbi__div4(input[w - 2] * 3 + input[w - 1] + 2);
+    out[i * 2 + 1] = input[w - 1];
+
+    STBI_NOTUSED(in_far);
+    STBI_NOTUSED(hs);
+
+    return out;
+}
+#endif
+
 static stbi_uc* stbi__resample_row_generic(stbi_uc* out, stbi_uc* in_near, stbi_uc* in_far, int w, int hs)
 {
     // resample with nearest-neighbor
@@ -3561,15 +4081,120 @@ static void stbi__YCbCr_to_RGB_simd(stbi_uc* out, stbi_uc const* y, stbi_uc cons
 }
 #endif
 
+#if defined(STBI_AVX2) && !defined(STBI_JPEG_OLD)
+static STBI__AVX2_TARGET void stbi__YCbCr_to_RGB_avx2(stbi_uc* out, stbi_uc const* y, stbi_uc const* pcb, stbi_uc const* pcr, int count, int step)
+{
+    // the sse2 transform on 16 pixels at a time. unlike the sse2 version this
+    // also handles step == 3, which is what 3-channel loads of a JPEG use.
+    int i = 0;
+
+    if (step == 3 || step == 4) {
+        __m128i signflip = _mm_set1_epi8(-0x80);
+        __m256i cr_const0 = _mm256_set1_epi16((short)(1.40200f * 4096.0f + 0.5f));
+        __m256i cr_const1 = _mm256_set1_epi16(-(short)(0.71414f * 4096.0f + 0.5f));
+        __m256i cb_const0 = _mm256_set1_epi16(-(short)(0.34414f * 4096.0f + 0.5f));
+        __m256i cb_const1 = _mm256_set1_epi16((short)(1.77200f * 4096.0f + 0.5f));
+        __m256i y_bias = _mm256_set1_epi16(128);
+        __m256i xw = _mm256_set1_epi16(255); // alpha channel
+        // per lane: drop every fourth byte of 4 rgbx pixels, then move the 12 bytes of the high lane next to the low lane's
+        __m256i rgb_shuffle = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+                                               0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+        __m256i rgb_compact = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+
+        for (; i + 15 < count; i += 16) {
+            // load
+            __m128i y_bytes = _mm_loadu_si128((__m128i*) (y + i));
+            __m128i cr_bytes = _mm_loadu_si128((__m128i*) (pcr + i));
+            __m128i cb_bytes = _mm_loadu_si128((__m128i*) (pcb + i));
+            __m128i cr_biased = _mm_xor_si128(cr_bytes, signflip); // -128
+            __m128i cb_biased = _mm_xor_si128(cb_bytes, signflip); // -128
+
+            // widen to short with the byte in the high half, as the sse2 unpacks do
+            __m256i yw = _mm256_or_si256(_mm256_slli_epi16(_mm256_cvtepu8_epi16(y_bytes), 8), y_bias);
+            __m256i crw = _mm256_slli_epi16(_mm256_cvtepu8_epi16(cr_biased), 8);
+            __m256i cbw = _mm256_slli_epi16(_mm256_cvtepu8_epi16(cb_biased), 8);
+
+            // color transform
+            __m256i yws = _mm256_srli_epi16(yw, 4);
+            __m256i cr0 = _mm256_mulhi_epi16(cr_const0, crw);
+            __m256i cb0 = _mm256_mulhi_epi16(cb_const0, cbw);
+            __m256i cb1 = _mm256_mulhi_epi16(cbw, cb_const1);
+            __m256i cr1 = _mm256_mulhi_epi16(crw, cr_const1);
+            __m256i rws = _mm256_add_epi16(cr0, yws);
+            __m256i gwt = _mm256_add_epi16(cb0, yws);
+            __m256i bws = _mm256_add_epi16(yws, cb1);
+            __m256i gws = _mm256_add_epi16(gwt, cr1);
+
+            // descale
+            __m256i rw = _mm256_srai_epi16(rws, 4);
+            __m256i bw = _mm256_srai_epi16(bws, 4);
+            __m256i gw = _mm256_srai_epi16(gws, 4);
+
+            // back to byte, set up for transpose
+            __m256i brb = _mm256_packus_epi16(rw, bw);
+            __m256i gxb = _mm256_packus_epi16(gw, xw);
+
+            // transpose to interleave channels; each lane ends up with
+            // pixels 0-3 (8-11) in o0 and pixels 4-7 (12-15) in o1
+            __m256i t0 = _mm256_unpacklo_epi8(brb, gxb);
+            __m256i t1 = _mm256_unpackhi_epi8(brb, gxb);
+            __m256i o0 = _mm256_unpacklo_epi16(t0, t1);
+            __m256i o1 = _mm256_unpackhi_epi16(t0, t1);
+            __m256i p0 = _mm256_permute2x128_si256(o0, o1, 0x20); // pixels 0-7
+            __m256i p1 = _mm256_permute2x128_si256(o0, o1, 0x31); // pixels 8-15
+
+            // store
+            if (step == 4) {
+                _mm256_storeu_si256((__m256i*) (out + 0), p0);
+                _mm256_storeu_si256((__m256i*) (out + 32), p1);
+                out += 64;
+            }
+            else {
+                __m256i c0 = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(p0, rgb_shuffle), rgb_compact);
+                __m256i c1 = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(p1, rgb_shuffle), rgb_compact);
+                _mm_storeu_si128((__m128i*) (out + 0), _mm256_castsi256_si128(c0));
+                _mm_storel_epi64((__m128i*) (out + 16), _mm256_extracti128_si256(c0, 1));
+                _mm_storeu_si128((__m128i*) (out + 24), _mm256_castsi256_si128(c1));
+                _mm_storel_epi64((__m128i*) (out + 40), _mm256_extracti128_si256(c1, 1));
+                out += 48;
+            }
+        }
+    }
+
+    for (; i < count; ++i) {
+        int y_fixed = (y[i] << 20) + (1 << 19); // rounding
+        int r, g, b;
+        int cr = pcr[i] - 128;
+        int cb = pcb[i] - 128;
+        r = y_fixed + cr * float2fixed(1.40200f);
+        g = y_fixed + cr * -float2fixed(0.71414f) + ((cb * -float2fixed(0.34414f)) & 0xffff0000);
+        b = y_fixed + cb * float2fixed(1.77200f);
+        r >>= 20;
+        g >>= 20;
+        b >>= 20;
+        if ((unsigned)r > 255) { if (r < 0) r = 0; else r = 255; }
+        if ((unsigned)g > 255) { if (g < 0) g = 0; else g = 255; }
+        if ((unsigned)b > 255) { if (b < 0) b = 0; else b = 255; }
+        out[0] = (stbi_uc)r;
+        out[1] = (stbi_uc)g;
+        out[2] = (stbi_uc)b;
+        out[3] = 255;
+        out += step;
+    }
+}
+#endif
+
 // set up the kernels
 static void stbi__setup_jpeg(stbi__jpeg* j)
 {
     j->idct_block_kernel = stbi__idct_block;
     j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_row;
+    j->idct_block2_kernel = NULL;
     j->resample_row_hv_2_kernel = stbi__resample_row_hv_2;
+    j->resample_row_h_2_kernel = stbi__resample_row_h_2;
 
 #ifdef STBI_SSE2
-    if (stbi__sse2_available()) {
+    if (stbi__simd_level >= 1 && stbi__sse2_available()) {
         j->idct_block_kernel = stbi__idct_simd;
 #ifndef STBI_JPEG_OLD
         j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_simd;
@@ -3578,15 +4203,39 @@ static void stbi__setup_jpeg(stbi__jpeg* j)
     }
 #endif
 
+#ifdef STBI_AVX2
+    if (stbi__simd_level >= 2 && stbi__avx2_available()) {
+        j->idct_block2_kernel = stbi__idct_avx2;
+#ifndef STBI_JPEG_OLD
+        j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_avx2;
+#endif
+        j->resample_row_hv_2_kernel = stbi__resample_row_hv_2_avx2;
+        j->resample_row_h_2_kernel = stbi__resample_row_h_2_avx2;
+    }
+#endif
+
 #ifdef STBI_NEON
-    j->idct_block_kernel = stbi__idct_simd;
+    if (stbi__simd_level >= 1) {
+        j->idct_block_kernel = stbi__idct_simd;
 #ifndef STBI_JPEG_OLD
-    j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_simd;
+        j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_simd;
 #endif
-    j->resample_row_hv_2_kernel = stbi__resample_row_hv_2_simd;
+        j->resample_row_hv_2_kernel = stbi__resample_row_hv_2_simd;
+    }
 #endif
+
+    // decoding scaled down only swaps the IDCT; everything after it just sees smaller components
+    j->scale_shift = j->s->jpeg_scale_shift;
+    j->block_size = 8 >> j->scale_shift;
+    if (j->scale_shift) {
+        j->idct_block_kernel = j->scale_shift == 1 ? stbi__idct_block_4x4 : j->scale_shift == 2 ? stbi__idct_block_2x2 : stbi__idct_block_1x1;
+        j->idct_block2_kernel = NULL;
+    }
 }
 
+// size of the image or of a component when decoded at 1 / (1 << scale_shift)
+#define stbi__jpeg_scaled(size, scale_shift)  (((size) + (1 << (scale_shift)) - 1) >> (scale_shift))
+
 // clean up the temporary component buffers
 static void stbi__cleanup_jpeg(stbi__jpeg* j)
 {
@@ -3614,6 +4263,16 @@ static stbi_uc* load_jpeg_image(stbi__jpeg* z, int* out_x, int* out_y, int* comp
     // load a jpeg image from whichever source, but leave in YCbCr format
     if (!stbi__decode_jpeg_image(z)) { stbi__cleanup_jpeg(z); return NULL; }
 
+    // from here on only the decoded size matters
+    if (z->scale_shift) {
+        z->s->img_x = stbi__jpeg_scaled(z->s->img_x, z->scale_shift);
+        z->s->img_y = stbi__jpeg_scaled(z->s->img_y, z->scale_shift);
+        for (n = 0; n < z->s->img_n; ++n) {
+            z->img_comp[n].x = stbi__jpeg_scaled(z->img_comp[n].x, z->scale_shift);
+            z->img_comp[n].y = stbi__jpeg_scaled(z->img_comp[n].y, z->scale_shift);
+        }
+    }
+
     // determine actual number of components to generate
     n = req_comp ? req_comp : z->s->img_n;
 
@@ -3648,7 +4307,7 @@ static stbi_uc* load_jpeg_image(stbi__jpeg* z, int* out_x, int* out_y, int* comp
 
             if (r->hs == 1 && r->vs == 1) r->resample = resample_row_1;
             else if (r->hs == 1 && r->vs == 2) r->resample = stbi__resample_row_v_2;
-            else if (r->hs == 2 && r->vs == 1) r->resample = stbi__resample_row_h_2;
+            else if (r->hs == 2 && r->vs == 1) r->resample = z->resample_row_h_2_kernel;
             else if (r->hs == 2 && r->vs == 2) r->resample = z->resample_row_hv_2_kernel;
             else                               r->resample = stbi__resample_row_generic;
         }
@@ -3741,8 +4400,8 @@ static int stbi__jpeg_info_raw(stbi__jpeg* j, int* x, int* y, int* comp)
         stbi__rewind(j->s);
         return 0;
     }
-    if (x) *x = j->s->img_x;
-    if (y) *y = j->s->img_y;
+    if (x) *x = stbi__jpeg_scaled(j->s->img_x, j->s->jpeg_scale_shift);
+    if (y) *y = stbi__jpeg_scaled(j->s->img_y, j->s->jpeg_scale_shift);
     if (comp) *comp = j->s->img_n;
     return 1;
 }
@@ -3763,12 +4422,15 @@ static int stbi__jpeg_info(stbi__context* s, int* x, int* y, int* comp)
 //      - all input must be provided in an upfront buffer
 //      - all output is written to a single output buffer (can malloc/realloc)
 //    performance
-//      - fast huffman
+//      - fast huffman, 64-bit bit buffer
 
 #ifndef STBI_NO_ZLIB
 
-// fast-way is faster to check than jpeg huffman, but slow way is slower
-#define STBI__ZFAST_BITS  9 // accelerate all cases in default tables
+// fast-way is faster to check than jpeg huffman, but slow way is slower.
+// 9 bits covers all of the default tables; 10 also resolves most codes of
+// the dynamic tables PNG encoders produce, without making the table (which
+// is rebuilt for every block) much more expensive to fill.
+#define STBI__ZFAST_BITS  10
 #define STBI__ZFAST_MASK  ((1 << STBI__ZFAST_BITS) - 1)
 
 // zlib-style huffman encoding
@@ -3857,7 +4519,8 @@ typedef struct
 {
     stbi_uc* zbuffer, * zbuffer_end;
     int num_bits;
-    stbi__uint32 code_buffer;
+    stbi__uint64 code_buffer; // refilled to at least 56 bits, enough for a whole length/distance pair
+    int zero_bytes;           // bytes fed in as zeros after running off the end of the input
 
     char* zout;
     char* zout_start;
@@ -3875,11 +4538,24 @@ stbi_inline static stbi_uc stbi__zget8(stbi__zbuf* z)
 
 static void stbi__fill_bits(stbi__zbuf* z)
 {
+#if defined(STBI__X64_TARGET) || defined(STBI__X86_TARGET)
+    // little-endian: top up with one unaligned 8-byte read while away from the
+    // end of the input. only whole bytes are counted; the bits of the partial
+    // byte above num_bits are the same ones the next refill ORs in again.
+    if (z->zbuffer_end - z->zbuffer >= 8) {
+        stbi__uint64 next;
+        memcpy(&next, z->zbuffer, 8);
+        z->code_buffer |= next << z->num_bits;
+        z->zbuffer += (63 - z->num_bits) >> 3;
+        z->num_bits |= 56;
+        return;
+    }
+#endif
     do {
-        STBI_ASSERT(z->code_buffer < (1U << z->num_bits));
-        z->code_buffer |= (unsigned int)stbi__zget8(z) << z->num_bits;
+        if (z->zbuffer >= z->zbuffer_end) z->zero_bytes++;
+        z->code_buffer |= (stbi__uint64)stbi__zget8(z) << z->num_bits;
         z->num_bits += 8;
-    } while (z->num_bits <= 24);
+    } while (z->num_bits <= 56);
 }
 
 stbi_inline static unsigned int stbi__zreceive(stbi__zbuf* z, int n)
@@ -3897,7 +4573,7 @@ static int stbi__zhuffman_decode_slowpath(stbi__zbuf* a, stbi__zhuffman* z)
     int b, s, k;
     // not resolved by fast table, so compute it the slow way
     // use jpeg approach, which requires MSbits at top
-    k = stbi__bit_reverse(a->code_buffer, 16);
+    k = stbi__bit_reverse((int)(a->code_buffer & 0xffff), 16);
     for (s = STBI__ZFAST_BITS + 1; ; ++s)
         if (k < z->maxcode[s])
             break;
@@ -3991,8 +4667,19 @@ static int stbi__parse_huffman_block(stbi__zbuf* a)
             }
             p = (stbi_uc*)(zout - dist);
             if (dist == 1) { // run of one byte; common in images.
-                stbi_uc v = *p;
-                if (len) { do *zout++ = v; while (--len); }
+                memset(zout, *p, len);
+                zout += len;
+            }
+            else if (dist >= 8 && a->zout_end - zout >= len + 8) {
+                // 8 bytes at a time; the source stays a full chunk behind the
+                // destination, and the last chunk may spill over into the slack
+                char* end = zout + len;
+                do {
+                    memcpy(zout, p, 8);
+                    zout += 8;
+                    p += 8;
+                } while (zout < end);
+                zout = end;
             }
             else {
                 if (len) { do *zout++ = *p++; while (--len); }
@@ -4059,12 +4746,17 @@ static int stbi__parse_uncompressed_block(stbi__zbuf* a)
         stbi__zreceive(a, a->num_bits & 7); // discard
     // drain the bit-packed data into header
     k = 0;
-    while (a->num_bits > 0) {
+    while (a->num_bits > 0 && k < 4) {
         header[k++] = (stbi_uc)(a->code_buffer & 255); // suppress MSVC run-time check
         a->code_buffer >>= 8;
         a->num_bits -= 8;
     }
-    STBI_ASSERT(a->num_bits == 0);
+    // the 64-bit buffer may hold bytes past the header; hand the real ones back to the input
+    if ((a->num_bits >> 3) > a->zero_bytes)
+        a->zbuffer -= (a->num_bits >> 3) - a->zero_bytes;
+    a->zero_bytes = 0;
+    a->code_buffer = 0;
+    a->num_bits = 0;
     // now fill header the normal way
     while (k < 4)
         header[k++] = stbi__zget8(a);
@@ -4113,6 +4805,7 @@ static int stbi__parse_zlib(stbi__zbuf* a, int parse_header)
         if (!stbi__parse_zlib_header(a)) return 0;
     a->num_bits = 0;
     a->code_buffer = 0;
+    a->zero_bytes = 0;
     do {
         final = stbi__zreceive(a, 1);
         type = stbi__zreceive(a, 2);
@@ -4300,6 +4993,109 @@ static int stbi__paeth(int a, int b, int c)
     return c;
 }
 
+#ifdef STBI_SSE2
+// 3 or 4 byte pixels, widened to 16 bits per channel
+stbi_inline static __m128i stbi__png_load_pixel(const stbi_uc* p, int bytes)
+{
+    stbi__uint32 v = 0;
+    memcpy(&v, p, bytes);
+    return _mm_unpacklo_epi8(_mm_cvtsi32_si128((int)v), _mm_setzero_si128());
+}
+
+stbi_inline static void stbi__png_store_pixel(stbi_uc* p, __m128i v, int bytes)
+{
+    stbi__uint32 b = (stbi__uint32)_mm_cvtsi128_si32(_mm_packus_epi16(v, v));
+    memcpy(p, &b, bytes);
+}
+
+// sse2 versions of the row filters for 8-bit rows of 3 or 4 byte pixels.
+// cur, prior and raw point just past the first pixel, which the caller has
+// already done; returns how many of the remaining nk bytes were handled, and
+// the generic loops finish the rest. sub, avg and paeth depend on the pixel
+// to the left, so those go a pixel at a time with all channels at once.
+// the results are identical to the generic loops.
+static int stbi__png_unfilter_row_simd(int filter, stbi_uc* cur, stbi_uc* prior, stbi_uc* raw, int nk, int bytes)
+{
+    int k = 0;
+    __m128i zero = _mm_setzero_si128();
+    __m128i a = stbi__png_load_pixel(cur - bytes, bytes); // left
+    __m128i c;                                            // upper left; there's no prior row for the *_first filters
+
+    switch (filter) {
+    case STBI__F_up:
+        for (; k + 16 <= nk; k += 16) {
+            __m128i x = _mm_loadu_si128((__m128i*) (raw + k));
+            __m128i b = _mm_loadu_si128((__m128i*) (prior + k));
+            _mm_storeu_si128((__m128i*) (cur + k), _mm_add_epi8(x, b));
+        }
+        break;
+
+    case STBI__F_sub:
+    case STBI__F_paeth_first: // paeth(a, 0, 0) is always a
+        if (bytes == 4) {
+            // prefix sum of 4 pixels in two shifted adds, plus the pixel to the left
+            __m128i last = _mm_packus_epi16(a, a);
+            last = _mm_shuffle_epi32(last, 0x00);
+            for (; k + 16 <= nk; k += 16) {
+                __m128i x = _mm_loadu_si128((__m128i*) (raw + k));
+                x = _mm_add_epi8(x, _mm_slli_si128(x, 4));
+                x = _mm_add_epi8(x, _mm_slli_si128(x, 8));
+                x = _mm_add_epi8(x, last);
+                _mm_storeu_si128((__m128i*) (cur + k), x);
+                last = _mm_shuffle_epi32(x, 0xff);
+            }
+        }
+        else {
+            for (; k < nk; k += bytes) {
+                __m128i x = stbi__png_load_pixel(raw + k, bytes);
+                a = _mm_and_si128(_mm_add_epi16(x, a), _mm_set1_epi16(255));
+                stbi__png_store_pixel(cur + k, a, bytes);
+            }
+        }
+        break;
+
+    case STBI__F_avg:
+    case STBI__F_avg_first:
+        for (; k < nk; k += bytes) {
+            __m128i x = stbi__png_load_pixel(raw + k, bytes);
+            __m128i b = filter == STBI__F_avg ? stbi__png_load_pixel(prior + k, bytes) : zero;
+            __m128i avg = _mm_srli_epi16(_mm_add_epi16(a, b), 1);
+            a = _mm_and_si128(_mm_add_epi16(x, avg), _mm_set1_epi16(255));
+            stbi__png_store_pixel(cur + k, a, bytes);
+        }
+        break;
+
+    case STBI__F_paeth:
+        c = stbi__png_load_pixel(prior - bytes, bytes);
+        for (; k < nk; k += bytes) {
+            __m128i x = stbi__png_load_pixel(raw + k, bytes);
+            __m128i b = stbi__png_load_pixel(prior + k, bytes);
+
+            // p = a + b - c, so pa = |b - c|, pb = |a - c|, pc = |a + b - 2c|
+            __m128i bc = _mm_sub_epi16(b, c);
+            __m128i ac = _mm_sub_epi16(a, c);
+            __m128i abc = _mm_add_epi16(ac, bc);
+            __m128i pa = _mm_max_epi16(bc, _mm_sub_epi16(zero, bc));
+            __m128i pb = _mm_max_epi16(ac, _mm_sub_epi16(zero, ac));
+            __m128i pc = _mm_max_epi16(abc, _mm_sub_epi16(zero, abc));
+            __m128i smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+
+            // ties go to a, then b, then c, as in stbi__paeth
+            __m128i use_a = _mm_cmpeq_epi16(smallest, pa);
+            __m128i use_b = _mm_andnot_si128(use_a, _mm_cmpeq_epi16(smallest, pb));
+            __m128i pred = _mm_or_si128(_mm_and_si128(use_a, a), _mm_andnot_si128(use_a, c));
+            pred = _mm_or_si128(_mm_and_si128(use_b, b), _mm_andnot_si128(use_b, pred));
+
+            c = b;
+            a = _mm_and_si128(_mm_add_epi16(x, pred), _mm_set1_epi16(255));
+            stbi__png_store_pixel(cur + k, a, bytes);
+        }
+        break;
+    }
+    return k;
+}
+#endif
+
 static stbi_uc stbi__depth_scale_table[9] = { 0, 0xff, 0x55, 0, 0x11, 0,0,0, 0x01 };
 
 // create the png data from post-deflated data
@@ -4315,6 +5111,9 @@ static int stbi__create_png_image_raw(stbi__png* a, stbi_uc* raw, stbi__uint32 r
     int output_bytes = out_n * bytes;
     int filter_bytes = img_n * bytes;
     int width = x;
+#ifdef STBI_SSE2
+    int simd_rows = depth == 8 && img_n == out_n && (img_n == 3 || img_n == 4) && stbi__simd_level >= 1 && stbi__sse2_available();
+#endif
 
     STBI_ASSERT(out_n == s->img_n || out_n == s->img_n + 1);
     a->out = (stbi_uc*)stbi__malloc_mad3(x, y, output_bytes, 0); // extra bytes to write off the end into
@@ -4385,9 +5184,14 @@ static int stbi__create_png_image_raw(stbi__png* a, stbi_uc* raw, stbi__uint32 r
         // this is a little gross, so that we don't switch per-pixel or per-component
         if (depth < 8 || img_n == out_n) {
             int nk = (width - 1) * filter_bytes;
+            k = 0;
+#ifdef STBI_SSE2
+            if (simd_rows && filter != STBI__F_none)
+                k = stbi__png_unfilter_row_simd(filter, cur, prior, raw, nk, filter_bytes);
+#endif
 #define STBI__CASE(f) \
              case f:     \
-                for (k=0; k < nk; ++k)
+                for (; k < nk; ++k)
             switch (filter) {
                 // "none" filter turns into a memcpy here; make that explicit.
             case STBI__F_none:         memcpy(cur, raw, nk); break;
@@ -7020,6 +7824,15 @@ STBIDEF int stbi_info_from_memory(stbi_uc const* buffer, int len, int* x, int* y
     return stbi__info_main(&s, x, y, comp);
 }
 
+STBIDEF int stbi_info_from_memory_scaled(stbi_uc const* buffer, int len, int* x, int* y, int* comp, int scale_shift)
+{
+    stbi__context s;
+    if (scale_shift < 0 || scale_shift > 3) return stbi__err("bad scale", "Internal error");
+    stbi__start_mem(&s, buffer, len);
+    s.jpeg_scale_shift = scale_shift;
+    return stbi__info_main(&s, x, y, comp);
+}
+
 STBIDEF int stbi_info_from_callbacks(stbi_io_callbacks const* c, void* user, int* x, int* y, int* comp)
 {
     stbi__context s;
@@ -0,0 +1,213 @@
+//
+//  textureArray.h
+//  test
+//
+//  All material images in one GL_TEXTURE_2D_ARRAY, addressed by layer.
+//
+
+#ifndef textureArray_h
+#define textureArray_h
+
+#include <glad/glad.h>
+
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "assetPack.h"
+#include "glHandle.h"
+#include "stb_image.h"
+#include "threadPool.h"
+
+// Every layer has the same size, so images of a different size are
+// resampled (bilinear) to width x height when the array is built. With the
+// whole material set in one texture, a draw only has to say which layer to
+// sample and nothing is rebound between cubes. JPEGs larger than a layer
+// are decoded at the smallest stb_image scale that still covers it, so a
+// small layer size also means less decoding. A layer can carry a specular
+// map's luminance in its alpha channel, so a material needs only one layer.
+class TextureArray {
+public:
+    GLTexture ID;
+    int width;
+    int height;
+
+    TextureArray(int width = 1024, int height = 1024)
+    {
+        this->width = width;
+        this->height = height;
+    }
+
+    // returns the layer the image will occupy; the same paths always map to the same layer
+    int addLayer(const std::string& path, const std::string& specularMaskPath = "")
+    {
+        std::string key = path + '\n' + specularMaskPath;
+        auto it = layers.find(key);
+        if (it != layers.end())
+            return it->second;
+
+        int layer = (int)sources.size();
+        layers[key] = layer;
+        sources.push_back(Source{ path, specularMaskPath });
+        return layer;
+    }
+
+    int layerCount() const
+    {
+        return (int)sources.size();
+    }
+
+    // decodes every added image in parallel and uploads them as the layers of one array texture
+    void build(GLenum wrapS, GLenum wrapT, GLenum minFilter, GLenum magFilter)
+    {
+        if (sources.empty())
+            return;
+
+        std::vector<std::vector<unsigned char>> pixels(sources.size());
+        {
+            ThreadPool pool;
+            stbi_set_flip_vertically_on_load(true);
+            for (size_t layer = 0; layer < sources.size(); layer++)
+                pool.enqueue([this, layer, &pixels] { loadLayer(sources[layer], pixels[layer]); });
+            pool.wait();
+        }
+
+        ID = GLTexture::create();
+        glBindTexture(GL_TEXTURE_2D_ARRAY, ID.get());
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, width, height, (GLsizei)sources.size(), 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        for (size_t layer = 0; layer < sources.size(); layer++)
+        {
+            if (pixels[layer].empty())
+                continue;
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, (GLint)layer, width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixels[layer].data());
+        }
+        glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, wrapS);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, wrapT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, minFilter);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, magFilter);
+
+        std::cout << "Texture array: " << sources.size() << " layers of " << width << "x" << height << std::endl;
+    }
+
+    void bind(GLenum textureUnit = GL_TEXTURE0) const
+    {
+        glActiveTexture(textureUnit);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, ID.get());
+    }
+
+    void release()
+    {
+        ID.reset();
+    }
+
+private:
+    struct Source {
+        std::string path;
+        std::string specularMaskPath;   // empty, or the image whose luminance replaces alpha
+    };
+
+    std::unordered_map<std::string, int> layers;
+    std::vector<Source> sources;
+
+    // runs on a worker thread
+    void loadLayer(const Source& source, std::vector<unsigned char>& layerPixels) const
+    {
+        int imageWidth, imageHeight;
+        unsigned char* data = loadCovering(source.path, 4, imageWidth, imageHeight);
+        if (!data)
+        {
+            std::cout << "Texture failed to load at path: " << source.path << std::endl;
+            return;
+        }
+
+        if (!source.specularMaskPath.empty())
+        {
+            int maskWidth = imageWidth, maskHeight = imageHeight;
+            unsigned char* mask = source.specularMaskPath == source.path ? nullptr : loadCovering(source.specularMaskPath, 1, maskWidth, maskHeight);
+            if (!mask && source.specularMaskPath != source.path)
+                std::cout << "Texture failed to load at path: " << source.specularMaskPath << std::endl;
+            packSpecularMask(data, imageWidth, imageHeight, mask, maskWidth, maskHeight);
+            stbi_image_free(mask);
+        }
+
+        layerPixels.resize((size_t)width * height * 4);
+        if (imageWidth == width && imageHeight == height)
+            layerPixels.assign(data, data + layerPixels.size());
+        else
+            resample(data, imageWidth, imageHeight, layerPixels.data(), width, height);
+        stbi_image_free(data);
+    }
+
+    // decodes at the smallest JPEG scale that is still at least the layer size; reads from the mounted AssetPack when it has path
+    unsigned char* loadCovering(const std::string& path, int components, int& imageWidth, int& imageHeight) const
+    {
+        const unsigned char* packed;
+        size_t packedSize;
+        bool inPack = AssetPack::findMounted(path, &packed, &packedSize);
+
+        int nrComponents;
+        int scaleShift = 0;
+        if (inPack ? stbi_info_from_memory(packed, (int)packedSize, &imageWidth, &imageHeight, &nrComponents)
+                   : stbi_info(path.c_str(), &imageWidth, &imageHeight, &nrComponents))
+        {
+            while (scaleShift < 3 && (imageWidth >> (scaleShift + 1)) >= width && (imageHeight >> (scaleShift + 1)) >= height)
+                scaleShift++;
+        }
+
+        if (inPack)
+            return stbi_load_from_memory_scaled(packed, (int)packedSize, &imageWidth, &imageHeight, &nrComponents, components, scaleShift);
+        return stbi_load_scaled(path.c_str(), &imageWidth, &imageHeight, &nrComponents, components, scaleShift);
+    }
+
+    // writes the mask (nearest-neighbour if it is another size) into alpha; without one, the image's own luminance
+    static void packSpecularMask(unsigned char* image, int imageWidth, int imageHeight, const unsigned char* mask, int maskWidth, int maskHeight)
+    {
+        for (int y = 0; y < imageHeight; y++)
+        {
+            const unsigned char* maskRow = mask ? mask + (size_t)y * maskHeight / imageHeight * maskWidth : nullptr;
+            unsigned char* pixel = image + (size_t)y * imageWidth * 4;
+            for (int x = 0; x < imageWidth; x++, pixel += 4)
+                pixel[3] = maskRow ? maskRow[(size_t)x * maskWidth / imageWidth] : (unsigned char)((pixel[0] * 77 + pixel[1] * 150 + pixel[2] * 29) >> 8);
+        }
+    }
+
+    // bilinear resample of an RGBA8 image, sampling at texel centers
+    static void resample(const unsigned char* source, int sourceWidth, int sourceHeight, unsigned char* destination, int destinationWidth, int destinationHeight)
+    {
+        float scaleX = (float)sourceWidth / destinationWidth;
+        float scaleY = (float)sourceHeight / destinationHeight;
+
+        for (int y = 0; y < destinationHeight; y++)
+        {
+            float sourceY = (y + 0.5f) * scaleY - 0.5f;
+            int y0 = sourceY < 0.0f ? 0 : (int)sourceY;
+            int y1 = y0 + 1 < sourceHeight ? y0 + 1 : sourceHeight - 1;
+            float fy = sourceY < 0.0f ? 0.0f : sourceY - y0;
+
+            for (int x = 0; x < destinationWidth; x++)
+            {
+                float sourceX = (x + 0.5f) * scaleX - 0.5f;
+                int x0 = sourceX < 0.0f ? 0 : (int)sourceX;
+                int x1 = x0 + 1 < sourceWidth ? x0 + 1 : sourceWidth - 1;
+                float fx = sourceX < 0.0f ? 0.0f : sourceX - x0;
+
+                const unsigned char* p00 = source + ((size_t)y0 * sourceWidth + x0) * 4;
+                const unsigned char* p10 = source + ((size_t)y0 * sourceWidth + x1) * 4;
+                const unsigned char* p01 = source + ((size_t)y1 * sourceWidth + x0) * 4;
+                const unsigned char* p11 = source + ((size_t)y1 * sourceWidth + x1) * 4;
+                unsigned char* out = destination + ((size_t)y * destinationWidth + x) * 4;
+                for (int c = 0; c < 4; c++)
+                {
+                    float top = p00[c] + (p10[c] - p00[c]) * fx;
+                    float bottom = p01[c] + (p11[c] - p01[c]) * fx;
+                    out[c] = (unsigned char)(top + (bottom - top) * fy + 0.5f);
+                }
+            }
+        }
+    }
+};
+
+#endif /* textureArray_h */
@@ -0,0 +1,416 @@
+//
+//  textureBaker.cpp
+//  test
+//
+//  Offline tool: converts the scene's images into block-compressed KTX
+//  files (BC1/BC3/BC4) with a full mip chain, next to the source images.
+//  TextureRegistry picks up "<name>.ktx" in place of "<name>.<ext>".
+//
+//  An argument "diffuse+mask" bakes the pair as one BC3 texture with the
+//  mask's luminance in alpha, "<diffuse>+<mask>.ktx", which is what
+//  TextureRegistry loads for a material with its specular map packed.
+//
+//  usage: TextureBaker [-f auto|bc1|bc3|bc4] [-j threads] [image|diffuse+mask ...]
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define BAKER_SSE2 1
+#endif
+
+#include "ktxTexture.h"
+#include "stb_image.h"
+#include "threadPool.h"
+
+using namespace std;
+
+struct Image {
+    int width;
+    int height;
+    vector<unsigned char> rgba;
+};
+
+enum class BlockFormat { Auto, BC1, BC3, BC4 };
+
+// 2x2 box filter, matching what glGenerateMipmap does for the plain textures
+Image downsample(const Image& source)
+{
+    Image result;
+    result.width = max(1, source.width / 2);
+    result.height = max(1, source.height / 2);
+    result.rgba.resize((size_t)result.width * result.height * 4);
+
+    for (int y = 0; y < result.height; y++)
+    {
+        int y0 = min(2 * y, source.height - 1);
+        int y1 = min(2 * y + 1, source.height - 1);
+        for (int x = 0; x < result.width; x++)
+        {
+            int x0 = min(2 * x, source.width - 1);
+            int x1 = min(2 * x + 1, source.width - 1);
+            for (int c = 0; c < 4; c++)
+            {
+                int sum = source.rgba[((size_t)y0 * source.width + x0) * 4 + c] + source.rgba[((size_t)y0 * source.width + x1) * 4 + c] +
+                          source.rgba[((size_t)y1 * source.width + x0) * 4 + c] + source.rgba[((size_t)y1 * source.width + x1) * 4 + c];
+                result.rgba[((size_t)y * result.width + x) * 4 + c] = (unsigned char)((sum + 2) / 4);
+            }
+        }
+    }
+    return result;
+}
+
+// gathers a 4x4 block, clamping at the right/bottom edge of odd-sized levels
+void fetchBlock(const Image& image, int blockX, int blockY, unsigned char block[16][4])
+{
+    for (int y = 0; y < 4; y++)
+    {
+        int sy = min(blockY * 4 + y, image.height - 1);
+        for (int x = 0; x < 4; x++)
+        {
+            int sx = min(blockX * 4 + x, image.width - 1);
+            memcpy(block[y * 4 + x], &image.rgba[((size_t)sy * image.width + sx) * 4], 4);
+        }
+    }
+}
+
+uint16_t packRGB565(const float color[3])
+{
+    int r = (int)(min(max(color[0], 0.0f), 255.0f) * 31.0f / 255.0f + 0.5f);
+    int g = (int)(min(max(color[1], 0.0f), 255.0f) * 63.0f / 255.0f + 0.5f);
+    int b = (int)(min(max(color[2], 0.0f), 255.0f) * 31.0f / 255.0f + 0.5f);
+    return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+void unpackRGB565(uint16_t packed, float color[3])
+{
+    color[0] = (float)((packed >> 11) & 31) * 255.0f / 31.0f;
+    color[1] = (float)((packed >> 5) & 63) * 255.0f / 63.0f;
+    color[2] = (float)(packed & 31) * 255.0f / 31.0f;
+}
+
+// Projects the 16 pixels onto the segment color0 -> color1 and returns the
+// parameter t of each one (0 at color0, 1 at color1).
+void projectOntoSegment(const unsigned char block[16][4], const float color0[3], const float color1[3], float t[16])
+{
+    float axis[3] = { color1[0] - color0[0], color1[1] - color0[1], color1[2] - color0[2] };
+    float lengthSquared = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+    float scale = lengthSquared > 0.0f ? 1.0f / lengthSquared : 0.0f;
+
+#ifdef BAKER_SSE2
+    __m128 axisR = _mm_set1_ps(axis[0] * scale), axisG = _mm_set1_ps(axis[1] * scale), axisB = _mm_set1_ps(axis[2] * scale);
+    __m128 originR = _mm_set1_ps(color0[0]), originG = _mm_set1_ps(color0[1]), originB = _mm_set1_ps(color0[2]);
+    for (int i = 0; i < 16; i += 4)
+    {
+        __m128 r = _mm_setr_ps(block[i][0], block[i + 1][0], block[i + 2][0], block[i + 3][0]);
+        __m128 g = _mm_setr_ps(block[i][1], block[i + 1][1], block[i + 2][1], block[i + 3][1]);
+        __m128 b = _mm_setr_ps(block[i][2], block[i + 1][2], block[i + 2][2], block[i + 3][2]);
+        __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_sub_ps(r, originR), axisR), _mm_mul_ps(_mm_sub_ps(g, originG), axisG)),
+                              _mm_mul_ps(_mm_sub_ps(b, originB), axisB));
+        _mm_storeu_ps(t + i, d);
+    }
+#else
+    for (int i = 0; i < 16; i++)
+        t[i] = ((block[i][0] - color0[0]) * axis[0] + (block[i][1] - color0[1]) * axis[1] + (block[i][2] - color0[2]) * axis[2]) * scale;
+#endif
+}
+
+// BC1 color block: endpoints from a range fit along the principal axis,
+// indices by projecting each pixel onto the quantized endpoints.
+void encodeColorBlock(const unsigned char block[16][4], unsigned char* output)
+{
+    float mean[3] = { 0.0f, 0.0f, 0.0f };
+    for (int i = 0; i < 16; i++)
+        for (int c = 0; c < 3; c++)
+            mean[c] += block[i][c];
+    for (int c = 0; c < 3; c++)
+        mean[c] /= 16.0f;
+
+    float covariance[6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+    for (int i = 0; i < 16; i++)
+    {
+        float r = block[i][0] - mean[0], g = block[i][1] - mean[1], b = block[i][2] - mean[2];
+        covariance[0] += r * r; covariance[1] += r * g; covariance[2] += r * b;
+        covariance[3] += g * g; covariance[4] += g * b; covariance[5] += b * b;
+    }
+
+    // a few power iterations are plenty for a 3x3 covariance matrix
+    float axis[3] = { 1.0f, 1.0f, 1.0f };
+    for (int iteration = 0; iteration < 4; iteration++)
+    {
+        float next[3] = {
+            covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2],
+            covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2],
+            covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2]
+        };
+        float length = sqrtf(next[0] * next[0] + next[1] * next[1] + next[2] * next[2]);
+        if (length < 1e-6f)
+            break;
+        for (int c = 0; c < 3; c++)
+            axis[c] = next[c] / length;
+    }
+
+    float minProjection = 1e30f, maxProjection = -1e30f;
+    for (int i = 0; i < 16; i++)
+    {
+        float projection = (block[i][0] - mean[0]) * axis[0] + (block[i][1] - mean[1]) * axis[1] + (block[i][2] - mean[2]) * axis[2];
+        minProjection = min(minProjection, projection);
+        maxProjection = max(maxProjection, projection);
+    }
+
+    float high[3], low[3];
+    for (int c = 0; c < 3; c++)
+    {
+        high[c] = mean[c] + axis[c] * maxProjection;
+        low[c] = mean[c] + axis[c] * minProjection;
+    }
+
+    uint16_t color0 = packRGB565(high);
+    uint16_t color1 = packRGB565(low);
+    // color0 > color1 selects the 4-color mode
+    if (color0 < color1)
+        swap(color0, color1);
+
+    uint32_t indices = 0;
+    if (color0 != color1)
+    {
+        float endpoint0[3], endpoint1[3];
+        unpackRGB565(color0, endpoint0);
+        unpackRGB565(color1, endpoint1);
+
+        float t[16];
+        projectOntoSegment(block, endpoint0, endpoint1, t);
+
+        // palette order is color0, color1, 2/3 color0 + 1/3 color1, 1/3 color0 + 2/3 color1
+        static const uint32_t indexForStep[4] = { 0, 2, 3, 1 };
+        for (int i = 0; i < 16; i++)
+        {
+            int step = (int)(min(max(t[i], 0.0f), 1.0f) * 3.0f + 0.5f);
+            indices |= indexForStep[step] << (2 * i);
+        }
+    }
+
+    output[0] = (unsigned char)(color0 & 0xFF);
+    output[1] = (unsigned char)(color0 >> 8);
+    output[2] = (unsigned char)(color1 & 0xFF);
+    output[3] = (unsigned char)(color1 >> 8);
+    memcpy(output + 4, &indices, 4);
+}
+
+// BC4 / BC3-alpha block: 8-value mode between the block's min and max
+void encodeScalarBlock(const unsigned char values[16], unsigned char* output)
+{
+    unsigned char high = 0, low = 255;
+    for (int i = 0; i < 16; i++)
+    {
+        high = max(high, values[i]);
+        low = min(low, values[i]);
+    }
+
+    output[0] = high;
+    output[1] = low;
+
+    uint64_t indices = 0;
+    if (high != low)
+    {
+        float scale = 7.0f / (float)(high - low);
+        for (int i = 0; i < 16; i++)
+        {
+            // step 0 is high, step 7 is low, steps 1..6 are the interpolated codes 2..7
+            int step = (int)((high - values[i]) * scale + 0.5f);
+            uint64_t code = step == 0 ? 0 : step == 7 ? 1 : (uint64_t)(step + 1);
+            indices |= code << (3 * i);
+        }
+    }
+    for (int i = 0; i < 6; i++)
+        output[2 + i] = (unsigned char)(indices >> (8 * i));
+}
+
+void encodeBlock(const Image& image, int blockX, int blockY, GLenum format, unsigned char* output)
+{
+    unsigned char block[16][4];
+    fetchBlock(image, blockX, blockY, block);
+
+    if (format == GL_COMPRESSED_RED_RGTC1)
+    {
+        unsigned char luminance[16];
+        for (int i = 0; i < 16; i++)
+            luminance[i] = (unsigned char)((block[i][0] * 77 + block[i][1] * 150 + block[i][2] * 29 + 128) >> 8);
+        encodeScalarBlock(luminance, output);
+    }
+    else if (format == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT)
+    {
+        unsigned char alpha[16];
+        for (int i = 0; i < 16; i++)
+            alpha[i] = block[i][3];
+        encodeScalarBlock(alpha, output);
+        encodeColorBlock(block, output + 8);
+    }
+    else
+    {
+        encodeColorBlock(block, output);
+    }
+}
+
+vector<unsigned char> encodeLevel(const Image& image, GLenum format, ThreadPool& pool)
+{
+    int blocksWide = (image.width + 3) / 4;
+    int blocksHigh = (image.height + 3) / 4;
+    uint32_t blockBytes = KtxTexture::blockBytes(format);
+    vector<unsigned char> output((size_t)blocksWide * blocksHigh * blockBytes);
+
+    // one task per row of blocks
+    for (int blockY = 0; blockY < blocksHigh; blockY++)
+    {
+        pool.enqueue([&image, &output, format, blockY, blocksWide, blockBytes] {
+            unsigned char* row = &output[(size_t)blockY * blocksWide * blockBytes];
+            for (int blockX = 0; blockX < blocksWide; blockX++)
+                encodeBlock(image, blockX, blockY, format, row + (size_t)blockX * blockBytes);
+        });
+    }
+    pool.wait();
+    return output;
+}
+
+GLenum chooseFormat(const Image& image, int nrComponents, BlockFormat requested)
+{
+    if (requested == BlockFormat::BC1) return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    if (requested == BlockFormat::BC3) return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    if (requested == BlockFormat::BC4) return GL_COMPRESSED_RED_RGTC1;
+
+    if (nrComponents <= 2)
+        return GL_COMPRESSED_RED_RGTC1;
+    for (size_t i = 3; i < image.rgba.size(); i += 4)
+        if (image.rgba[i] != 255)
+            return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+}
+
+const char* formatName(GLenum format)
+{
+    if (format == GL_COMPRESSED_RED_RGTC1) return "BC4";
+    if (format == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT) return "BC3";
+    return "BC1";
+}
+
+// Replaces the image's alpha with the mask's luminance, exactly as
+// TextureRegistry packs the source images: stb_image's grey conversion,
+// sampled nearest-neighbour when the mask is another size.
+bool packMask(Image& image, const string& maskPath)
+{
+    int maskWidth, maskHeight, nrComponents;
+    unsigned char* mask = stbi_load(maskPath.c_str(), &maskWidth, &maskHeight, &nrComponents, 1);
+    if (!mask)
+    {
+        cout << "Texture failed to load at path: " << maskPath << endl;
+        return false;
+    }
+
+    for (int y = 0; y < image.height; y++)
+    {
+        const unsigned char* maskRow = mask + (size_t)y * maskHeight / image.height * maskWidth;
+        for (int x = 0; x < image.width; x++)
+            image.rgba[((size_t)y * image.width + x) * 4 + 3] = maskRow[(size_t)x * maskWidth / image.width];
+    }
+    stbi_image_free(mask);
+    return true;
+}
+
+// with a maskPath the result is always BC3, whatever was requested
+bool bake(const string& path, const string& maskPath, BlockFormat requested, ThreadPool& pool)
+{
+    Image image;
+    int nrComponents;
+    // same orientation as loadTexture(), so the runtime can upload the levels as-is
+    stbi_set_flip_vertically_on_load(true);
+    unsigned char* data = stbi_load(path.c_str(), &image.width, &image.height, &nrComponents, 4);
+    if (!data)
+    {
+        cout << "Texture failed to load at path: " << path << endl;
+        return false;
+    }
+    image.rgba.assign(data, data + (size_t)image.width * image.height * 4);
+    stbi_image_free(data);
+
+    if (!maskPath.empty() && !packMask(image, maskPath))
+        return false;
+
+    GLenum format = maskPath.empty() ? chooseFormat(image, nrComponents, requested) : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    uint32_t width = (uint32_t)image.width;
+    uint32_t height = (uint32_t)image.height;
+
+    vector<vector<unsigned char>> levels;
+    levels.push_back(encodeLevel(image, format, pool));
+    while (image.width > 1 || image.height > 1)
+    {
+        image = downsample(image);
+        levels.push_back(encodeLevel(image, format, pool));
+    }
+
+    string outputPath = maskPath.empty() ? KtxTexture::bakedPath(path) : KtxTexture::packedBakedPath(path, maskPath);
+    if (!KtxTexture::write(outputPath.c_str(), format, width, height, levels))
+    {
+        cout << "Failed to write " << outputPath << endl;
+        return false;
+    }
+
+    size_t compressedBytes = 0;
+    for (const vector<unsigned char>& level : levels)
+        compressedBytes += level.size();
+    cout << path << (maskPath.empty() ? "" : "+" + maskPath) << " -> " << outputPath << " (" << formatName(format) << ", " << width << "x" << height << ", "
+         << levels.size() << " levels, " << compressedBytes / 1024 << " KB)" << endl;
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    BlockFormat requested = BlockFormat::Auto;
+    unsigned int threadCount = 0;
+    vector<string> paths;
+
+    for (int i = 1; i < argc; i++)
+    {
+        string argument = argv[i];
+        if (argument == "-f" && i + 1 < argc)
+        {
+            string name = argv[++i];
+            requested = name == "bc1" ? BlockFormat::BC1 : name == "bc3" ? BlockFormat::BC3 : name == "bc4" ? BlockFormat::BC4 : BlockFormat::Auto;
+        }
+        else if (argument == "-j" && i + 1 < argc)
+        {
+            threadCount = (unsigned int)atoi(argv[++i]);
+        }
+        else
+        {
+            paths.push_back(argument);
+        }
+    }
+
+    // the scene's materials use each image as its own specular mask
+    if (paths.empty())
+        paths = { "wall.jpg", "floor.jpg", "celling.jpg", "ghost.jpg", "container2.png", "container2_specular.png", "emoji.png", "whiteBackground.png",
+                  "wall.jpg+wall.jpg", "floor.jpg+floor.jpg", "celling.jpg+celling.jpg", "ghost.jpg+ghost.jpg" };
+
+    ThreadPool pool(threadCount);
+    auto start = chrono::steady_clock::now();
+    int failures = 0;
+    for (const string& path : paths)
+    {
+        size_t plus = path.find('+');
+        bool baked = plus == string::npos ? bake(path, "", requested, pool) : bake(path.substr(0, plus), path.substr(plus + 1), requested, pool);
+        if (!baked)
+            failures++;
+    }
+
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << "Baked " << paths.size() - failures << " of " << paths.size() << " textures on " << pool.size() << " threads in " << seconds << " s" << endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,755 @@
+//
+//  textureRegistry.h
+//  test
+//
+//  Content-addressed texture cache used by loadTexture(), with images
+//  decoded in parallel on a worker pool and uploaded from the GL thread
+//  through a ring of pixel unpack buffers. Block-compressed files from the
+//  texture baker are used in place of the source images whenever they
+//  exist: "<name>.ktx", or "<name>+<mask>.ktx" for a texture with a
+//  specular map packed into its alpha channel. Textures can be loaded at
+//  1/2, 1/4 or 1/8 size for low-end hardware.
+//
+
+#ifndef textureRegistry_h
+#define textureRegistry_h
+
+#include <glad/glad.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include "assetPack.h"
+#include "glHandle.h"
+#include "ktxTexture.h"
+#include "pixelUnpackRing.h"
+#include "stb_image.h"
+#include "threadPool.h"
+
+// Hands out one shared GL texture per (file contents, sampler parameters).
+// Each path is read and hashed once; two paths holding the same bytes share
+// the decoded image as well. Every acquire() adds a reference that must be
+// given back with release() once the caller is done with the texture.
+//
+// acquire() only reserves the texture name. Each queued image gets a mapped
+// staging buffer from the PixelUnpackRing, a worker decodes into it, and the
+// GL thread then fills immutable storage from that buffer with
+// glTexSubImage2D, which returns without waiting for the copy. flush() does
+// this for everything at once at startup; update() does it without ever
+// blocking and with a per-call byte budget, so textures requested mid-session
+// stream in over a few frames instead of causing a hitch.
+//
+// A texture whose staging buffer cannot be mapped, or whose mapped contents
+// the driver dropped before the upload, is decoded (again) into ordinary
+// memory and uploaded from there, so it is never left without storage.
+//
+// Files in the mounted AssetPack are hashed and decoded in place in the
+// mapping; only files outside it are read into memory.
+class TextureRegistry {
+public:
+    // set to false to always decode the source images even when baked ones exist
+    bool useBakedTextures = true;
+    // most bytes update() uploads per call (at least one texture always goes through)
+    size_t uploadBudgetBytes = 8 * 1024 * 1024;
+    // textures acquired without their own scale are loaded at 1 / (1 << scaleShift) of their size (0-3)
+    int scaleShift = 0;
+
+    ~TextureRegistry()
+    {
+        clear();
+    }
+
+    // A scale shift of 1-3 loads the texture at 1/2, 1/4 or 1/8 size: JPEGs are
+    // decoded straight to that size by stb_image's reduced IDCT, baked
+    // textures skip their largest mip levels. Other images are unaffected.
+    // -1 uses the registry's scaleShift.
+    //
+    // With a specularMaskPath the texture is RGBA: RGB from path and, in
+    // alpha, the luminance of the specular map, so a material needs one
+    // texture and one fetch instead of two. The baker's BC3 of that pair
+    // ("<name>+<mask>.ktx") is used when it exists; otherwise the texture is
+    // built from the two source images.
+    unsigned int acquire(const char* path, GLenum wrapS, GLenum wrapT, GLenum minFilter, GLenum magFilter, int textureScaleShift = -1,
+                         const char* specularMaskPath = nullptr)
+    {
+        requestCount++;
+        if (textureScaleShift < 0)
+            textureScaleShift = scaleShift;
+        textureScaleShift = textureScaleShift > 3 ? 3 : textureScaleShift;
+
+        bool packed = specularMaskPath != nullptr;
+        uint64_t contentHash;
+        uint64_t specularMaskHash = 0;
+        FileData file;
+        FileData specularMask;
+
+        // a baked pair already has the mask in alpha, so it loads like any other baked texture
+        std::string packedPath = packed && useBakedTextures ? KtxTexture::packedBakedPath(path, specularMaskPath) : std::string();
+        bool packedBaked = !packedPath.empty() && hashPackedBaked(packedPath, contentHash, file);
+        if (packedBaked)
+            packed = false;
+
+        if ((!packedBaked && !hashFile(path, !packed, contentHash, file)) ||
+            (packed && !hashFile(specularMaskPath, false, specularMaskHash, specularMask)))
+        {
+            std::cout << "Texture failed to load at path: " << path << std::endl;
+            return 0;
+        }
+
+        TextureKey key{ contentHash, wrapS, wrapT, minFilter, magFilter, textureScaleShift, specularMaskHash };
+        auto it = textures.find(key);
+        if (it != textures.end())
+        {
+            it->second.refCount++;
+            return it->second.texture.get();
+        }
+
+        // first time these bytes are seen with these sampler parameters
+        if ((!file.data && !(packedBaked ? readBakedFile(packedPath.c_str(), file) : readTextureFile(path, !packed, file))) ||
+            (packed && specularMaskHash != contentHash && !specularMask.data && !readFile(specularMaskPath, specularMask)))
+        {
+            std::cout << "Texture failed to load at path: " << path << std::endl;
+            return 0;
+        }
+        // a specular map that is the diffuse image itself is derived from the decoded diffuse pixels
+        if (specularMaskHash == contentHash)
+            specularMask.clear();
+
+        GLTexture texture = GLTexture::create();
+        unsigned int textureID = texture.get();
+        std::unique_ptr<PendingTexture> pendingTexture(new PendingTexture());
+        textures[key] = TextureEntry{ std::move(texture), 1, pendingTexture.get() };
+        keysByID[textureID] = key;
+
+        pendingTexture->id = textureID;
+        pendingTexture->key = key;
+        pendingTexture->path = path;
+        pendingTexture->file = std::move(file);
+        pendingTexture->packSpecularMask = packed;
+        pendingTexture->specularMask = std::move(specularMask);
+        queued.push_back(std::move(pendingTexture));
+        return textureID;
+    }
+
+    // starts decodes as staging slots free up and uploads finished ones; never blocks, call once per frame
+    void update()
+    {
+        if (queued.empty() && inFlight.empty())
+            return;
+
+        startDecodes(false);
+        uploadFinished(uploadBudgetBytes);
+    }
+
+    // blocks until every texture acquired so far is uploaded; must be called on the GL thread
+    void flush()
+    {
+        if (queued.empty() && inFlight.empty())
+            return;
+
+        typedef std::chrono::steady_clock Clock;
+        Clock::time_point start = Clock::now();
+        size_t textureCount = queued.size() + inFlight.size();
+        lastDecodeFinished = start;
+        decodeMilliseconds = 0.0;
+        uploadMilliseconds = 0.0;
+
+        while (!queued.empty() || !inFlight.empty())
+        {
+            // only block on a staging fence when nothing is decoding that could be uploaded meanwhile
+            startDecodes(inFlight.empty());
+
+            std::unique_lock<std::mutex> lock(finishedMutex);
+            decodeFinished.wait(lock, [this] { return !finished.empty() || inFlight.empty(); });
+            lock.unlock();
+
+            uploadFinished((size_t)-1);
+        }
+
+        double decodeWallMilliseconds = std::chrono::duration<double, std::milli>(lastDecodeFinished - start).count();
+        double totalMilliseconds = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        std::cout << "Texture loading: " << textureCount << " images on " << decodePool->size() << " threads, "
+                  << "decode " << decodeWallMilliseconds << " ms (" << decodeMilliseconds << " ms summed), "
+                  << "upload " << uploadMilliseconds << " ms, total " << totalMilliseconds << " ms" << std::endl;
+    }
+
+    // drops one reference; the GL texture is deleted with the last one
+    void release(unsigned int textureID)
+    {
+        auto keyIt = keysByID.find(textureID);
+        if (keyIt == keysByID.end())
+            return;
+
+        auto it = textures.find(keyIt->second);
+        if (--it->second.refCount > 0)
+            return;
+
+        // the driver may hand the name out again, so a pending upload must not go by it
+        if (it->second.pending)
+            it->second.pending->released = true;
+        textures.erase(it);
+        keysByID.erase(keyIt);
+    }
+
+    // deletes every texture regardless of outstanding references; call before the GL context goes away
+    void clear()
+    {
+        // workers may still be writing into mapped staging memory
+        if (decodePool)
+            decodePool->wait();
+        if (stagingRing)
+            stagingRing->release();
+
+        textures.clear();
+        keysByID.clear();
+        pathHashes.clear();
+        sourcePathHashes.clear();
+        packedBakedHashes.clear();
+        queued.clear();
+        inFlight.clear();
+        finished.clear();
+    }
+
+    void printStatistics() const
+    {
+        std::cout << "Texture registry: " << requestCount << " requests, "
+                  << decodeCount << " decodes, " << textures.size() << " GL textures" << std::endl;
+    }
+
+private:
+    struct TextureKey {
+        uint64_t contentHash;
+        GLenum wrapS;
+        GLenum wrapT;
+        GLenum minFilter;
+        GLenum magFilter;
+        int scaleShift;
+        uint64_t specularMaskHash;  // 0 unless a specular map is packed into alpha
+
+        bool operator<(const TextureKey& other) const
+        {
+            return std::tie(contentHash, wrapS, wrapT, minFilter, magFilter, scaleShift, specularMaskHash) <
+                   std::tie(other.contentHash, other.wrapS, other.wrapT, other.minFilter, other.magFilter, other.scaleShift, other.specularMaskHash);
+        }
+    };
+
+    struct PendingTexture;
+
+    // the registry owns the texture; callers get its name
+    struct TextureEntry {
+        GLTexture texture;
+        int refCount;
+        PendingTexture* pending;    // until its upload is done
+    };
+
+    std::unordered_map<std::string, uint64_t> pathHashes;
+    std::unordered_map<std::string, uint64_t> sourcePathHashes;     // ignoring baked files, for packed textures
+    std::unordered_map<std::string, uint64_t> packedBakedHashes;    // baked diffuse and mask pairs this GL can sample
+    std::map<TextureKey, TextureEntry> textures;
+    std::unordered_map<unsigned int, TextureKey> keysByID;
+    unsigned int requestCount = 0;
+    unsigned int decodeCount = 0;
+
+    // a file's bytes, either pointing into the mounted AssetPack or read into storage
+    struct FileData {
+        const unsigned char* data = nullptr;
+        size_t size = 0;
+        std::vector<unsigned char> storage;
+
+        void clear()
+        {
+            data = nullptr;
+            size = 0;
+            std::vector<unsigned char>().swap(storage);
+        }
+    };
+
+    struct PendingTexture {
+        unsigned int id;
+        TextureKey key;
+        std::string path;
+        FileData file;
+        bool packSpecularMask = false;
+        FileData specularMask;      // empty when the mask comes from file itself
+        bool released = false;      // the texture went away before its upload
+        int width = 0;
+        int height = 0;
+        int nrComponents = 0;
+        bool compressed = false;
+        KtxTexture ktx;             // levels point into file
+        size_t stagingSize = 0;
+        int stagingSlot = -1;       // -1 when staged in clientStaging
+        unsigned char* staging = nullptr;
+        bool stageInClientMemory = false;
+        std::vector<unsigned char> clientStaging;
+        bool decoded = false;
+        double decodeMilliseconds = 0.0;
+        std::chrono::steady_clock::time_point decodeFinishedAt;
+    };
+
+    std::deque<std::unique_ptr<PendingTexture>> queued;
+    std::unordered_map<PendingTexture*, std::unique_ptr<PendingTexture>> inFlight;
+    std::unique_ptr<ThreadPool> decodePool;
+    std::unique_ptr<PixelUnpackRing> stagingRing;
+
+    std::mutex finishedMutex;
+    std::condition_variable decodeFinished;
+    std::deque<PendingTexture*> finished;
+
+    std::chrono::steady_clock::time_point lastDecodeFinished;
+    double decodeMilliseconds = 0.0;
+    double uploadMilliseconds = 0.0;
+    int s3tcSupported = -1;
+
+    static bool readFile(const char* path, FileData& fileData)
+    {
+        fileData.clear();
+        if (AssetPack::findMounted(path, &fileData.data, &fileData.size))
+            return fileData.size > 0;
+
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+            return false;
+        fileData.storage.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        fileData.data = fileData.storage.data();
+        fileData.size = fileData.storage.size();
+        return fileData.size > 0;
+    }
+
+    // hashes each path's contents once; fileData is only filled when the file had to be read
+    bool hashFile(const char* path, bool allowBaked, uint64_t& hash, FileData& fileData)
+    {
+        std::unordered_map<std::string, uint64_t>& hashes = allowBaked ? pathHashes : sourcePathHashes;
+        auto it = hashes.find(path);
+        if (it != hashes.end())
+        {
+            hash = it->second;
+            return true;
+        }
+
+        if (!readTextureFile(path, allowBaked, fileData))
+            return false;
+        hash = hashBytes(fileData.data, fileData.size);
+        hashes[path] = hash;
+        return true;
+    }
+
+    // like hashFile, for the baked "<name>+<mask>.ktx" of a packed texture; false when there is none
+    bool hashPackedBaked(const std::string& packedPath, uint64_t& hash, FileData& fileData)
+    {
+        auto it = packedBakedHashes.find(packedPath);
+        if (it != packedBakedHashes.end())
+        {
+            hash = it->second;
+            return true;
+        }
+
+        if (!readBakedFile(packedPath.c_str(), fileData))
+        {
+            fileData.clear();
+            return false;
+        }
+        hash = hashBytes(fileData.data, fileData.size);
+        packedBakedHashes[packedPath] = hash;
+        return true;
+    }
+
+    // prefers the baked "<name>.ktx" next to path when this GL can sample its format
+    bool readTextureFile(const char* path, bool allowBaked, FileData& fileData)
+    {
+        if (useBakedTextures && allowBaked && readBakedFile(KtxTexture::bakedPath(path).c_str(), fileData))
+            return true;
+        return readFile(path, fileData);
+    }
+
+    bool readBakedFile(const char* bakedPath, FileData& fileData)
+    {
+        KtxTexture ktx;
+        return readFile(bakedPath, fileData) && ktx.parse(fileData.data, fileData.size) && canSample(ktx.internalFormat);
+    }
+
+    bool canSample(GLenum internalFormat)
+    {
+        // RGTC is core since 3.0, S3TC is an extension every desktop driver exposes
+        if (internalFormat == GL_COMPRESSED_RED_RGTC1)
+            return true;
+
+        if (s3tcSupported < 0)
+        {
+            s3tcSupported = 0;
+            GLint extensionCount = 0;
+            glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+            for (GLint i = 0; i < extensionCount; i++)
+            {
+                const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+                if (extension && std::string(extension) == "GL_EXT_texture_compression_s3tc")
+                    s3tcSupported = 1;
+            }
+        }
+        return s3tcSupported == 1;
+    }
+
+    // 64-bit FNV-1a
+    static uint64_t hashBytes(const unsigned char* bytes, size_t size)
+    {
+        uint64_t hash = 14695981039346656037ull;
+        for (size_t i = 0; i < size; i++)
+        {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    // reads just the header so the staging buffer can be sized before decoding
+    static bool inspect(PendingTexture& pendingTexture)
+    {
+        const unsigned char* bytes = pendingTexture.file.data;
+        size_t size = pendingTexture.file.size;
+
+        if (pendingTexture.ktx.parse(bytes, size))
+        {
+            // a smaller baked texture is just its mip chain without the top levels
+            std::vector<KtxTexture::Level>& levels = pendingTexture.ktx.levels;
+            size_t dropped = (size_t)pendingTexture.key.scaleShift < levels.size() ? (size_t)pendingTexture.key.scaleShift : levels.size() - 1;
+            levels.erase(levels.begin(), levels.begin() + dropped);
+
+            pendingTexture.compressed = true;
+            pendingTexture.width = (int)levels[0].width;
+            pendingTexture.height = (int)levels[0].height;
+            pendingTexture.stagingSize = 0;
+            for (const KtxTexture::Level& level : pendingTexture.ktx.levels)
+                pendingTexture.stagingSize += level.size;
+            return true;
+        }
+
+        if (!stbi_info_from_memory_scaled(bytes, (int)size, &pendingTexture.width, &pendingTexture.height, &pendingTexture.nrComponents,
+                                          pendingTexture.key.scaleShift))
+            return false;
+        if (pendingTexture.packSpecularMask)
+            pendingTexture.nrComponents = 4;
+        pendingTexture.stagingSize = (size_t)pendingTexture.width * pendingTexture.height * pendingTexture.nrComponents;
+        return true;
+    }
+
+    void startDecodes(bool wait)
+    {
+        if (!decodePool)
+        {
+            decodePool.reset(new ThreadPool());
+            stagingRing.reset(new PixelUnpackRing(decodePool->size() < 4 ? 4 : decodePool->size()));
+        }
+
+        // stb keeps this flag in a global, so set it before any worker reads it
+        stbi_set_flip_vertically_on_load(true);
+
+        while (!queued.empty())
+        {
+            PendingTexture* pendingTexture = queued.front().get();
+            if (pendingTexture->stagingSize == 0 && !inspect(*pendingTexture))
+            {
+                std::cout << "Texture failed to load at path: " << pendingTexture->path << std::endl;
+                detach(*pendingTexture);
+                queued.pop_front();
+                continue;
+            }
+
+            void* mapped = nullptr;
+            int slot = -1;
+            if (!pendingTexture->stageInClientMemory)
+            {
+                slot = stagingRing->acquire(pendingTexture->stagingSize, &mapped, wait);
+                if (slot == PixelUnpackRing::busy)
+                    return;
+                if (slot == PixelUnpackRing::unavailable)
+                {
+                    std::cout << "Texture staging buffer could not be mapped, uploading directly, path: " << pendingTexture->path << std::endl;
+                    pendingTexture->stageInClientMemory = true;
+                    slot = -1;
+                }
+            }
+            if (pendingTexture->stageInClientMemory)
+            {
+                pendingTexture->clientStaging.resize(pendingTexture->stagingSize);
+                mapped = pendingTexture->clientStaging.data();
+            }
+            wait = false;
+
+            pendingTexture->stagingSlot = slot;
+            pendingTexture->staging = (unsigned char*)mapped;
+            inFlight[pendingTexture] = std::move(queued.front());
+            queued.pop_front();
+
+            decodePool->enqueue([this, pendingTexture] {
+                decode(*pendingTexture);
+                std::lock_guard<std::mutex> lock(finishedMutex);
+                finished.push_back(pendingTexture);
+                decodeFinished.notify_one();
+            });
+        }
+    }
+
+    // runs on a worker thread and writes only into the texture's own staging slot
+    static void decode(PendingTexture& pendingTexture)
+    {
+        auto start = std::chrono::steady_clock::now();
+
+        if (pendingTexture.compressed)
+        {
+            // the blocks are already in their final layout; pack the levels back to back
+            size_t offset = 0;
+            for (const KtxTexture::Level& level : pendingTexture.ktx.levels)
+            {
+                memcpy(pendingTexture.staging + offset, pendingTexture.file.data + level.offset, level.size);
+                offset += level.size;
+            }
+            pendingTexture.decoded = true;
+        }
+        else if (pendingTexture.packSpecularMask)
+        {
+            pendingTexture.decoded = decodePacked(pendingTexture);
+        }
+        else
+        {
+            // stb_image always allocates its own output, so the pixels are copied into the slot afterwards
+            int width, height, nrComponents;
+            unsigned char* data = stbi_load_from_memory_scaled(pendingTexture.file.data, (int)pendingTexture.file.size,
+                                                               &width, &height, &nrComponents, 0, pendingTexture.key.scaleShift);
+            if (data && width == pendingTexture.width && height == pendingTexture.height && nrComponents == pendingTexture.nrComponents)
+            {
+                memcpy(pendingTexture.staging, data, pendingTexture.stagingSize);
+                pendingTexture.decoded = true;
+            }
+            stbi_image_free(data);
+        }
+
+        // the file bytes stay until the upload is done, in case it has to be decoded again
+        pendingTexture.decodeFinishedAt = std::chrono::steady_clock::now();
+        pendingTexture.decodeMilliseconds = std::chrono::duration<double, std::milli>(pendingTexture.decodeFinishedAt - start).count();
+    }
+
+    // RGB from the diffuse image, alpha from the specular map's luminance
+    static bool decodePacked(PendingTexture& pendingTexture)
+    {
+        int width, height, nrComponents;
+        unsigned char* rgb = stbi_load_from_memory_scaled(pendingTexture.file.data, (int)pendingTexture.file.size,
+                                                          &width, &height, &nrComponents, 3, pendingTexture.key.scaleShift);
+        if (!rgb || width != pendingTexture.width || height != pendingTexture.height)
+        {
+            stbi_image_free(rgb);
+            return false;
+        }
+
+        // stb_image's own RGB to grey conversion gives the mask
+        int maskWidth = width, maskHeight = height;
+        unsigned char* mask = nullptr;
+        if (pendingTexture.specularMask.data)
+        {
+            mask = stbi_load_from_memory_scaled(pendingTexture.specularMask.data, (int)pendingTexture.specularMask.size,
+                                                &maskWidth, &maskHeight, &nrComponents, 1, pendingTexture.key.scaleShift);
+            if (!mask)
+            {
+                stbi_image_free(rgb);
+                return false;
+            }
+        }
+
+        unsigned char* out = pendingTexture.staging;
+        const unsigned char* in = rgb;
+        for (int y = 0; y < height; y++)
+        {
+            // a mask of another size is sampled nearest-neighbour
+            const unsigned char* maskRow = mask ? mask + (size_t)y * maskHeight / height * maskWidth : nullptr;
+            for (int x = 0; x < width; x++, in += 3, out += 4)
+            {
+                out[0] = in[0];
+                out[1] = in[1];
+                out[2] = in[2];
+                out[3] = maskRow ? maskRow[(size_t)x * maskWidth / width] : (unsigned char)((in[0] * 77 + in[1] * 150 + in[2] * 29) >> 8);
+            }
+        }
+
+        stbi_image_free(rgb);
+        stbi_image_free(mask);
+        return true;
+    }
+
+    void uploadFinished(size_t budgetBytes)
+    {
+        size_t uploadedBytes = 0;
+        while (uploadedBytes < budgetBytes)
+        {
+            PendingTexture* pendingTexture;
+            {
+                std::lock_guard<std::mutex> lock(finishedMutex);
+                if (finished.empty())
+                    return;
+                pendingTexture = finished.front();
+                finished.pop_front();
+            }
+
+            auto uploadStart = std::chrono::steady_clock::now();
+            bool uploaded = upload(*pendingTexture);
+            uploadMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - uploadStart).count();
+            if (!uploaded)
+            {
+                // decode it again, ahead of the textures that have not started yet
+                queued.push_front(std::move(inFlight[pendingTexture]));
+                inFlight.erase(pendingTexture);
+                continue;
+            }
+            decodeMilliseconds += pendingTexture->decodeMilliseconds;
+            if (pendingTexture->decodeFinishedAt > lastDecodeFinished)
+                lastDecodeFinished = pendingTexture->decodeFinishedAt;
+
+            uploadedBytes += pendingTexture->stagingSize;
+            inFlight.erase(pendingTexture);
+        }
+    }
+
+    // immutable storage needs GL 4.2; returns false when the caller has to fall back to glTex(Compressed)Image2D
+    static bool allocateStorage(GLsizei levels, GLenum internalFormat, int width, int height)
+    {
+#ifdef GL_VERSION_4_2
+        if (GLAD_GL_VERSION_4_2)
+        {
+            glTexStorage2D(GL_TEXTURE_2D, levels, internalFormat, width, height);
+            return true;
+        }
+#endif
+        return false;
+    }
+
+    static GLint mipLevelCount(int width, int height)
+    {
+        GLint levels = 1;
+        for (int size = width > height ? width : height; size > 1; size >>= 1)
+            levels++;
+        return levels;
+    }
+
+    // called once a pending texture is done with, uploaded or not
+    void detach(PendingTexture& pendingTexture)
+    {
+        if (!pendingTexture.released)
+            textures.find(pendingTexture.key)->second.pending = nullptr;
+    }
+
+    // returns false when the staged pixels were lost and the texture has to be decoded again
+    bool upload(PendingTexture& pendingTexture)
+    {
+        bool staged = pendingTexture.stagingSlot >= 0;
+
+        // released before its upload came around, or the decode failed
+        if (pendingTexture.released || !pendingTexture.decoded)
+        {
+            if (!pendingTexture.decoded)
+                std::cout << "Texture failed to load at path: " << pendingTexture.path << std::endl;
+            if (staged)
+                stagingRing->discard(pendingTexture.stagingSlot);
+            detach(pendingTexture);
+            return true;
+        }
+
+        // with a buffer bound to GL_PIXEL_UNPACK_BUFFER the data pointers are offsets into it
+        uintptr_t source = (uintptr_t)pendingTexture.clientStaging.data();
+        if (staged)
+        {
+            if (!stagingRing->bindForUpload(pendingTexture.stagingSlot))
+            {
+                // the driver may drop mapped contents, e.g. on a display mode switch; this time decode into memory it cannot drop
+                std::cout << "Texture staging buffer was lost, decoding again, path: " << pendingTexture.path << std::endl;
+                glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+                pendingTexture.stageInClientMemory = true;
+                pendingTexture.stagingSlot = -1;
+                pendingTexture.staging = nullptr;
+                pendingTexture.decoded = false;
+                return false;
+            }
+            source = 0;
+        }
+        detach(pendingTexture);
+
+        glBindTexture(GL_TEXTURE_2D, pendingTexture.id);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+        if (pendingTexture.compressed)
+        {
+            uploadCompressed(pendingTexture, source);
+        }
+        else
+        {
+            decodeCount++;
+
+            GLenum format = GL_RGB, internalFormat = GL_RGB8;
+            if (pendingTexture.nrComponents == 1)
+                format = GL_RED, internalFormat = GL_R8;
+            else if (pendingTexture.nrComponents == 2)
+                format = GL_RG, internalFormat = GL_RG8;
+            else if (pendingTexture.nrComponents == 4)
+                format = GL_RGBA, internalFormat = GL_RGBA8;
+
+            if (allocateStorage(mipLevelCount(pendingTexture.width, pendingTexture.height), internalFormat, pendingTexture.width, pendingTexture.height))
+            {
+                glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, pendingTexture.width, pendingTexture.height, format, GL_UNSIGNED_BYTE, (void*)source);
+            }
+            else
+            {
+                glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, pendingTexture.width, pendingTexture.height, 0, format, GL_UNSIGNED_BYTE, (void*)source);
+            }
+            glGenerateMipmap(GL_TEXTURE_2D);
+        }
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, pendingTexture.key.wrapS);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, pendingTexture.key.wrapT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, pendingTexture.key.minFilter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, pendingTexture.key.magFilter);
+
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        if (staged)
+            stagingRing->fence(pendingTexture.stagingSlot);
+        return true;
+    }
+
+    // every mip level comes from the baked file, so there is no glGenerateMipmap here
+    void uploadCompressed(PendingTexture& pendingTexture, uintptr_t source)
+    {
+        const KtxTexture& ktx = pendingTexture.ktx;
+        GLsizei levelCount = (GLsizei)ktx.levels.size();
+        bool immutable = allocateStorage(levelCount, ktx.internalFormat, pendingTexture.width, pendingTexture.height);
+
+        uintptr_t offset = source;
+        for (GLsizei level = 0; level < levelCount; level++)
+        {
+            const KtxTexture::Level& entry = ktx.levels[level];
+            if (immutable)
+                glCompressedTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, entry.width, entry.height, ktx.internalFormat, entry.size, (void*)offset);
+            else
+                glCompressedTexImage2D(GL_TEXTURE_2D, level, ktx.internalFormat, entry.width, entry.height, 0, entry.size, (void*)offset);
+            offset += entry.size;
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+
+        if (ktx.baseInternalFormat == GL_RED)
+        {
+            // BC4 holds luminance only; let the shaders' vec3(texture(...)) read it as grey
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_G, GL_RED);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_B, GL_RED);
+        }
+    }
+};
+
+#endif /* textureRegistry_h */
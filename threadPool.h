@@ -0,0 +1,103 @@
+//
+//  threadPool.h
+//  test
+//
+//  Fixed-size pool of worker threads for CPU-side asset work.
+//
+
+#ifndef threadPool_h
+#define threadPool_h
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+public:
+    // threadCount 0 means one worker per hardware thread
+    explicit ThreadPool(unsigned int threadCount = 0)
+    {
+        if (threadCount == 0)
+            threadCount = std::thread::hardware_concurrency();
+        if (threadCount == 0)
+            threadCount = 1;
+
+        for (unsigned int i = 0; i < threadCount; i++)
+            workers.emplace_back([this] { workerLoop(); });
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        taskAvailable.notify_all();
+        for (std::thread& worker : workers)
+            worker.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void enqueue(std::function<void()> task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.push_back(std::move(task));
+        }
+        taskAvailable.notify_one();
+    }
+
+    // blocks until every queued task has finished
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        allIdle.wait(lock, [this] { return tasks.empty() && busyWorkers == 0; });
+    }
+
+    unsigned int size() const
+    {
+        return (unsigned int)workers.size();
+    }
+
+private:
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable taskAvailable;
+    std::condition_variable allIdle;
+    unsigned int busyWorkers = 0;
+    bool stopping = false;
+
+    void workerLoop()
+    {
+        for (;;)
+        {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                taskAvailable.wait(lock, [this] { return stopping || !tasks.empty(); });
+                if (stopping && tasks.empty())
+                    return;
+                task = std::move(tasks.front());
+                tasks.pop_front();
+                busyWorkers++;
+            }
+
+            task();
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                busyWorkers--;
+                if (tasks.empty() && busyWorkers == 0)
+                    allIdle.notify_all();
+            }
+        }
+    }
+};
+
+#endif /* threadPool_h */
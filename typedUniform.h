@@ -0,0 +1,92 @@
+//
+//  typedUniform.h
+//  test
+//
+//  One uniform of a known C++ type, resolved once; the slots the generated
+//  shaderUniforms.h declares for each program.
+//
+
+#ifndef typedUniform_h
+#define typedUniform_h
+
+#include <glm/glm.hpp>
+
+#include "shader.h"
+
+// A TypedUniform holds the handle its name resolved to in one Shader, so
+// set() goes straight to that shader's cached setter: no name, no lookup,
+// and only a changed value is uploaded. Because it goes through the same
+// cache as the string setters, the two can be mixed on one program. A
+// uniform the program does not have (compiled out of this variant) gets an
+// empty handle and set() does nothing, as with the string setters.
+//
+// The shader is passed to set() rather than kept, because Shader is
+// move-only and may live in a std::vector: a pointer taken at bind time
+// would dangle once it moved. The handle is only an index into that
+// shader's uniform table, so it stays valid across moves; pass set() the
+// shader the slot was resolved against.
+//
+// T is the value type: int (also bool and samplers), float, glm::vec2,
+// glm::vec3, glm::vec4, glm::mat3 or glm::mat4.
+template <typename T>
+class TypedUniform {
+public:
+    TypedUniform()
+    {
+    }
+
+    TypedUniform(const Shader& shader, const char* name) : handle(shader.uniform(name))
+    {
+    }
+
+    // sets it on the shader's program, which must be in use
+    void set(const Shader& shader, const T& value) const
+    {
+        upload(shader, handle, value);
+    }
+
+    bool active() const
+    {
+        return handle.slot >= 0;
+    }
+
+private:
+    Shader::Uniform handle;
+
+    static void upload(const Shader& shader, Shader::Uniform handle, int value)
+    {
+        shader.setInt(handle, value);
+    }
+
+    static void upload(const Shader& shader, Shader::Uniform handle, float value)
+    {
+        shader.setFloat(handle, value);
+    }
+
+    static void upload(const Shader& shader, Shader::Uniform handle, const glm::vec2& value)
+    {
+        shader.setVec2(handle, value);
+    }
+
+    static void upload(const Shader& shader, Shader::Uniform handle, const glm::vec3& value)
+    {
+        shader.setVec3(handle, value);
+    }
+
+    static void upload(const Shader& shader, Shader::Uniform handle, const glm::vec4& value)
+    {
+        shader.setVec4(handle, value);
+    }
+
+    static void upload(const Shader& shader, Shader::Uniform handle, const glm::mat3& value)
+    {
+        shader.setMat3(handle, value);
+    }
+
+    static void upload(const Shader& shader, Shader::Uniform handle, const glm::mat4& value)
+    {
+        shader.setMat4(handle, value);
+    }
+};
+
+#endif /* typedUniform_h */
@@ -0,0 +1,109 @@
+//
+//  vertexLayout.h
+//  test
+//
+//  Compile-time description of an interleaved vertex: the attributes' formats
+//  give the stride and offsets, and the VAO setup is generated from them.
+//
+
+#ifndef vertexLayout_h
+#define vertexLayout_h
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <utility>
+
+// One attribute: the shader location it feeds, how many components and of
+// which GL type. Normalized integer types reach the shader as 0..1 (or -1..1)
+// floats; packed types like GL_INT_2_10_10_10_REV always take 4 bytes.
+template <GLuint Location, GLint Components, GLenum Type, GLboolean Normalized = GL_FALSE>
+struct VertexAttribute {
+    static constexpr GLuint location = Location;
+    static constexpr GLint components = Components;
+    static constexpr GLenum type = Type;
+    static constexpr GLboolean normalized = Normalized;
+
+    static constexpr size_t size()
+    {
+        return Type == GL_INT_2_10_10_10_REV || Type == GL_UNSIGNED_INT_2_10_10_10_REV ? 4 : Components * componentSize();
+    }
+
+private:
+    static constexpr size_t componentSize()
+    {
+        return Type == GL_FLOAT || Type == GL_INT || Type == GL_UNSIGNED_INT ? 4 :
+               Type == GL_HALF_FLOAT || Type == GL_SHORT || Type == GL_UNSIGNED_SHORT ? 2 : 1;
+    }
+};
+
+// the attributes the scene's shaders declare: 0 position, 1 normal, 2 texture coordinate
+using Position3f = VertexAttribute<0, 3, GL_FLOAT>;
+using Position3un16 = VertexAttribute<0, 3, GL_UNSIGNED_SHORT, GL_TRUE>;
+using Normal3f = VertexAttribute<1, 3, GL_FLOAT>;
+using Normal10 = VertexAttribute<1, 4, GL_INT_2_10_10_10_REV, GL_TRUE>;   // the shader reads 3 of the 4
+using UV2f = VertexAttribute<2, 2, GL_FLOAT>;
+using UV2h = VertexAttribute<2, 2, GL_HALF_FLOAT>;
+
+// Attributes are interleaved in the order given, each starting on a 4 byte
+// boundary as GL prefers; the stride is rounded up the same way. Everything
+// is known at compile time, so configure() is just the GL calls.
+template <typename... Attributes>
+class VertexLayout {
+public:
+    static constexpr size_t attributeCount = sizeof...(Attributes);
+
+    static constexpr size_t offset(size_t index)
+    {
+        const size_t sizes[] = { Attributes::size()... };
+        size_t result = 0;
+        for (size_t i = 0; i < index; i++)
+            result = align(result + sizes[i]);
+        return result;
+    }
+
+    static constexpr size_t stride()
+    {
+        const size_t sizes[] = { Attributes::size()... };
+        return align(offset(attributeCount - 1) + sizes[attributeCount - 1]);
+    }
+
+    // points the layout's attributes of the bound VAO at the bound GL_ARRAY_BUFFER, starting at byte base
+    static void configure(size_t base = 0)
+    {
+        configureAttributes(base, std::make_index_sequence<sizeof...(Attributes)>());
+    }
+
+private:
+    static constexpr size_t align(size_t bytes)
+    {
+        return (bytes + 3) & ~(size_t)3;
+    }
+
+    template <size_t... Indices>
+    static void configureAttributes(size_t base, std::index_sequence<Indices...>)
+    {
+        int expand[] = { 0, (configureAttribute<Attributes>(base + offset(Indices)), 0)... };
+        (void)expand;
+    }
+
+    template <typename Attribute>
+    static void configureAttribute(size_t attributeOffset)
+    {
+        glVertexAttribPointer(Attribute::location, Attribute::components, Attribute::type, Attribute::normalized, (GLsizei)stride(), (void*)attributeOffset);
+        glEnableVertexAttribArray(Attribute::location);
+    }
+};
+
+// the streams the scene's shaders read
+using PositionVertexLayout = VertexLayout<Position3f>;                      // lamps and depth-only passes
+using LitVertexLayout = VertexLayout<Position3f, Normal3f>;                 // lit, untextured
+using TexturedVertexLayout = VertexLayout<Position3f, Normal3f, UV2f>;      // lit and textured
+using CompactTexturedVertexLayout = VertexLayout<Position3un16, Normal10, UV2h>;
+using CompactPositionVertexLayout = VertexLayout<Position3un16>;
+
+static_assert(TexturedVertexLayout::stride() == 32 && TexturedVertexLayout::offset(2) == 24, "float vertex is 8 floats");
+static_assert(CompactTexturedVertexLayout::stride() == 16 && CompactTexturedVertexLayout::offset(1) == 8, "compact vertex is 16 bytes");
+static_assert(PositionVertexLayout::stride() == 12 && CompactPositionVertexLayout::stride() == 8, "position streams are tightly packed");
+
+#endif /* vertexLayout_h */
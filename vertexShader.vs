@@ -1,11 +1,27 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
+#ifdef INSTANCED
+layout (location = 3) in mat4 aInstanceModel;   // per instance, see CubeInstances
+#endif
+
+// the depth prepass and the lit pass must produce the same depths
+invariant gl_Position;
+
+// shared by every program, written once per frame; see CameraBlock
+layout (std140) uniform CameraBlock
+{
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+};
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
 
 void main()
 {
+#ifdef INSTANCED
+    gl_Position = projection * view * model * aInstanceModel * vec4(aPos, 1.0);
+#else
     gl_Position = projection * view * model * vec4(aPos, 1.0);
+#endif
 }
@@ -2,21 +2,87 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
+#if defined(PROCEDURAL_BOXES)
+// no vertex attributes: the box comes from its record in boxRecords, see ProceduralBoxes
+uniform samplerBuffer boxRecords;
+uniform int boxOffset;
+
+flat out vec3 InstanceMaterial;
+
+// per face: corner at (0, 0), then the directions of u and v; the faces wind counterclockwise seen from outside
+const vec3 faceOrigins[6] = vec3[6](vec3(0.0, 0.0, 1.0), vec3(1.0, 0.0, 0.0), vec3(1.0, 0.0, 1.0),
+                                    vec3(0.0, 0.0, 0.0), vec3(0.0, 1.0, 1.0), vec3(0.0, 0.0, 0.0));
+const vec3 faceU[6] = vec3[6](vec3(1.0, 0.0, 0.0), vec3(-1.0, 0.0, 0.0), vec3(0.0, 0.0, -1.0),
+                              vec3(0.0, 0.0, 1.0), vec3(1.0, 0.0, 0.0), vec3(1.0, 0.0, 0.0));
+const vec3 faceV[6] = vec3[6](vec3(0.0, 1.0, 0.0), vec3(0.0, 1.0, 0.0), vec3(0.0, 1.0, 0.0),
+                              vec3(0.0, 1.0, 0.0), vec3(0.0, 0.0, -1.0), vec3(0.0, 0.0, 1.0));
+const vec2 quadCorners[6] = vec2[6](vec2(0.0, 0.0), vec2(1.0, 0.0), vec2(1.0, 1.0),
+                                    vec2(1.0, 1.0), vec2(0.0, 1.0), vec2(0.0, 0.0));
+#elif defined(INSTANCED)
+// per instance, see CubeInstances
+layout (location = 3) in mat4 aInstanceModel;
+layout (location = 7) in mat3 aInstanceNormal;
+layout (location = 10) in vec4 aInstanceUVRect;
+layout (location = 11) in vec3 aInstanceMaterial;   // (diffuse layer, specular layer, shininess)
+
+flat out vec3 InstanceMaterial;
+#endif
+
+invariant gl_Position;     // matches the depth prepass (vertexShader.vs)
 
 out vec3 FragPos;
 out vec3 Normal;
 out vec2 TexCoords;
 
+// shared by every program, written once per frame; see CameraBlock
+layout (std140) uniform CameraBlock
+{
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+};
+
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+#if defined(INSTANCED) || defined(PROCEDURAL_BOXES)
+uniform mat3 normalMatrix;  // transpose(inverse(mat3(model))), computed once on the CPU
+#else
+uniform vec4 uvRect;    // (u min, v min, u max, v max) of the object; the mesh's own coordinates run 0..1
+#endif
 
 void main()
 {
+#if defined(PROCEDURAL_BOXES)
+    int record = (boxOffset + gl_InstanceID) * 3;
+    vec4 minCorner = texelFetch(boxRecords, record);
+    vec4 maxCorner = texelFetch(boxRecords, record + 1);
+    vec4 boxUVRect = texelFetch(boxRecords, record + 2);
+
+    int face = gl_VertexID / 6;
+    vec2 uv = quadCorners[gl_VertexID % 6];
+    vec3 unitPos = faceOrigins[face] + uv.x * faceU[face] + uv.y * faceV[face];
+
+    vec4 worldPos = model * vec4(mix(minCorner.xyz, maxCorner.xyz, unitPos), 1.0);
+    gl_Position = projection * view * worldPos;
+
+    FragPos = vec3(worldPos);
+    Normal = normalMatrix * cross(faceU[face], faceV[face]);
+    TexCoords = mix(boxUVRect.xy, boxUVRect.zw, uv);
+    int layers = int(minCorner.w);
+    InstanceMaterial = vec3(layers % 2048, layers / 2048 - 1, maxCorner.w);   // ProceduralBoxes::layerStride
+#elif defined(INSTANCED)
+    vec4 worldPos = model * aInstanceModel * vec4(aPos, 1.0);
+    gl_Position = projection * view * worldPos;
+    
+    FragPos = vec3(worldPos);
+    Normal = normalMatrix * (aInstanceNormal * aNormal);
+    TexCoords = mix(aInstanceUVRect.xy, aInstanceUVRect.zw, aTexCoords);
+    InstanceMaterial = aInstanceMaterial;
+#else
     gl_Position = projection * view * model * vec4(aPos, 1.0);
     
     FragPos = vec3(model * vec4(aPos, 1.0));
     Normal = mat3(transpose(inverse(model))) * aNormal;
-    TexCoords = aTexCoords;
+    TexCoords = mix(uvRect.xy, uvRect.zw, aTexCoords);
+#endif
     
 }